@@ -0,0 +1,326 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "audio-buffer.hpp"
+#include "lib.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "warning-enable.hpp"
+
+#ifdef WIN32
+#include "warning-disable.hpp"
+#include <Windows.h>
+#include <malloc.h>
+#include "warning-enable.hpp"
+#else
+#include "warning-disable.hpp"
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "warning-enable.hpp"
+#endif
+
+static std::atomic_size_t _total_locked = 0;
+
+static void* aligned_allocate(size_t size)
+{
+#ifdef WIN32
+	return _aligned_malloc(size, ::voicefx::audio::alignment);
+#else
+	return std::aligned_alloc(::voicefx::audio::alignment, size);
+#endif
+}
+
+static void aligned_free(void* ptr)
+{
+#ifdef WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+static bool lock_memory(void* ptr, size_t size)
+{
+#ifdef WIN32
+	if (VirtualLock(ptr, size) != FALSE) {
+		return true;
+	}
+
+	// The working set is usually too small to lock anything, so grow it and try again.
+	if (GetLastError() == ERROR_WORKING_SET_QUOTA) {
+		SIZE_T minimum = 0;
+		SIZE_T maximum = 0;
+		if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimum, &maximum) != FALSE) {
+			if (SetProcessWorkingSetSize(GetCurrentProcess(), minimum + size, maximum + size) != FALSE) {
+				return VirtualLock(ptr, size) != FALSE;
+			}
+		}
+	}
+	return false;
+#else
+	// Check the limit first, so that we can tell why it failed.
+	if (struct rlimit limit; getrlimit(RLIMIT_MEMLOCK, &limit) == 0) {
+		if ((limit.rlim_cur != RLIM_INFINITY) && ((_total_locked + size) > limit.rlim_cur)) {
+			D_LOG_STATIC("RLIMIT_MEMLOCK of %llu bytes is too small to lock another %zu bytes, using unlocked memory.", static_cast<unsigned long long>(limit.rlim_cur), size);
+			return false;
+		}
+	}
+
+	if (mlock(ptr, size) != 0) {
+		D_LOG_STATIC("Failed to lock %zu bytes (errno %d), using unlocked memory.", size, errno);
+		return false;
+	}
+	return true;
+#endif
+}
+
+static void unlock_memory(void* ptr, size_t size)
+{
+#ifdef WIN32
+	VirtualUnlock(ptr, size);
+#else
+	munlock(ptr, size);
+#endif
+}
+
+voicefx::audio::arena::~arena()
+{
+	D_LOG_LOUD("");
+}
+
+voicefx::audio::arena::arena() : _memory(), _size(0), _used(0), _locked(false)
+{
+	D_LOG_LOUD("");
+}
+
+voicefx::audio::arena::arena(size_t size, bool lock) : arena()
+{
+	D_LOG_LOUD("");
+	// Keep the total size a multiple of the alignment, as aligned_alloc requires it.
+	_size = ((size + alignment - 1) / alignment) * alignment;
+	if (_size == 0) {
+		return;
+	}
+
+	void* memory = aligned_allocate(_size);
+	if (!memory) {
+		throw_log("Failed to allocate %zu bytes for audio buffers.", _size);
+	}
+
+	// Touch every page now, so that the first process() call doesn't fault them in.
+	memset(memory, 0, _size);
+
+	if (lock) {
+		_locked = lock_memory(memory, _size);
+	}
+
+	if (_locked) {
+		size_t total = (_total_locked += _size);
+		D_LOG("Locked %zu bytes of audio buffers, %zu bytes are locked in total.", _size, total);
+
+		size_t bytes = _size;
+		_memory      = std::shared_ptr<void>(memory, [bytes](void* v) {
+			unlock_memory(v, bytes);
+			_total_locked -= bytes;
+			aligned_free(v);
+		});
+	} else {
+		_memory = std::shared_ptr<void>(memory, [](void* v) { aligned_free(v); });
+	}
+}
+
+size_t voicefx::audio::arena::size()
+{
+	return _size;
+}
+
+size_t voicefx::audio::arena::used()
+{
+	return _used;
+}
+
+bool voicefx::audio::arena::locked()
+{
+	return _locked;
+}
+
+float* voicefx::audio::arena::allocate(size_t samples)
+{
+	size_t bytes = align_samples(samples) * sizeof(float);
+	if ((_used + bytes) > _size) {
+		throw_log("Arena exhausted, requested %zu bytes with only %zu of %zu bytes left.", bytes, _size - _used, _size);
+	}
+
+	float* ptr = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(_memory.get()) + _used);
+	_used += bytes;
+	return ptr;
+}
+
+size_t voicefx::audio::arena::total_locked()
+{
+	return _total_locked;
+}
+
+voicefx::audio::planar_buffer::~planar_buffer() {}
+
+voicefx::audio::planar_buffer::planar_buffer() : _data(nullptr), _channels(0), _capacity(0), _offset(0), _used(0), _peek(), _poke() {}
+
+voicefx::audio::planar_buffer::planar_buffer(::voicefx::audio::arena& arena, size_t channels, size_t capacity) : planar_buffer()
+{
+	_channels = channels;
+	_capacity = align_samples(capacity);
+	_data     = arena.allocate(footprint(_channels, _capacity));
+	_peek.resize(_channels, nullptr);
+	_poke.resize(_channels, nullptr);
+}
+
+size_t voicefx::audio::planar_buffer::channels()
+{
+	return _channels;
+}
+
+size_t voicefx::audio::planar_buffer::capacity()
+{
+	return _capacity;
+}
+
+size_t voicefx::audio::planar_buffer::used()
+{
+	return _used;
+}
+
+size_t voicefx::audio::planar_buffer::free()
+{
+	return _capacity - _used;
+}
+
+const float* voicefx::audio::planar_buffer::peek(size_t channel)
+{
+	return _data + (channel * _capacity * 2) + _offset;
+}
+
+float* voicefx::audio::planar_buffer::poke(size_t channel)
+{
+	// Both positions are within the first half, so everything up to the read position is contiguous from here.
+	size_t position = _offset + _used;
+	if (position >= _capacity) {
+		position -= _capacity;
+	}
+	return _data + (channel * _capacity * 2) + position;
+}
+
+const float** voicefx::audio::planar_buffer::peek()
+{
+	for (size_t idx = 0; idx < _channels; idx++) {
+		_peek[idx] = peek(idx);
+	}
+	return _peek.data();
+}
+
+float** voicefx::audio::planar_buffer::poke()
+{
+	for (size_t idx = 0; idx < _channels; idx++) {
+		_poke[idx] = poke(idx);
+	}
+	return _poke.data();
+}
+
+void voicefx::audio::planar_buffer::read(size_t samples)
+{
+	if (samples > _used) {
+		throw_log("Attempted to read %zu samples with only %zu samples available.", samples, _used);
+	}
+
+	_used -= samples;
+	_offset += samples;
+	if (_offset >= _capacity) {
+		_offset -= _capacity;
+	}
+}
+
+void voicefx::audio::planar_buffer::write(size_t samples)
+{
+	if ((_used + samples) > _capacity) {
+		throw_log("Attempted to write %zu samples with only %zu samples of space.", samples, _capacity - _used);
+	}
+
+	// Copy the new samples into the other half, so that a later peek() or poke() can run across the wrap-around.
+	size_t position = _offset + _used;
+	if (position >= _capacity) {
+		position -= _capacity;
+	}
+	size_t low  = std::min(samples, _capacity - position); // Part written to the first half.
+	size_t high = samples - low;                           // Part that ran past it into the mirror.
+	for (size_t idx = 0; idx < _channels; idx++) {
+		float* plane = _data + (idx * _capacity * 2);
+		if (low > 0) {
+			memcpy(plane + _capacity + position, plane + position, low * sizeof(float));
+		}
+		if (high > 0) {
+			memcpy(plane, plane + _capacity, high * sizeof(float));
+		}
+	}
+
+	_used += samples;
+}
+
+void voicefx::audio::planar_buffer::read(size_t samples, float* const* outputs)
+{
+	if (samples > _used) {
+		throw_log("Attempted to read %zu samples with only %zu samples available.", samples, _used);
+	}
+
+	for (size_t idx = 0; idx < _channels; idx++) {
+		memcpy(outputs[idx], peek(idx), samples * sizeof(float));
+	}
+	read(samples);
+}
+
+void voicefx::audio::planar_buffer::write(size_t samples, const float* const* inputs)
+{
+	if (samples > free()) {
+		throw_log("Attempted to write %zu samples with only %zu samples of space.", samples, _capacity - _used);
+	}
+
+	for (size_t idx = 0; idx < _channels; idx++) {
+		memcpy(poke(idx), inputs[idx], samples * sizeof(float));
+	}
+	write(samples);
+}
+
+void voicefx::audio::planar_buffer::clear()
+{
+	_offset = 0;
+	_used   = 0;
+}
+
+size_t voicefx::audio::planar_buffer::footprint(size_t channels, size_t capacity)
+{
+	return align_samples(capacity) * 2 * channels;
+}
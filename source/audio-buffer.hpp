@@ -0,0 +1,167 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx::audio {
+	// Alignment of the arena and of every channel plane inside it. Matches a cache line, and is enough for AVX-512.
+	static constexpr size_t alignment = 64;
+
+	/** Round a sample count up so that a plane of floats ends on an alignment boundary.
+	 */
+	constexpr size_t align_samples(size_t samples)
+	{
+		constexpr size_t per_line = alignment / sizeof(float);
+		return ((samples + per_line - 1) / per_line) * per_line;
+	}
+
+	/** A single, contiguous and aligned block of memory that all pipeline stages are carved out of.
+	 *
+	 * Allocations are never freed individually, the whole arena is released at once. The memory is always touched
+	 * on creation so that no page faults happen later on the audio thread, and can optionally be locked into RAM so
+	 * that it is never swapped out.
+	 */
+	class arena {
+		std::shared_ptr<void> _memory;
+		size_t                _size;
+		size_t                _used;
+		bool                  _locked;
+
+		public:
+		~arena();
+		arena();
+
+		/** Allocate and prefault a new arena.
+		 *
+		 * @param size The size of the arena in bytes.
+		 * @param lock Try to lock the memory into RAM. Falls back to unlocked memory if the system refuses.
+		 */
+		arena(size_t size, bool lock = false);
+
+		// Copy Operator & Constructor
+		arena(const arena&)            = delete;
+		arena& operator=(const arena&) = delete;
+
+		public:
+		size_t size();
+		size_t used();
+		bool   locked();
+
+		/** Take a number of floats from the arena.
+		 *
+		 * The returned memory is aligned to voicefx::audio::alignment and zero-initialized.
+		 */
+		float* allocate(size_t samples);
+
+		public:
+		/** Total amount of memory currently locked by all arenas in this process.
+		 */
+		static size_t total_locked();
+	};
+
+	/** Planar multi-channel ring buffer that lives inside an arena.
+	 *
+	 * Every channel occupies its own aligned plane of 'capacity' samples, followed by a mirror of the same size. All
+	 * channels share a single read and write position, so a stage only ever needs one index update per block instead
+	 * of one per channel. write() copies what was just written into the other half, which keeps peek() and poke()
+	 * contiguous across the wrap-around without ever moving unread data. Pointers returned by peek() stay valid until
+	 * the samples are read.
+	 *
+	 * Plane memory is twice the capacity, see footprint().
+	 */
+	class planar_buffer {
+		float* _data;
+		size_t _channels;
+		size_t _capacity;
+		size_t _offset;
+		size_t _used;
+
+		// Pointer tables handed out by peek() and poke(), allocated once so the audio thread never has to.
+		std::vector<const float*> _peek;
+		std::vector<float*>       _poke;
+
+		public:
+		~planar_buffer();
+		planar_buffer();
+		planar_buffer(::voicefx::audio::arena& arena, size_t channels, size_t capacity);
+
+		public:
+		size_t channels();
+		size_t capacity();
+
+		/** Number of samples per channel available for reading.
+		 */
+		size_t used();
+
+		/** Number of samples per channel available for writing, all of them contiguous at poke().
+		 */
+		size_t free();
+
+		/** Pointer to the oldest unread sample of a channel.
+		 */
+		const float* peek(size_t channel);
+
+		/** Pointer to the next writable sample of a channel.
+		 */
+		float* poke(size_t channel);
+
+		/** Pointers to the oldest unread sample of every channel.
+		 */
+		const float** peek();
+
+		/** Pointers to the next writable sample of every channel.
+		 */
+		float** poke();
+
+		/** Mark a number of samples on all channels as read.
+		 */
+		void read(size_t samples);
+
+		/** Mark a number of samples on all channels as written, and mirror them.
+		 */
+		void write(size_t samples);
+
+		/** Copy samples out of the buffer and mark them as read.
+		 */
+		void read(size_t samples, float* const* outputs);
+
+		/** Copy samples into the buffer and mark them as written.
+		 */
+		void write(size_t samples, const float* const* inputs);
+
+		/** Drop all content.
+		 */
+		void clear();
+
+		public:
+		/** Number of floats that a buffer takes from its arena.
+		 */
+		static size_t footprint(size_t channels, size_t capacity);
+	};
+} // namespace voicefx::audio
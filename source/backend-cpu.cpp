@@ -0,0 +1,279 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "backend-cpu.hpp"
+#include "lib.hpp"
+#include "util-simd.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "warning-enable.hpp"
+
+static constexpr double   pi         = 3.14159265358979323846;
+static constexpr uint32_t samplerate = 48000;
+static constexpr size_t   hop        = 480; // 10 ms
+static constexpr size_t   window     = hop * 2;
+static constexpr size_t   fft_size   = 1024;
+static constexpr size_t   bins       = fft_size / 2 + 1;
+
+// Power spectrum smoothing, and how fast the noise estimate may rise per frame (about 4 dB per second).
+static constexpr float smoothing = 0.7f;
+static constexpr float noise_rise = 1.01f;
+
+// The minimum of a smoothed power spectrum sits below its mean, which this makes up for.
+static constexpr float noise_bias = 2.f;
+
+// Weight of the previous frame in the a priori SNR.
+static constexpr float decision_directed = 0.98f;
+
+// Attenuation at full intensity.
+static constexpr float max_attenuation_db = 30.f;
+
+// Mean a priori SNR below which a frame is considered to hold no voice at all.
+static constexpr float vad_threshold = 0.1f;
+
+voicefx::cpu::denoiser::denoiser() : _lock(), _fft(fft_size), _window(fft_size, 0.f), _channels(), _frame(fft_size, 0.f), _re(bins), _im(bins), _gain(bins), _fx_channels(1), _fx_dirty(true), _fx_denoise(true), _fx_dereverb(false), _cfg_intensity(0.67f), _cfg_vad(false)
+{
+	D_LOG_LOUD("");
+
+	// The square root of a periodic Hann window, applied before and after processing, adds up to exactly one at half
+	// overlap.
+	for (size_t idx = 0; idx < window; idx++) {
+		_window[idx] = static_cast<float>(std::sin(pi * static_cast<double>(idx) / static_cast<double>(window)));
+	}
+
+	load();
+}
+
+voicefx::cpu::denoiser::~denoiser()
+{
+	D_LOG_LOUD("");
+}
+
+const char* voicefx::cpu::denoiser::name()
+{
+	return "CPU";
+}
+
+uint32_t voicefx::cpu::denoiser::input_samplerate()
+{
+	return samplerate;
+}
+
+uint32_t voicefx::cpu::denoiser::output_samplerate()
+{
+	return samplerate;
+}
+
+uint32_t voicefx::cpu::denoiser::input_blocksize()
+{
+	return static_cast<uint32_t>(hop);
+}
+
+uint32_t voicefx::cpu::denoiser::output_blocksize()
+{
+	return static_cast<uint32_t>(hop);
+}
+
+size_t voicefx::cpu::denoiser::delay()
+{
+	// Output is complete once the window that follows it has been seen.
+	return window - hop;
+}
+
+uint8_t voicefx::cpu::denoiser::channels()
+{
+	return _fx_channels;
+}
+
+void voicefx::cpu::denoiser::channels(uint8_t v)
+{
+	D_LOG_LOUD("Adjusting channels to %" PRIu8 ".", v);
+	if (v == 0) {
+		throw_log("Can't set channel count to 0, illegal operation.");
+	}
+
+	if (v != _fx_channels) {
+		_fx_channels = v;
+		_fx_dirty    = true;
+	}
+}
+
+#ifndef TONPLUGINS_DEMO
+bool voicefx::cpu::denoiser::denoise_enabled()
+{
+	return _fx_denoise;
+}
+
+void voicefx::cpu::denoiser::enable_denoise(bool v)
+{
+	D_LOG_LOUD("Setting denoising to %s.", v ? "enabled" : "disabled");
+	_fx_denoise = v;
+}
+
+bool voicefx::cpu::denoiser::dereverb_enabled()
+{
+	return _fx_dereverb;
+}
+
+void voicefx::cpu::denoiser::enable_dereverb(bool v)
+{
+	D_LOG_LOUD("Setting dereverb to %s.", v ? "enabled" : "disabled");
+	_fx_dereverb = v;
+}
+
+float voicefx::cpu::denoiser::intensity()
+{
+	return _cfg_intensity;
+}
+
+void voicefx::cpu::denoiser::intensity(float v)
+{
+	D_LOG_LOUD("Setting intensity to %f.", v);
+	_cfg_intensity = v;
+}
+
+bool voicefx::cpu::denoiser::voice_activity_detection()
+{
+	return _cfg_vad;
+}
+
+void voicefx::cpu::denoiser::voice_activity_detection(bool v)
+{
+	D_LOG_LOUD("Setting voice activity detection to %s.", v ? "enabled" : "disabled");
+	_cfg_vad = v;
+}
+#endif
+
+void voicefx::cpu::denoiser::load()
+{
+	D_LOG_LOUD("");
+	std::unique_lock<std::mutex> lock(_lock);
+	if (_fx_dirty) {
+		_channels.resize(_fx_channels);
+		for (auto& channel : _channels) {
+			channel.history.assign(window, 0.f);
+			channel.overlap.assign(hop, 0.f);
+			channel.smoothed.assign(bins, 0.f);
+			channel.noise.assign(bins, 0.f);
+			channel.clean.assign(bins, 0.f);
+			channel.primed = false;
+		}
+		_fx_dirty = false;
+	}
+}
+
+void voicefx::cpu::denoiser::clear()
+{
+	D_LOG_LOUD("Clearing effect state.");
+	std::unique_lock<std::mutex> lock(_lock);
+	for (auto& channel : _channels) {
+		std::fill(channel.history.begin(), channel.history.end(), 0.f);
+		std::fill(channel.overlap.begin(), channel.overlap.end(), 0.f);
+		std::fill(channel.clean.begin(), channel.clean.end(), 0.f);
+		channel.primed = false;
+	}
+}
+
+void voicefx::cpu::denoiser::process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples)
+{
+	try {
+		D_LOG_LOUD("Processing %zu samples", input_samples);
+
+		if (_fx_dirty) {
+			load();
+		}
+
+		std::unique_lock<std::mutex> lock(_lock);
+		size_t                       frames = input_samples / hop;
+		for (size_t frame = 0; frame < frames; frame++) {
+			for (size_t ch = 0; ch < _channels.size(); ch++) {
+				process_frame(_channels[ch], inputs[ch] + frame * hop, outputs[ch] + frame * hop);
+			}
+		}
+		input_samples  = frames * hop;
+		output_samples = frames * hop;
+
+		D_LOG_LOUD("Used %zu samples to generate %zu samples", input_samples, output_samples);
+	} catch (std::exception const& ex) {
+		throw_log("%s", ex.what());
+	}
+}
+
+void voicefx::cpu::denoiser::process_frame(channel_t& channel, const float* input, float* output)
+{
+	// Slide the window along by one hop, and transform it.
+	memmove(channel.history.data(), channel.history.data() + hop, (window - hop) * sizeof(float));
+	memcpy(channel.history.data() + (window - hop), input, hop * sizeof(float));
+	::voicefx::simd::multiply(channel.history.data(), _window.data(), _frame.data(), window);
+
+	// The transform is larger than the window, and the inverse of the previous frame left the tail of its filtered
+	// window there. Without clearing it, that tail leaks into this frame whenever the gains are not all one.
+	std::fill(_frame.begin() + window, _frame.end(), 0.f);
+	_fft.forward(_frame.data(), _re.data(), _im.data());
+
+	if (_fx_denoise) {
+		const float floor = std::pow(10.f, -max_attenuation_db * std::clamp(static_cast<float>(_cfg_intensity), 0.f, 1.f) / 20.f);
+
+		float mean_snr = 0.f;
+		for (size_t idx = 0; idx < bins; idx++) {
+			float power = _re[idx] * _re[idx] + _im[idx] * _im[idx];
+
+			// Noise follows the smoothed spectrum down immediately, but only rises slowly.
+			if (!channel.primed) {
+				channel.smoothed[idx] = power;
+				channel.noise[idx]    = power;
+			} else {
+				channel.smoothed[idx] = smoothing * channel.smoothed[idx] + (1.f - smoothing) * power;
+				channel.noise[idx]    = std::min(channel.noise[idx] * noise_rise, channel.smoothed[idx]);
+			}
+
+			float noise     = channel.noise[idx] * noise_bias + 1e-12f;
+			float posterior = power / noise;
+			float prior     = decision_directed * (channel.clean[idx] / noise) + (1.f - decision_directed) * std::max(posterior - 1.f, 0.f);
+			float gain      = prior / (1.f + prior);
+
+			channel.clean[idx] = gain * gain * power;
+			_gain[idx]         = std::max(gain, floor);
+			mean_snr += prior;
+		}
+		channel.primed = true;
+
+		// Without any voice in the frame, everything is noise.
+		if (_cfg_vad && ((mean_snr / static_cast<float>(bins)) < vad_threshold)) {
+			std::fill(_gain.begin(), _gain.end(), floor);
+		}
+
+		::voicefx::simd::multiply(_re.data(), _gain.data(), _re.data(), bins);
+		::voicefx::simd::multiply(_im.data(), _gain.data(), _im.data(), bins);
+	}
+
+	// Back to the time domain, and overlap with the previous window.
+	_fft.inverse(_re.data(), _im.data(), _frame.data());
+	::voicefx::simd::multiply(_frame.data(), _window.data(), _frame.data(), window);
+	::voicefx::simd::mix(channel.overlap.data(), _frame.data(), output, hop, 1.f, 0.f, 1.f, 0.f);
+	memcpy(channel.overlap.data(), _frame.data() + hop, hop * sizeof(float));
+}
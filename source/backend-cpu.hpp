@@ -0,0 +1,114 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "backend.hpp"
+#include "util-fft.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx::cpu {
+	/** Spectral denoiser that runs on any CPU.
+	 *
+	 * A short-time Fourier transform with 20 ms windows and 10 ms hops, which matches the frame geometry of the NVIDIA
+	 * effects. Noise is tracked per bin as the minimum of the smoothed power spectrum, and removed with a decision
+	 * directed Wiener gain. The intensity sets how far the gain may drop. There is no dereverberation, the setting is
+	 * only kept.
+	 */
+	class denoiser : public ::voicefx::backend {
+		struct channel_t {
+			std::vector<float> history; // Last window of input.
+			std::vector<float> overlap; // Second half of the previous output window.
+			std::vector<float> smoothed;
+			std::vector<float> noise;
+			std::vector<float> clean; // Estimated clean power of the previous frame.
+			bool               primed;
+		};
+
+		std::mutex _lock;
+
+		::voicefx::fft::real   _fft;
+		std::vector<float>     _window;
+		std::vector<channel_t> _channels;
+
+		// Work space for one frame.
+		std::vector<float> _frame;
+		std::vector<float> _re;
+		std::vector<float> _im;
+		std::vector<float> _gain;
+
+		std::atomic_uint8_t _fx_channels;
+		std::atomic_bool    _fx_dirty;
+		std::atomic_bool    _fx_denoise;
+		std::atomic_bool    _fx_dereverb;
+		std::atomic<float>  _cfg_intensity;
+		std::atomic_bool    _cfg_vad;
+
+		public:
+		denoiser();
+		~denoiser();
+
+		const char* name() override;
+
+		public /* Effect Information */:
+		uint32_t input_samplerate() override;
+		uint32_t output_samplerate() override;
+
+		uint32_t input_blocksize() override;
+		uint32_t output_blocksize() override;
+
+		size_t delay() override;
+
+		public /* Wrapper Information */:
+		uint8_t channels() override;
+		void    channels(uint8_t v) override;
+
+#ifndef TONPLUGINS_DEMO
+		bool denoise_enabled() override;
+		void enable_denoise(bool v) override;
+
+		bool dereverb_enabled() override;
+		void enable_dereverb(bool v) override;
+
+		float intensity() override;
+		void  intensity(float v) override;
+
+		bool voice_activity_detection() override;
+		void voice_activity_detection(bool v) override;
+#endif
+
+		void load() override;
+
+		void clear() override;
+
+		void process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples) override;
+
+		private:
+		void process_frame(channel_t& channel, const float* input, float* output);
+	};
+} // namespace voicefx::cpu
@@ -0,0 +1,199 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "backend-passthrough.hpp"
+#include "lib.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cstring>
+#include "warning-enable.hpp"
+
+voicefx::passthrough::passthrough(uint32_t samplerate, uint32_t blocksize, size_t delay) : _lock(), _samplerate(samplerate), _blocksize(blocksize), _delay(delay), _channels(), _fx_channels(1), _fx_dirty(true), _fx_denoise(true), _fx_dereverb(false), _cfg_intensity(0.67f), _cfg_vad(false)
+{
+	D_LOG_LOUD("");
+	load();
+}
+
+voicefx::passthrough::~passthrough()
+{
+	D_LOG_LOUD("");
+}
+
+const char* voicefx::passthrough::name()
+{
+	return "Passthrough";
+}
+
+uint32_t voicefx::passthrough::input_samplerate()
+{
+	return _samplerate;
+}
+
+uint32_t voicefx::passthrough::output_samplerate()
+{
+	return _samplerate;
+}
+
+uint32_t voicefx::passthrough::input_blocksize()
+{
+	return _blocksize;
+}
+
+uint32_t voicefx::passthrough::output_blocksize()
+{
+	return _blocksize;
+}
+
+size_t voicefx::passthrough::delay()
+{
+	return _delay;
+}
+
+uint8_t voicefx::passthrough::channels()
+{
+	return _fx_channels;
+}
+
+void voicefx::passthrough::channels(uint8_t v)
+{
+	D_LOG_LOUD("Adjusting channels to %" PRIu8 ".", v);
+	if (v == 0) {
+		throw_log("Can't set channel count to 0, illegal operation.");
+	}
+
+	if (v != _fx_channels) {
+		_fx_channels = v;
+		_fx_dirty    = true;
+	}
+}
+
+#ifndef TONPLUGINS_DEMO
+bool voicefx::passthrough::denoise_enabled()
+{
+	return _fx_denoise;
+}
+
+void voicefx::passthrough::enable_denoise(bool v)
+{
+	_fx_denoise = v;
+}
+
+bool voicefx::passthrough::dereverb_enabled()
+{
+	return _fx_dereverb;
+}
+
+void voicefx::passthrough::enable_dereverb(bool v)
+{
+	_fx_dereverb = v;
+}
+
+float voicefx::passthrough::intensity()
+{
+	return _cfg_intensity;
+}
+
+void voicefx::passthrough::intensity(float v)
+{
+	_cfg_intensity = v;
+}
+
+bool voicefx::passthrough::voice_activity_detection()
+{
+	return _cfg_vad;
+}
+
+void voicefx::passthrough::voice_activity_detection(bool v)
+{
+	_cfg_vad = v;
+}
+#endif
+
+void voicefx::passthrough::load()
+{
+	D_LOG_LOUD("");
+	std::unique_lock<std::mutex> lock(_lock);
+	if (_fx_dirty) {
+		_channels.resize(_fx_channels);
+		for (auto& channel : _channels) {
+			channel.line.assign(_delay, 0.f);
+			channel.position = 0;
+		}
+		_fx_dirty = false;
+	}
+}
+
+void voicefx::passthrough::clear()
+{
+	D_LOG_LOUD("Clearing effect state.");
+	std::unique_lock<std::mutex> lock(_lock);
+	for (auto& channel : _channels) {
+		std::fill(channel.line.begin(), channel.line.end(), 0.f);
+		channel.position = 0;
+	}
+}
+
+void voicefx::passthrough::process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples)
+{
+	try {
+		D_LOG_LOUD("Processing %zu samples", input_samples);
+
+		if (_fx_dirty) {
+			load();
+		}
+
+		std::unique_lock<std::mutex> lock(_lock);
+		size_t                       samples = (input_samples / _blocksize) * _blocksize;
+		for (size_t ch = 0; ch < _channels.size(); ch++) {
+			auto&        channel = _channels[ch];
+			const float* in      = inputs[ch];
+			float*       out     = outputs[ch];
+
+			if (_delay == 0) {
+				memmove(out, in, samples * sizeof(float));
+				continue;
+			}
+
+			// Swap the input through the delay line in as few pieces as possible. Input and output may be the same.
+			for (size_t offset = 0; offset < samples;) {
+				size_t chunk = std::min(samples - offset, _delay - channel.position);
+				float* line  = channel.line.data() + channel.position;
+				for (size_t idx = 0; idx < chunk; idx++) {
+					float v           = in[offset + idx];
+					out[offset + idx] = line[idx];
+					line[idx]         = v;
+				}
+				offset += chunk;
+				channel.position = (channel.position + chunk) % _delay;
+			}
+		}
+		input_samples  = samples;
+		output_samples = samples;
+
+		D_LOG_LOUD("Used %zu samples to generate %zu samples", input_samples, output_samples);
+	} catch (std::exception const& ex) {
+		throw_log("%s", ex.what());
+	}
+}
@@ -0,0 +1,100 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "backend.hpp"
+
+#include "warning-disable.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx {
+	/** Hands audio back unchanged, only delayed.
+	 *
+	 * Stands in for a backend that failed to load. It reports the frame geometry and delay of the backend it replaces,
+	 * and delays the audio by exactly that much, so that plugin delay compensation and the dry/wet mix stay the same
+	 * whether or not the real effect is available. All settings are kept, but have no effect.
+	 */
+	class passthrough : public ::voicefx::backend {
+		struct channel_t {
+			std::vector<float> line; // Delay line, read and written at the same position.
+			size_t             position;
+		};
+
+		std::mutex _lock;
+
+		uint32_t               _samplerate;
+		uint32_t               _blocksize;
+		size_t                 _delay;
+		std::vector<channel_t> _channels;
+
+		std::atomic_uint8_t _fx_channels;
+		std::atomic_bool    _fx_dirty;
+		std::atomic_bool    _fx_denoise;
+		std::atomic_bool    _fx_dereverb;
+		std::atomic<float>  _cfg_intensity;
+		std::atomic_bool    _cfg_vad;
+
+		public:
+		passthrough(uint32_t samplerate, uint32_t blocksize, size_t delay);
+		~passthrough();
+
+		const char* name() override;
+
+		public /* Effect Information */:
+		uint32_t input_samplerate() override;
+		uint32_t output_samplerate() override;
+
+		uint32_t input_blocksize() override;
+		uint32_t output_blocksize() override;
+
+		size_t delay() override;
+
+		public /* Wrapper Information */:
+		uint8_t channels() override;
+		void    channels(uint8_t v) override;
+
+#ifndef TONPLUGINS_DEMO
+		bool denoise_enabled() override;
+		void enable_denoise(bool v) override;
+
+		bool dereverb_enabled() override;
+		void enable_dereverb(bool v) override;
+
+		float intensity() override;
+		void  intensity(float v) override;
+
+		bool voice_activity_detection() override;
+		void voice_activity_detection(bool v) override;
+#endif
+
+		void load() override;
+
+		void clear() override;
+
+		void process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples) override;
+	};
+} // namespace voicefx
@@ -0,0 +1,122 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "backend.hpp"
+#include "backend-cpu.hpp"
+#include "backend-passthrough.hpp"
+#include "lib.hpp"
+#include "nvidia-afx-effect.hpp"
+#include "util-environment.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <future>
+#include <mutex>
+#include <public.sdk/source/main/moduleinit.h>
+#include <string>
+#include "warning-enable.hpp"
+
+namespace {
+	// Runs from module load until the first backend is created, see backend::prewarm().
+	std::mutex        prewarm_lock;
+	std::future<void> prewarm_task;
+
+	std::string selected_backend()
+	{
+		return ::voicefx::environment::get("VOICEFX_BACKEND").value_or("nvidia");
+	}
+
+	void wait_for_prewarm()
+	{
+		std::unique_lock<std::mutex> lock(prewarm_lock);
+		if (prewarm_task.valid()) {
+			prewarm_task.get();
+		}
+	}
+} // namespace
+
+// The prewarm thread must be gone before anything else is torn down.
+static auto prewarm_terminator = Steinberg::ModuleTerminator([]() { wait_for_prewarm(); }, 0);
+
+voicefx::backend::~backend() {}
+
+std::shared_ptr<voicefx::backend> voicefx::backend::create()
+{
+	std::string name = selected_backend();
+
+	std::shared_ptr<backend> result;
+	if (name == "cpu") {
+		result = std::make_shared<::voicefx::cpu::denoiser>();
+	} else {
+		if (name != "nvidia") {
+			D_LOG_STATIC("Unknown backend '%s', falling back to NVIDIA Audio Effects.", name.c_str());
+		}
+
+		// Loading the same thing twice in parallel only makes both slower.
+		wait_for_prewarm();
+
+		try {
+			result = std::make_shared<::nvidia::afx::effect>();
+		} catch (std::exception const& ex) {
+			// Keep the reported delay identical, so that sessions load the same with and without the effect.
+			D_LOG_STATIC("Failed to create NVIDIA Audio Effects, audio will pass through unchanged: %s", ex.what());
+			result = std::make_shared<::voicefx::passthrough>(::nvidia::afx::effect::frame_samplerate, ::nvidia::afx::effect::frame_blocksize, ::nvidia::afx::effect::reported_delay());
+		}
+	}
+
+	D_LOG_STATIC("Using the %s backend.", result->name());
+	return result;
+}
+
+void voicefx::backend::prewarm()
+{
+	if (!::voicefx::environment::get_bool("VOICEFX_PREWARM", false) || (selected_backend() == "cpu")) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(prewarm_lock);
+	if (prewarm_task.valid()) {
+		return;
+	}
+
+	// Stereo is by far the most common layout, so warm up enough channels for it unless told otherwise.
+	uint8_t channels = static_cast<uint8_t>(std::clamp<int64_t>(::voicefx::environment::get_integer("VOICEFX_PREWARM_CHANNELS", 2), 1, 255));
+
+	prewarm_task = std::async(std::launch::async, [channels]() {
+		auto start = std::chrono::high_resolution_clock::now();
+		try {
+			// Destroying the effect right away puts its channels into the idle pool, where the keep-alive holds them
+			// and the library for the first processor to pick up.
+			auto fx = std::make_shared<::nvidia::afx::effect>();
+			fx->channels(channels);
+			fx->load();
+			fx.reset();
+			D_LOG_STATIC("Prewarmed %" PRIu8 " channels of NVIDIA Audio Effects in %.1f ms.", channels, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		} catch (std::exception const& ex) {
+			D_LOG_STATIC("Failed to prewarm NVIDIA Audio Effects: %s", ex.what());
+		}
+	});
+}
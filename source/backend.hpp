@@ -0,0 +1,107 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include "warning-enable.hpp"
+
+namespace voicefx {
+	/** Whatever turns noisy audio into clean audio.
+	 *
+	 * Backends process fixed size frames at a fixed sample rate, and the processor resamples and buffers around them.
+	 * Settings may be changed from any thread, and take effect on the next call to load() or process().
+	 */
+	class backend {
+		public:
+		virtual ~backend();
+
+		/** Human readable name, for logs.
+		 */
+		virtual const char* name() = 0;
+
+		public /* Effect Information */:
+		virtual uint32_t input_samplerate()  = 0;
+		virtual uint32_t output_samplerate() = 0;
+
+		virtual uint32_t input_blocksize()  = 0;
+		virtual uint32_t output_blocksize() = 0;
+
+		/** Delay of the processing itself in samples at the output sample rate, excluding the frame.
+		 */
+		virtual size_t delay() = 0;
+
+		public /* Wrapper Information */:
+		virtual uint8_t channels()          = 0;
+		virtual void    channels(uint8_t v) = 0;
+
+#ifndef TONPLUGINS_DEMO
+		virtual bool denoise_enabled()      = 0;
+		virtual void enable_denoise(bool v) = 0;
+
+		virtual bool dereverb_enabled()      = 0;
+		virtual void enable_dereverb(bool v) = 0;
+
+		virtual float intensity()        = 0;
+		virtual void  intensity(float v) = 0;
+
+		virtual bool voice_activity_detection()       = 0;
+		virtual void voice_activity_detection(bool v) = 0;
+#endif
+
+		/** Apply changed settings that need the backend to be rebuilt.
+		 */
+		virtual void load() = 0;
+
+		/** Forget all audio seen so far.
+		 */
+		virtual void clear() = 0;
+
+		/** Process as many whole frames as are available.
+		 *
+		 * @param input_samples Samples available per channel, replaced by the number of samples consumed.
+		 * @param output_samples Replaced by the number of samples written per channel.
+		 */
+		virtual void process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples) = 0;
+
+		public:
+		/** Create the backend selected by the VOICEFX_BACKEND environment variable.
+		 *
+		 * "nvidia" picks the NVIDIA Audio Effects, which is the default. "cpu" picks the spectral denoiser that runs on
+		 * any machine. If the selected backend fails to load, a passthrough with the same frame geometry and delay is
+		 * returned instead, so this only throws if even that fails.
+		 */
+		static std::shared_ptr<backend> create();
+
+		/** Load the selected backend in the background, if VOICEFX_PREWARM is enabled.
+		 *
+		 * Meant to be called once at module load. VOICEFX_PREWARM_CHANNELS (2 by default) channels are loaded and kept
+		 * warm by the NVIDIA Audio Effects keep-alive, and create() waits for the prewarm to finish instead of loading a
+		 * second copy in parallel.
+		 */
+		static void prewarm();
+	};
+} // namespace voicefx
@@ -23,6 +23,7 @@
 
 #include "lib.hpp"
 #include <core.hpp>
+#include "backend.hpp"
 
 #include "warning-disable.hpp"
 #include <chrono>
@@ -77,6 +78,9 @@ auto core = Steinberg::ModuleInitializer(
 			// Initialize VoiceFX library.
 			voicefx::initialize();
 			D_LOG_STATIC("Loaded v%s.", TONPLUGINS_VOICEFX_VERSION);
+
+			// Get the expensive parts of the first instance out of the way while the host is busy with other things.
+			voicefx::backend::prewarm();
 		} catch (std::exception const& ex) {
 			voicefx::core->log("Exception: %s", ex.what());
 			throw;
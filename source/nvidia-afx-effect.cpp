@@ -23,12 +23,107 @@
 
 #include "nvidia-afx-effect.hpp"
 #include "lib.hpp"
+#include "util-environment.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
 #include <nvAudioEffects.h>
+#include <public.sdk/source/main/moduleinit.h>
+#include <string>
+#include <thread>
 #include "warning-enable.hpp"
 
-nvidia::afx::effect::effect() : _lock(), _model_path(), _model_path_str()
+namespace {
+	// Threads that load effects in parallel, kept around between loads so that every instance doesn't start its own.
+	struct loader_pool_t {
+		std::mutex                         lock;
+		std::condition_variable            cv;
+		std::deque<std::function<void()>> queue;
+		std::vector<std::thread>           threads;
+		bool                               quit = false;
+
+		~loader_pool_t()
+		{
+			stop();
+		}
+
+		void main()
+		{
+			std::unique_lock<std::mutex> ul(lock);
+			while (true) {
+				cv.wait(ul, [this]() { return quit || !queue.empty(); });
+				if (queue.empty()) {
+					break;
+				}
+
+				auto task = std::move(queue.front());
+				queue.pop_front();
+				ul.unlock();
+				task();
+				task = nullptr;
+				ul.lock();
+			}
+		}
+
+		/** Run a task on one of at least the given number of threads, or right here if they're already stopped.
+		 */
+		void run(std::function<void()> task, size_t count)
+		{
+			std::unique_lock<std::mutex> ul(lock);
+			if (quit) {
+				ul.unlock();
+				task();
+				return;
+			}
+
+			while (threads.size() < count) {
+				threads.emplace_back([this]() { main(); });
+			}
+			queue.push_back(std::move(task));
+			cv.notify_one();
+		}
+
+		void stop()
+		{
+			std::vector<std::thread> stopped;
+			{
+				std::unique_lock<std::mutex> ul(lock);
+				quit = true;
+				cv.notify_all();
+				stopped = std::move(threads);
+			}
+
+			for (auto& thread : stopped) {
+				if (thread.joinable()) {
+					thread.join();
+				}
+			}
+		}
+	};
+
+	loader_pool_t& loader_pool()
+	{
+		static loader_pool_t instance;
+		return instance;
+	}
+
+	// Whether CUDA graphs won for an effect on a device, shared by every instance.
+	std::mutex                                     cuda_graph_lock;
+	std::map<std::pair<std::string, size_t>, bool> cuda_graph_choice;
+} // namespace
+
+// The prewarm is waited for before this, so nothing is loading anymore.
+static auto loader_pool_terminator = Steinberg::ModuleTerminator([]() { loader_pool().stop(); }, 5);
+
+nvidia::afx::effect::effect() : _gpu(), _lock(), _model_path(), _model_path_str()
 {
 	D_LOG_LOUD("");
 	_nvafx = ::nvidia::afx::afx::instance();
@@ -52,9 +147,15 @@ nvidia::afx::effect::~effect()
 {
 	D_LOG_LOUD("");
 	_fx.clear();
+	_gpu.reset();
 	_nvafx.reset();
 }
 
+const char* nvidia::afx::effect::name()
+{
+	return "NVIDIA Audio Effects";
+}
+
 template<>
 uint32_t nvidia::afx::effect::get(NvAFX_ParameterSelector key)
 {
@@ -154,13 +255,18 @@ uint32_t nvidia::afx::effect::output_channels()
 }
 
 size_t nvidia::afx::effect::delay()
+{
+	return reported_delay();
+}
+
+size_t nvidia::afx::effect::reported_delay()
 {
 	// The initial documentation for the denoise effect stated a latency of 72ms, which in reality ended up being 82ms.
 	// The new readme.txt in the model directory lists multiple window sizes, which appear to match observed delay.
 
 	// Measured a delay of 4896 samples at 48kHz, which includes a 960 sample local delay. Real delay is 3936 samples.
 	// With a "framesize" of 42.'6ms, it would be (2048 + 1888) samples. Seems like it is 82ms.
-	return static_cast<size_t>(82 * 480 / 10);
+	return static_cast<size_t>(82 * frame_blocksize / 10);
 }
 
 uint8_t nvidia::afx::effect::channels()
@@ -260,9 +366,16 @@ void nvidia::afx::effect::load()
 	if (_fx_dirty) {
 		D_LOG("Effect is dirty and must be reloaded.");
 
+		// Pick a device for the new channel count. Effects can't move between devices, so a different device means
+		// that all of them have to be created again.
+		size_t previous = _gpu ? _gpu->index : 0;
+		_gpu.reset();
+		_gpu       = _nvafx->assign_device(_fx_channels);
+		bool moved = _gpu && (_gpu->index != previous);
+
 		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
-		if (auto ctx = _nvafx->cuda_context(); ctx) {
-			cstk = ctx->enter();
+		if (_gpu) {
+			cstk = _gpu->context->enter();
 		}
 
 #ifdef WIN32
@@ -287,7 +400,7 @@ void nvidia::afx::effect::load()
 			_model_path_str = _model_path.generic_string();
 		}
 
-		if (_fx_model) {
+		if (_fx_model || moved) {
 			// Unload all previous effects.
 			_fx.clear();
 		} else {
@@ -298,75 +411,240 @@ void nvidia::afx::effect::load()
 		// Resize the array to fit the new number of channels.
 		_fx.resize(_fx_channels);
 
-		for (size_t channel = 0; channel < _fx_channels; channel++) {
-			auto& fx = _fx[channel];
+		D_LOG("Effect Path is now: '%s'.", _model_path_str.c_str());
+		create(effect, _fx);
+
+#ifndef TONPLUGINS_DEMO
+		// Mark configuration as dirty to force an update to all effects.
+		_cfg_dirty = true;
+#endif
+		_fx_dirty = false;
+	}
+
+#ifndef TONPLUGINS_DEMO
+	if (_cfg_dirty) {
+		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
+		if (_gpu) {
+			cstk = _gpu->context->enter();
+		}
+
+		set<float>(NVAFX_PARAM_INTENSITY_RATIO, _cfg_intensity);
+		set<bool>(NVAFX_PARAM_ENABLE_VAD, _cfg_vad);
+		_cfg_dirty = false;
+	}
+#endif
+}
+
+void nvidia::afx::effect::create(NvAFX_EffectSelector effect, std::vector<std::shared_ptr<void>>& handles)
+{
+	// Channels that already have an effect don't need anything.
+	std::vector<size_t> missing;
+	for (size_t channel = 0; channel < handles.size(); channel++) {
+		if (!handles[channel]) {
+			missing.push_back(channel);
+		}
+	}
+	if (missing.empty()) {
+		return;
+	}
+
+	// Every channel is a separate model load, which mostly waits on the driver. Doing them one after another makes
+	// surround sessions take seconds to come up, so a few loaders share the work.
+	static size_t            limit   = static_cast<size_t>(std::max<int64_t>(1, ::voicefx::environment::get_integer("VOICEFX_NVAFX_LOAD_THREADS", 4)));
+	size_t                   loaders = std::min(limit, missing.size());
+	std::atomic_size_t       next    = 0;
+	std::vector<std::string> errors(missing.size());
 
-			// If there's already an effect here, we don't need to do anything.
-			if (fx) {
-				continue;
+	auto loader = [this, effect, &handles, &missing, &next, &errors]() {
+		for (size_t idx = next++; idx < missing.size(); idx = next++) {
+			try {
+				handles[missing[idx]] = create(effect);
+			} catch (std::exception const& ex) {
+				errors[idx] = ex.what();
 			}
+		}
+	};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		// This thread loads as well, so the shared loaders only need to help out.
+		std::mutex              done_lock;
+		std::condition_variable done_cv;
+		size_t                  running = loaders - 1;
+		for (size_t idx = 1; idx < loaders; idx++) {
+			loader_pool().run(
+				[&loader, &done_lock, &done_cv, &running]() {
+					loader();
+					std::lock_guard<std::mutex> lock(done_lock);
+					running--;
+					done_cv.notify_all();
+				},
+				loaders - 1);
+		}
+		loader();
+
+		std::unique_lock<std::mutex> lock(done_lock);
+		done_cv.wait(lock, [&running]() { return running == 0; });
+	}
+	D_LOG("Loaded %zu channels in %.1f ms with %zu loaders.", missing.size(), std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(), loaders);
+
+	// Report every channel that failed, not just the first one.
+	std::string message;
+	size_t      failed = 0;
+	for (size_t idx = 0; idx < missing.size(); idx++) {
+		if (!errors[idx].empty()) {
+			message += (failed++ ? "; " : "") + std::string("channel ") + std::to_string(missing[idx]) + ": " + errors[idx];
+		}
+	}
+	if (failed > 0) {
+		throw_log("Failed to load %zu of %zu channels: %s", failed, missing.size(), message.c_str());
+	}
+}
+
+std::shared_ptr<void> nvidia::afx::effect::create(NvAFX_EffectSelector effect)
+{
+	// Contexts are per thread, and this may run on a loader thread.
+	std::shared_ptr<::nvidia::cuda::context_stack> cstk;
+	if (_gpu) {
+		cstk = _gpu->context->enter();
+	}
 
-			{ // Otherwise, create a new one just for this.
-				NvAFX_Handle pfx = nullptr;
-				if (auto error = _nvafx->CreateEffect(effect, &pfx); error != NVAFX_STATUS_SUCCESS) {
-					throw_log("Failed to create effect. (Code %08" PRIX32 ")\0", error);
+	// Effects released by earlier instances are already loaded and warm, and only need their state cleared.
+	size_t       device = _gpu ? _gpu->index : 0;
+	NvAFX_Handle pfx    = _nvafx->acquire_effect(effect, _gpu.get());
+	if (!pfx) {
+		static std::string mode       = ::voicefx::environment::get("VOICEFX_NVAFX_CUDA_GRAPH").value_or("");
+		double             frame_time = 0.;
+		if (mode == "auto") {
+			std::unique_lock<std::mutex> lock(cuda_graph_lock);
+			auto                         key = std::make_pair(std::string(effect), device);
+			if (auto kv = cuda_graph_choice.find(key); kv != cuda_graph_choice.end()) {
+				bool graphs = kv->second;
+				lock.unlock();
+				pfx = create(effect, graphs ? 0 : 1, frame_time);
+			} else {
+				// Measure both while holding the lock, so that other loaders wait for the result instead of measuring
+				// again. Timing needs a few frames even if warming up is disabled.
+				double       with_time    = 0.;
+				double       without_time = 0.;
+				NvAFX_Handle with         = create(effect, 0, with_time);
+				NvAFX_Handle without      = nullptr;
+				try {
+					without = create(effect, 1, without_time);
+				} catch (...) {
+					_nvafx->DestroyEffect(with);
+					throw;
 				}
-				fx = std::shared_ptr<void>(pfx, [](NvAFX_Handle v) { ::nvidia::afx::afx::instance()->DestroyEffect(v); });
+
+				bool graphs = (with_time <= without_time);
+				_nvafx->DestroyEffect(graphs ? without : with);
+				pfx                    = graphs ? with : without;
+				cuda_graph_choice[key] = graphs;
+				D_LOG("CUDA graphs %s for '%s' on device %zu: %.1f us per frame with, %.1f us without.", graphs ? "enabled" : "disabled", effect, device, with_time, without_time);
 			}
+		} else {
+			pfx = create(effect, (mode == "on") ? 0 : ((mode == "off") ? 1 : -1), frame_time);
 		}
+	}
+
+	// Devices live as long as the instance that the deleter holds on to.
+	return std::shared_ptr<void>(pfx, [nvafx = _nvafx, effect, gpu = _gpu.get()](NvAFX_Handle v) { nvafx->release_effect(effect, gpu, v); });
+}
 
+NvAFX_Handle nvidia::afx::effect::create(NvAFX_EffectSelector effect, int32_t disable_cuda_graph, double& frame_time)
+{
+	NvAFX_Handle pfx = nullptr;
+	if (auto error = _nvafx->CreateEffect(effect, &pfx); error != NVAFX_STATUS_SUCCESS) {
+		throw_log("Failed to create effect. (Code %08" PRIX32 ")\0", error);
+	}
+
+	try {
 		// Set model path.
-		set<const char*>(NVAFX_PARAM_MODEL_PATH, _model_path_str.c_str());
-		D_LOG("Effect Path is now: '%s'.", _model_path_str.c_str());
+		if (auto error = _nvafx->SetString(pfx, NVAFX_PARAM_MODEL_PATH, _model_path_str.c_str()); error != NVAFX_STATUS_SUCCESS) {
+			throw_log("Failed to set model path. (Code %08" PRIX32 ")\0", error);
+		}
 
 		// Automatically let the effect pick the correct GPU.
-		if (_nvafx->cuda_context()) {
-			set<bool>(NVAFX_PARAM_USER_CUDA_CONTEXT, true);
-			set<bool>(NVAFX_PARAM_USE_DEFAULT_GPU, false);
-			D_LOG("Using custom CUDA context.");
+		if (_gpu) {
+			_nvafx->SetU32(pfx, NVAFX_PARAM_USER_CUDA_CONTEXT, 1);
+			_nvafx->SetU32(pfx, NVAFX_PARAM_USE_DEFAULT_GPU, 0);
+		}
+
+		// CUDA graphs are captured during loading, so this has to be decided now.
+		if (disable_cuda_graph >= 0) {
+			if (auto error = _nvafx->SetU32(pfx, NVAFX_PARAM_DISABLE_CUDA_GRAPH, static_cast<uint32_t>(disable_cuda_graph)); error != NVAFX_STATUS_SUCCESS) {
+				throw_log("Failed to configure CUDA graphs. (Code %08" PRIX32 ")\0", error);
+			}
 		}
 
 		// Sample Rate
-		try {
-			set<uint32_t>(NVAFX_PARAM_INPUT_SAMPLE_RATE, 48000);
-			set<uint32_t>(NVAFX_PARAM_OUTPUT_SAMPLE_RATE, 48000);
-		} catch (std::exception& ex) {
-			D_LOG("Falling back to simple sample rate due error: %s", ex.what());
-			try {
-				set<uint32_t>(NVAFX_PARAM_SAMPLE_RATE, 48000);
-			} catch (std::exception& ex) {
-				throw_log("Failed to set sample rate entirely: %s", ex.what());
+		if ((_nvafx->SetU32(pfx, NVAFX_PARAM_INPUT_SAMPLE_RATE, frame_samplerate) != NVAFX_STATUS_SUCCESS) || (_nvafx->SetU32(pfx, NVAFX_PARAM_OUTPUT_SAMPLE_RATE, frame_samplerate) != NVAFX_STATUS_SUCCESS)) {
+			D_LOG("Falling back to simple sample rate.", 0);
+			if (auto error = _nvafx->SetU32(pfx, NVAFX_PARAM_SAMPLE_RATE, frame_samplerate); error != NVAFX_STATUS_SUCCESS) {
+				throw_log("Failed to set sample rate entirely. (Code %08" PRIX32 ")\0", error);
 			}
 		}
-		D_LOG("Sample Rate is now %" PRIu32 ".", 48000);
 
 		// Initialize the effect
-		for (size_t channel = 0; channel < _fx_channels; channel++) {
-			auto& fx = _fx[channel];
-			if (auto error = _nvafx->Load(fx.get()); error != NVAFX_STATUS_SUCCESS) {
-				throw_log("Failed to initialize effect. (Code %08" PRIX32 ").\0", error);
-			}
+		if (auto error = _nvafx->Load(pfx); error != NVAFX_STATUS_SUCCESS) {
+			throw_log("Failed to initialize effect. (Code %08" PRIX32 ").\0", error);
 		}
 
-#ifndef TONPLUGINS_DEMO
-		// Mark configuration as dirty to force an update to all effects.
-		_cfg_dirty = true;
-#endif
-		_fx_dirty = false;
+		// Get the slow first frames out of the way here, instead of in the host's audio callback.
+		static size_t frames = static_cast<size_t>(std::max<int64_t>(0, ::voicefx::environment::get_integer("VOICEFX_NVAFX_WARMUP_FRAMES", 8)));
+		frame_time           = warm_up(pfx, (disable_cuda_graph >= 0) ? std::max<size_t>(frames, 8) : frames);
+	} catch (...) {
+		_nvafx->DestroyEffect(pfx);
+		throw;
 	}
 
-#ifndef TONPLUGINS_DEMO
-	if (_cfg_dirty) {
-		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
-		if (auto ctx = _nvafx->cuda_context(); ctx) {
-			cstk = ctx->enter();
+	return pfx;
+}
+
+double nvidia::afx::effect::warm_up(NvAFX_Handle pfx, size_t frames)
+{
+	if (frames == 0) {
+		return 0.;
+	}
+
+	std::vector<float> idata(frame_blocksize, 0.f);
+	std::vector<float> odata(frame_blocksize, 0.f);
+	const float*       in  = idata.data();
+	float*             out = odata.data();
+
+	// Frames are steady once the last few in a row took no more than half again as long as the fastest one.
+	std::array<double, 3> recent  = {};
+	double                fastest = std::numeric_limits<double>::max();
+	double                first   = 0.;
+	size_t                frame   = 0;
+
+	auto steady = [&]() {
+		return (frame >= recent.size()) && std::all_of(recent.begin(), recent.end(), [fastest](double v) { return v <= (fastest * 1.5); });
+	};
+	for (; (frame < (frames * 4)) && ((frame < frames) || !steady()); frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		if (auto error = _nvafx->Run(pfx, &in, &out, frame_blocksize, 1); error != NVAFX_STATUS_SUCCESS) {
+			throw_log("Failed to warm up effect. (Code %08" PRIX32 ").\0", error);
 		}
+		double time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
 
-		set<float>(NVAFX_PARAM_INTENSITY_RATIO, _cfg_intensity);
-		set<bool>(NVAFX_PARAM_ENABLE_VAD, _cfg_vad);
-		_cfg_dirty = false;
+		first                         = (frame == 0) ? time : first;
+		fastest                       = std::min(fastest, time);
+		recent[frame % recent.size()] = time;
 	}
-#endif
+
+	// Warming up left silence in the effect's history.
+	if (auto error = _nvafx->Reset(pfx); error != NVAFX_STATUS_SUCCESS) {
+		throw_log("Failed to reset effect after warming up. (Code %08" PRIX32 ").\0", error);
+	}
+
+	double average = 0.;
+	for (size_t idx = 0; idx < std::min(frame, recent.size()); idx++) {
+		average += recent[idx];
+	}
+	average /= static_cast<double>(std::min(frame, recent.size()));
+	D_LOG("Warmed up with %zu frames%s, the first took %.1f us and now %.1f us.", frame, steady() ? "" : " without settling", first, average);
+	return average;
 }
 
 void nvidia::afx::effect::clear()
@@ -418,8 +696,8 @@ void nvidia::afx::effect::process(float const** inputs, size_t& input_samples, f
 		output_samples = 0;
 
 		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
-		if (auto ctx = _nvafx->cuda_context(); ctx) {
-			cstk = ctx->enter();
+		if (_gpu) {
+			cstk = _gpu->context->enter();
 		}
 
 		size_t offset = 0;
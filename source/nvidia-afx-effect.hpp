@@ -26,14 +26,16 @@
 #include <filesystem>
 #include <memory>
 #include <mutex>
+#include "backend.hpp"
 #include "nvidia-afx.hpp"
 #include "nvidia-cuda-context.hpp"
 #include "nvidia-cuda-stream.hpp"
 #include "nvidia-cuda.hpp"
 
 namespace nvidia::afx {
-	class effect {
+	class effect : public ::voicefx::backend {
 		std::shared_ptr<::nvidia::afx::afx> _nvafx;
+		std::shared_ptr<::nvidia::afx::gpu> _gpu;
 
 		std::recursive_mutex  _lock;
 		std::filesystem::path _model_path;
@@ -54,10 +56,19 @@ namespace nvidia::afx {
 		std::atomic_bool   _cfg_vad;
 #endif
 
+		public:
+		/** Frame geometry and delay of every effect, known without loading anything.
+		 */
+		static constexpr uint32_t frame_samplerate = 48000;
+		static constexpr uint32_t frame_blocksize  = 480;
+		static size_t             reported_delay();
+
 		public:
 		effect();
 		~effect();
 
+		const char* name() override;
+
 		protected:
 		template<typename T>
 		T get(NvAFX_ParameterSelector key);
@@ -65,44 +76,76 @@ namespace nvidia::afx {
 		template<typename T>
 		void set(NvAFX_ParameterSelector key, T value);
 
+		/** Fill every empty handle with a loaded effect, several at once.
+		 *
+		 * Up to VOICEFX_NVAFX_LOAD_THREADS (4 by default) effects are loaded in parallel, by the calling thread and
+		 * loader threads shared by all instances. Channels that fail stay empty, and all of their errors are thrown
+		 * together once every channel has been tried.
+		 */
+		void create(NvAFX_EffectSelector effect, std::vector<std::shared_ptr<void>>& handles);
+
+		/** Get a loaded effect for the current model, from the idle pool if possible.
+		 *
+		 * VOICEFX_NVAFX_CUDA_GRAPH picks whether new effects use CUDA graphs: "on", "off", or "auto" to load both
+		 * variants once per effect and device and keep whichever runs faster. Unset leaves it to the library.
+		 */
+		std::shared_ptr<void> create(NvAFX_EffectSelector effect);
+
+		/** Create, load and warm up a new effect.
+		 *
+		 * @param disable_cuda_graph Value for NVAFX_PARAM_DISABLE_CUDA_GRAPH, or -1 to leave the default.
+		 * @param frame_time Receives the steady-state time of one frame in microseconds.
+		 */
+		NvAFX_Handle create(NvAFX_EffectSelector effect, int32_t disable_cuda_graph, double& frame_time);
+
+		/** Run silence through a freshly loaded effect until frames take a steady amount of time.
+		 *
+		 * The first frames after loading pay for graph capture and lazy allocations, which would otherwise land in the
+		 * host's audio callback. At least VOICEFX_NVAFX_WARMUP_FRAMES (8 by default) are run, and at most four times
+		 * as many. The effect is reset afterwards.
+		 *
+		 * @return Average time of the last frames in microseconds.
+		 */
+		double warm_up(NvAFX_Handle pfx, size_t frames);
+
 		public /* Effect Information */:
-		uint32_t input_samplerate();
-		uint32_t output_samplerate();
+		uint32_t input_samplerate() override;
+		uint32_t output_samplerate() override;
 
-		uint32_t input_blocksize();
-		uint32_t output_blocksize();
+		uint32_t input_blocksize() override;
+		uint32_t output_blocksize() override;
 
 		uint32_t input_channels();
 		uint32_t output_channels();
 
-		static size_t delay();
+		size_t delay() override;
 
 		public /* Wrapper Information */:
-		uint8_t channels();
-		void    channels(uint8_t v);
+		uint8_t channels() override;
+		void    channels(uint8_t v) override;
 
 #ifndef TONPLUGINS_DEMO
-		bool denoise_enabled();
-		void enable_denoise(bool v);
+		bool denoise_enabled() override;
+		void enable_denoise(bool v) override;
 
-		bool dereverb_enabled();
-		void enable_dereverb(bool v);
+		bool dereverb_enabled() override;
+		void enable_dereverb(bool v) override;
 #endif
 
 #ifndef TONPLUGINS_DEMO
-		float intensity();
-		void  intensity(float v);
+		float intensity() override;
+		void  intensity(float v) override;
 
-		bool voice_activity_detection();
-		void voice_activity_detection(bool v);
+		bool voice_activity_detection() override;
+		void voice_activity_detection(bool v) override;
 #endif
 
-		void load();
+		void load() override;
 
-		void clear();
+		void clear() override;
 
 		void process(const float** input, float** output, size_t samples);
 
-		void process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples);
+		void process(float const** inputs, size_t& input_samples, float** outputs, size_t& output_samples) override;
 	};
 } // namespace nvidia::afx
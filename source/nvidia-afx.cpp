@@ -23,12 +23,20 @@
 
 #include "nvidia-afx.hpp"
 #include "lib.hpp"
+#include "util-environment.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <nvAudioEffects.h>
+#include <public.sdk/source/main/moduleinit.h>
 #include <string>
+#include <thread>
 #include "warning-enable.hpp"
 
 #ifdef WIN32
@@ -37,11 +45,11 @@
 #include "warning-enable.hpp"
 #endif
 
+#ifdef WIN32
 static std::filesystem::path find_nvafx_redistributable()
 {
 	D_LOG_STATIC_LOUD("");
 	{ // 1. Check the global NVAFX_SDK_DIR environment variable.
-#ifdef WIN32
 		std::vector<wchar_t> buffer;
 
 		DWORD res = GetEnvironmentVariableW(L"NVAFX_SDK_DIR", buffer.data(), 0);
@@ -50,22 +58,125 @@ static std::filesystem::path find_nvafx_redistributable()
 			GetEnvironmentVariableW(L"NVAFX_SDK_DIR", buffer.data(), static_cast<DWORD>(buffer.size()));
 			return std::filesystem::path(std::wstring(buffer.data()));
 		}
-#else
-		throw std::runtime_error("This platform is currently not supported.");
-#endif
 	}
 
 	{ // 2. If that failed, assume default path for the platform of choice.
-#ifdef WIN32
 		// TODO: Make this use KnownFolders instead.
 		return std::filesystem::path(std::wstring(L"C:\\Program Files\\NVIDIA Corporation\\NVIDIA Audio Effects SDK"));
+	}
+}
 #else
-		throw std::runtime_error("This platform is currently not supported.");
+#define ST_AFX_NAME "libnv_audiofx.so"
+
+// Places relative to the SDK root where the Linux SDK and distribution packages put the library.
+static const char* nvafx_library_locations[] = {
+	"nvafx/lib",
+	"lib",
+	"",
+};
+
+static std::filesystem::path find_nvafx_library(std::filesystem::path const& root)
+{
+	std::error_code ec;
+	for (auto location : nvafx_library_locations) {
+		auto path = (root / location) / ST_AFX_NAME;
+		if (std::filesystem::is_regular_file(path, ec)) {
+			return path;
+		}
+	}
+	return {};
+}
+
+static std::filesystem::path find_nvafx_redistributable()
+{
+	D_LOG_STATIC_LOUD("");
+	std::vector<std::filesystem::path> roots;
+
+	// 1. Check the global NVAFX_SDK_DIR environment variable.
+	if (auto v = ::voicefx::environment::get("NVAFX_SDK_DIR"); v && !v->empty()) {
+		roots.emplace_back(v.value());
+	}
+
+	// 2. Check the usual install prefixes of the SDK.
+	for (auto prefix : {"/usr/local/nvidia/audio-effects-sdk", "/opt/nvidia/audio-effects-sdk", "/usr/local/Audio_Effects_SDK", "/opt/Audio_Effects_SDK"}) {
+		roots.emplace_back(prefix);
+	}
+
+	// 3. Check everything the dynamic loader would look at. The models usually live next to the library directory, so
+	//    walk up from "lib" and "nvafx/lib" to what should be the SDK root.
+	if (auto v = ::voicefx::environment::get("LD_LIBRARY_PATH"); v) {
+		std::string_view paths = v.value();
+		while (!paths.empty()) {
+			size_t                end = std::min(paths.find(':'), paths.size());
+			std::filesystem::path path(paths.substr(0, end));
+			paths.remove_prefix(std::min(end + 1, paths.size()));
+			if (path.empty()) {
+				continue;
+			}
+
+			path = path.lexically_normal();
+			if (!path.has_filename()) {
+				path = path.parent_path();
+			}
+			if (path.filename() == "lib") {
+				path = path.parent_path();
+				if (path.filename() == "nvafx") {
+					path = path.parent_path();
+				}
+			}
+			roots.push_back(path);
+		}
+	}
+
+	for (auto const& root : roots) {
+		if (!find_nvafx_library(root).empty()) {
+			return root;
+		}
+	}
+
+	throw std::runtime_error("Unable to find the NVIDIA Audio Effects redistributable.");
+}
 #endif
+
+// Throughput grows with the number of multiprocessors and their clock, and every step in compute capability adds tensor
+// core features that TensorRT makes use of. Turing (7.5) is the oldest architecture the effects support at all.
+// Integrated devices share their memory bandwidth with the CPU.
+static float score_device(int32_t major, int32_t minor, int32_t multiprocessors, int32_t kilohertz, bool integrated)
+{
+	double capability = static_cast<double>(major) + static_cast<double>(minor) / 10.;
+	double score      = static_cast<double>(multiprocessors) * (static_cast<double>(kilohertz) / 1000000.) * (capability / 7.5);
+	if (integrated) {
+		score *= 0.5;
+	}
+	return static_cast<float>(score);
+}
+
+// Same format as nvidia-smi, for example "GPU-5a3c9f4e-1b2d-4e6f-8a9b-0c1d2e3f4a5b".
+static std::string format_uuid(::nvidia::cuda::uuid_t const& uuid)
+{
+	char buffer[64];
+	auto b = reinterpret_cast<const uint8_t*>(uuid.bytes);
+	snprintf(buffer, sizeof(buffer), "GPU-%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+	return buffer;
+}
+
+// Only the hexadecimal digits, so that "GPU-" prefixes, dashes and case don't matter.
+static std::string normalize_uuid(std::string_view uuid)
+{
+	if ((uuid.size() > 4) && ((uuid.substr(0, 4) == "GPU-") || (uuid.substr(0, 4) == "gpu-"))) {
+		uuid.remove_prefix(4);
+	}
+
+	std::string result;
+	for (char c : uuid) {
+		if (std::isxdigit(static_cast<unsigned char>(c))) {
+			result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+		}
 	}
+	return result;
 }
 
-nvidia::afx::afx::afx() : _redist_path(find_nvafx_redistributable()), _library(), _cuda(), _cuda_context()
+nvidia::afx::afx::afx() : _redist_path(find_nvafx_redistributable()), _library(), _cuda(), _gpu_lock(), _gpus(), _gpu_override(std::numeric_limits<size_t>::max()), _gpu_spread(false), _pool_lock(), _pool()
 {
 	D_LOG_LOUD("");
 #ifdef WIN32
@@ -95,7 +206,18 @@ nvidia::afx::afx::afx() : _redist_path(find_nvafx_redistributable()), _library()
 			}
 		}
 #else
-		throw std::runtime_error("This platform is currently not supported.");
+		// Prefer whatever the dynamic loader resolves on its own, so that LD_LIBRARY_PATH and the loader cache win
+		// over our guesses, just like the search path does on Windows.
+		try {
+			_library = ::tonplugins::platform::library::load(std::filesystem::path(ST_AFX_NAME));
+		} catch (...) {
+			try {
+				_library = ::tonplugins::platform::library::load(find_nvafx_library(_redist_path));
+			} catch (...) {
+				D_LOG("Failed to load the NVIDIA Audio Effects library, nothing will be available.");
+				throw std::runtime_error("Failed to load NVIDIA Audio Effects library.");
+			}
+		}
 #endif
 	}
 
@@ -117,6 +239,15 @@ nvidia::afx::afx::afx() : _redist_path(find_nvafx_redistributable()), _library()
 #undef P_AFX_LOAD_SYMBOL
 	}
 
+	{ // Without models nothing can be created, so treat them like part of the library.
+		std::error_code ec;
+		if (!std::filesystem::exists(model_path(NVAFX_EFFECT_DENOISER), ec)) {
+			std::string path = model_path(NVAFX_EFFECT_DENOISER).string();
+			D_LOG("Models are missing, expected to find them at: %s", path.c_str());
+			throw std::runtime_error("NVIDIA Audio Effects models are missing.");
+		}
+	}
+
 	{ // Log all available effects.
 		D_LOG("Loaded NVIDIA Audio Effects library, these effects are available:");
 		int                   num = 0;
@@ -127,86 +258,27 @@ nvidia::afx::afx::afx() : _redist_path(find_nvafx_redistributable()), _library()
 		}
 	}
 
-#ifndef DEFAULT_CONTEXT
-#ifndef PRIMARY_CONTEXT
-	try { // Figure out the ideal device to run the effects on.
-		auto devices = enumerate_devices();
-		struct {
-			::nvidia::cuda::device_t device;
-			::nvidia::cuda::luid_t   luid;
-			float                    score;
-		} ideal = {0, 0, 0};
-
-		_cuda = ::nvidia::cuda::cuda::get();
-
-		// ToDo: Find the device with the highest "score".
-		D_LOG("Detected %zu compatible acceleration devices:", devices.size());
-		for (size_t idx = 0; idx < devices.size(); idx++) {
-			const int32_t&           device_idx = devices.at(idx);
-			::nvidia::cuda::device_t device;
-			if (auto v = _cuda->cuDeviceGet(&device, device_idx); v != ::nvidia::cuda::result::SUCCESS) {
-				continue;
-			}
-
-			::nvidia::cuda::luid_t luid;
-			uint32_t               nodes;
-			_cuda->cuDeviceGetLuid(&luid, &nodes, device);
-
-			// FixMe: Temporarily picking the most preferred device for show.
-			if (idx == 0) {
-				ideal.device = device;
-				ideal.luid   = luid;
-			}
-
-			std::vector<char> name(256, 0);
-			_cuda->cuDeviceGetName(name.data(), static_cast<int32_t>(name.size() - 1), device);
-
-			int32_t is_integrated;
-			_cuda->cuDeviceGetAttribute(&is_integrated, ::nvidia::cuda::device_attribute::INTEGRATED, device);
-
-			std::pair<int32_t, int32_t> compute_capability;
-			_cuda->cuDeviceGetAttribute(&compute_capability.first, ::nvidia::cuda::device_attribute::COMPUTE_CAPABILITY_MAJOR, device);
-			_cuda->cuDeviceGetAttribute(&compute_capability.second, ::nvidia::cuda::device_attribute::COMPUTE_CAPABILITY_MINOR, device);
-
-			int32_t multiprocessors;
-			_cuda->cuDeviceGetAttribute(&multiprocessors, ::nvidia::cuda::device_attribute::MULTIPROCESSORS, device);
-
-			int32_t async_engines;
-			_cuda->cuDeviceGetAttribute(&async_engines, ::nvidia::cuda::device_attribute::ASYNC_ENGINES, device);
-
-			int32_t hertz;
-			_cuda->cuDeviceGetAttribute(&hertz, ::nvidia::cuda::device_attribute::KILOHERTZ, device);
-
-			D_LOG("\t[%4zu] %s (%s, Compute Compatibility %" PRId32 ".%" PRId32 ", %" PRId32 " Multiprocessors, %" PRId32 " Asynchronous Engines, %" PRId32 " kHz) [%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 "]", idx, name.data(), is_integrated ? "Integrated" : "Dedicated", // Intentional
-				  compute_capability.first, compute_capability.second, multiprocessors, async_engines, hertz, //
-				  luid.bytes[0], luid.bytes[1], luid.bytes[2], luid.bytes[3], // Intentional
-				  luid.bytes[4], luid.bytes[5], luid.bytes[6], luid.bytes[7]);
-		}
-		D_LOG("Picked acceleration device [%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 "]", ideal.luid.bytes[0], ideal.luid.bytes[1], ideal.luid.bytes[2], ideal.luid.bytes[3], // Intentional
-			  ideal.luid.bytes[4], ideal.luid.bytes[5], ideal.luid.bytes[6], ideal.luid.bytes[7]);
-
-#ifdef WIN32
-		// Initialize a dummy D3D11 context to perhaps fool some functionality into working.
-		_d3d = std::make_shared<::voicefx::windows::d3d::context>(ideal.luid);
-#endif
-
-		_cuda_context = std::make_shared<::nvidia::cuda::context>(ideal.device);
-	} catch (...) {
-		D_LOG("Failed to identify ideal acceleration devices.");
-	}
-#else
-	// Enter the primary CUDA context, if available.
-	std::shared_ptr<::nvidia::cuda::context_stack> ctx_stack;
-	if (_cuda_context) {
-		ctx_stack = _cuda_context->enter();
+	try { // Figure out which devices the effects should run on.
+		select_devices();
+	} catch (std::exception const& ex) {
+		D_LOG("Failed to identify ideal acceleration devices, leaving the choice to the library: %s", ex.what());
+		_gpus.clear();
+		_gpu_override = std::numeric_limits<size_t>::max();
 	}
-#endif
-#endif
 }
 
 nvidia::afx::afx::~afx()
 {
 	D_LOG_LOUD("");
+	for (auto& kv : _pool) {
+		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
+		if (kv.first.second) {
+			cstk = kv.first.second->context->enter();
+		}
+		DestroyEffect(kv.second);
+	}
+	_pool.clear();
+
 #ifdef WIN32
 	RemoveDllDirectory(reinterpret_cast<DLL_DIRECTORY_COOKIE>(_dll_cookie));
 #endif
@@ -279,30 +351,330 @@ std::filesystem::path nvidia::afx::afx::model_path(NvAFX_EffectSelector effect)
 	return path;
 }
 
+namespace {
+	struct singleton_t {
+		std::mutex                          lock;
+		std::shared_ptr<::nvidia::afx::afx> instance;
+		size_t                              leases = 0;
+
+		// A missing library or missing models won't fix themselves within the lifetime of a single session scan, so
+		// the failure is remembered and handed out again until a retry is due. Every failed retry doubles the wait.
+		std::string                           failure;
+		std::chrono::steady_clock::time_point failure_retry;
+		std::chrono::milliseconds             failure_interval;
+
+		// Once the last lease is gone the instance is kept alive for a while, so that recreating plugins, for example
+		// on a sample rate change, doesn't have to load everything again.
+		std::condition_variable               keeper_cv;
+		std::thread                           keeper;
+		bool                                  keeper_quit = false;
+		bool                                  keeping     = false;
+		std::chrono::steady_clock::time_point keep_until;
+
+		~singleton_t()
+		{
+			// Normally already done by the module terminator.
+			stop();
+		}
+
+		void stop()
+		{
+			std::shared_ptr<::nvidia::afx::afx> unload;
+			std::thread                         stopped;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				keeper_quit = true;
+				keeping     = false;
+				keeper_cv.notify_all();
+				stopped = std::move(keeper);
+				if (leases == 0) {
+					unload = std::move(instance);
+				}
+			}
+			if (stopped.joinable()) {
+				stopped.join();
+			}
+		}
+	};
+
+	singleton_t& singleton()
+	{
+		static singleton_t instance;
+		return instance;
+	}
+
+	void keeper_main()
+	{
+		auto&                        state = singleton();
+		std::unique_lock<std::mutex> lock(state.lock);
+		while (!state.keeper_quit) {
+			if (!state.keeping) {
+				state.keeper_cv.wait(lock);
+				continue;
+			}
+
+			if (state.keeper_cv.wait_until(lock, state.keep_until) != std::cv_status::timeout) {
+				continue;
+			}
+
+			if (state.keeping && (state.leases == 0) && (std::chrono::steady_clock::now() >= state.keep_until)) {
+				state.keeping = false;
+
+				// Unloading takes a while, don't block anyone who wants a new instance in the meantime.
+				auto instance = std::move(state.instance);
+				lock.unlock();
+				D_LOG_STATIC("Keep-alive expired, unloading NVIDIA Audio Effects.", 0);
+				instance.reset();
+				lock.lock();
+			}
+		}
+	}
+
+	void release_lease()
+	{
+		auto&                               state = singleton();
+		std::shared_ptr<::nvidia::afx::afx> instance;
+		{
+			std::unique_lock<std::mutex> lock(state.lock);
+			if (--state.leases > 0) {
+				return;
+			}
+
+			auto keep_alive = std::chrono::duration<double>(std::max(0., ::voicefx::environment::get_float("VOICEFX_NVAFX_KEEP_ALIVE", 30.)));
+			if ((keep_alive.count() > 0.) && !state.keeper_quit) {
+				state.keeping    = true;
+				state.keep_until = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(keep_alive);
+				if (!state.keeper.joinable()) {
+					state.keeper = std::thread(keeper_main);
+				}
+				state.keeper_cv.notify_all();
+				D_LOG_STATIC("Last user is gone, keeping NVIDIA Audio Effects loaded for %.1f seconds.", keep_alive.count());
+				return;
+			}
+
+			instance = std::move(state.instance);
+		}
+	}
+} // namespace
+
 std::shared_ptr<::nvidia::afx::afx> nvidia::afx::afx::instance()
 {
 	D_LOG_STATIC_LOUD("");
-	static std::mutex                        _instance_guard;
-	static std::weak_ptr<::nvidia::afx::afx> _instance;
+	auto&                        state = singleton();
+	std::unique_lock<std::mutex> lock(state.lock);
+
+	if (!state.instance) {
+		auto now = std::chrono::steady_clock::now();
+		if (!state.failure.empty() && (now < state.failure_retry)) {
+			throw std::runtime_error(state.failure);
+		}
+
+		try {
+			state.instance = std::shared_ptr<::nvidia::afx::afx>(new ::nvidia::afx::afx());
+			state.failure.clear();
+		} catch (std::exception const& ex) {
+			auto interval = std::chrono::milliseconds(std::max<int64_t>(0, ::voicefx::environment::get_integer("VOICEFX_NVAFX_RETRY_INTERVAL", 5000)));
+			if (state.failure.empty()) {
+				state.failure_interval = interval;
+			} else {
+				state.failure_interval = std::min<std::chrono::milliseconds>(state.failure_interval * 2, std::max<std::chrono::milliseconds>(interval, std::chrono::minutes(5)));
+			}
+			state.failure       = ex.what();
+			state.failure_retry = now + state.failure_interval;
+			D_LOG_STATIC("Failed to load NVIDIA Audio Effects, retrying in %lld ms at the earliest: %s", static_cast<long long>(state.failure_interval.count()), ex.what());
+			throw;
+		}
+	} else if (state.keeping) {
+		D_LOG_STATIC("Reusing NVIDIA Audio Effects kept alive from an earlier instance.", 0);
+	}
+
+	// Hand out a lease instead of the instance itself, so that we know when the last user is gone.
+	state.keeping = false;
+	state.leases++;
+	return std::shared_ptr<::nvidia::afx::afx>(state.instance.get(), [](::nvidia::afx::afx*) { release_lease(); });
+}
+
+void nvidia::afx::afx::shutdown()
+{
+	D_LOG_STATIC_LOUD("");
+	singleton().stop();
+}
+
+void nvidia::afx::afx::select_devices()
+{
+	D_LOG_LOUD("");
+	std::string selection = ::voicefx::environment::get("VOICEFX_NVAFX_DEVICE").value_or("auto");
+	_gpu_spread           = ::voicefx::environment::get_bool("VOICEFX_NVAFX_SPREAD", false);
+	if (selection == "default") {
+		D_LOG("Leaving the choice of device to the library.", 0);
+		return;
+	}
+
+	auto devices = enumerate_devices();
+	_cuda        = ::nvidia::cuda::cuda::get();
+
+	D_LOG("Detected %zu compatible acceleration devices:", devices.size());
+	for (size_t idx = 0; idx < devices.size(); idx++) {
+		auto info   = std::make_shared<::nvidia::afx::gpu>();
+		info->index = _gpus.size();
+		info->load  = 0;
+		if (auto v = _cuda->cuDeviceGet(&info->device, devices.at(idx)); v != ::nvidia::cuda::result::SUCCESS) {
+			continue;
+		}
+
+		uint32_t nodes;
+		_cuda->cuDeviceGetLuid(&info->luid, &nodes, info->device);
+		_cuda->cuDeviceGetUuid(&info->uuid, info->device);
+
+		std::vector<char> name(256, 0);
+		_cuda->cuDeviceGetName(name.data(), static_cast<int32_t>(name.size() - 1), info->device);
+		info->name = name.data();
+
+		int32_t is_integrated = 0;
+		_cuda->cuDeviceGetAttribute(&is_integrated, ::nvidia::cuda::device_attribute::INTEGRATED, info->device);
+
+		std::pair<int32_t, int32_t> compute_capability = {0, 0};
+		_cuda->cuDeviceGetAttribute(&compute_capability.first, ::nvidia::cuda::device_attribute::COMPUTE_CAPABILITY_MAJOR, info->device);
+		_cuda->cuDeviceGetAttribute(&compute_capability.second, ::nvidia::cuda::device_attribute::COMPUTE_CAPABILITY_MINOR, info->device);
+
+		int32_t multiprocessors = 0;
+		_cuda->cuDeviceGetAttribute(&multiprocessors, ::nvidia::cuda::device_attribute::MULTIPROCESSORS, info->device);
 
-	std::lock_guard<std::mutex>         lock(_instance_guard);
-	std::shared_ptr<::nvidia::afx::afx> instance;
+		int32_t async_engines = 0;
+		_cuda->cuDeviceGetAttribute(&async_engines, ::nvidia::cuda::device_attribute::ASYNC_ENGINES, info->device);
 
-	if (!_instance.expired()) {
-		instance = _instance.lock();
+		int32_t hertz = 0;
+		_cuda->cuDeviceGetAttribute(&hertz, ::nvidia::cuda::device_attribute::KILOHERTZ, info->device);
+
+		info->score = score_device(compute_capability.first, compute_capability.second, multiprocessors, hertz, is_integrated != 0);
+
+		std::string uuid = format_uuid(info->uuid);
+		D_LOG("\t[%4zu] %s (%s, Compute Compatibility %" PRId32 ".%" PRId32 ", %" PRId32 " Multiprocessors, %" PRId32 " Asynchronous Engines, %" PRId32 " kHz, Score %.1f) [%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 ":%02" PRIx8 "%02" PRIx8 "] %s", idx, info->name.c_str(), is_integrated ? "Integrated" : "Dedicated", // Intentional
+			  compute_capability.first, compute_capability.second, multiprocessors, async_engines, hertz, info->score, //
+			  info->luid.bytes[0], info->luid.bytes[1], info->luid.bytes[2], info->luid.bytes[3], // Intentional
+			  info->luid.bytes[4], info->luid.bytes[5], info->luid.bytes[6], info->luid.bytes[7], uuid.c_str());
+
+		if ((selection != "auto") && (normalize_uuid(selection) == normalize_uuid(uuid))) {
+			_gpu_override = info->index;
+		}
+		_gpus.push_back(info);
+	}
+
+	if (_gpus.empty()) {
+		D_LOG("No usable acceleration devices, leaving the choice of device to the library.", 0);
+		return;
+	}
+
+	size_t preferred = 0;
+	if (_gpu_override < _gpus.size()) {
+		preferred = _gpu_override;
+		D_LOG("Using [%4zu] %s as requested.", preferred, _gpus[preferred]->name.c_str());
+	} else {
+		if (selection != "auto") {
+			D_LOG("No acceleration device matches '%s', picking automatically.", selection.c_str());
+		}
+		for (size_t idx = 1; idx < _gpus.size(); idx++) {
+			if (_gpus[idx]->score > _gpus[preferred]->score) {
+				preferred = idx;
+			}
+		}
+		D_LOG("Picked [%4zu] %s%s.", preferred, _gpus[preferred]->name.c_str(), _gpu_spread ? ", spreading effects across all devices by load" : "");
+	}
+
+#ifdef WIN32
+	// Initialize a dummy D3D11 context to perhaps fool some functionality into working.
+	_d3d = std::make_shared<::voicefx::windows::d3d::context>(_gpus[preferred]->luid);
+#endif
+}
+
+std::shared_ptr<::nvidia::afx::gpu> nvidia::afx::afx::assign_device(size_t channels)
+{
+	// Every device lease holds a lease on the instance, so that it can still give back its load after the caller let go.
+	auto self = instance();
+
+	std::lock_guard<std::mutex> lock(_gpu_lock);
+	if (_gpus.empty()) {
+		return nullptr;
+	}
+
+	size_t pick = 0;
+	if (_gpu_override < _gpus.size()) {
+		pick = _gpu_override;
+	} else if (_gpu_spread) {
+		// Least loaded relative to how much the device can take.
+		auto cost = [channels](::nvidia::afx::gpu const& v) { return static_cast<float>(v.load + channels) / std::max(v.score, 1e-3f); };
+		for (size_t idx = 1; idx < _gpus.size(); idx++) {
+			if (cost(*_gpus[idx]) < cost(*_gpus[pick])) {
+				pick = idx;
+			}
+		}
 	} else {
-		instance  = std::shared_ptr<::nvidia::afx::afx>(new ::nvidia::afx::afx());
-		_instance = instance;
+		for (size_t idx = 1; idx < _gpus.size(); idx++) {
+			if (_gpus[idx]->score > _gpus[pick]->score) {
+				pick = idx;
+			}
+		}
+	}
+
+	auto device = _gpus[pick];
+	if (!device->context) {
+		device->context = std::make_shared<::nvidia::cuda::context>(device->device);
+	}
+	device->load += channels;
+	D_LOG("Assigned %zu channels to [%4zu] %s, which now runs %zu channels.", channels, pick, device->name.c_str(), device->load);
+
+	return std::shared_ptr<::nvidia::afx::gpu>(device.get(), [self, device, channels](::nvidia::afx::gpu*) {
+		std::lock_guard<std::mutex> lock(self->_gpu_lock);
+		device->load -= channels;
+	});
+}
+
+NvAFX_Handle nvidia::afx::afx::acquire_effect(NvAFX_EffectSelector effect, ::nvidia::afx::gpu* device)
+{
+	NvAFX_Handle handle = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_pool_lock);
+		if (auto kv = _pool.find({effect, device}); kv != _pool.end()) {
+			handle = kv->second;
+			_pool.erase(kv);
+		}
 	}
 
-	return instance;
+	if (handle) {
+		std::shared_ptr<::nvidia::cuda::context_stack> cstk;
+		if (device) {
+			cstk = device->context->enter();
+		}
+		if (auto error = Reset(handle); error != NVAFX_STATUS_SUCCESS) {
+			D_LOG("Failed to reset idle effect, discarding it. (Code %08" PRIX32 ")", error);
+			DestroyEffect(handle);
+			return nullptr;
+		}
+		D_LOG_LOUD("Reusing idle '%s' effect.", effect);
+	}
+	return handle;
 }
 
-std::shared_ptr<nvidia::cuda::context> nvidia::afx::afx::cuda_context()
+void nvidia::afx::afx::release_effect(NvAFX_EffectSelector effect, ::nvidia::afx::gpu* device, NvAFX_Handle handle)
 {
-	return _cuda_context;
+	static size_t limit = static_cast<size_t>(std::max<int64_t>(0, ::voicefx::environment::get_integer("VOICEFX_NVAFX_POOL_SIZE", 8)));
+	{
+		std::lock_guard<std::mutex> lock(_pool_lock);
+		if (_pool.size() < limit) {
+			_pool.emplace(std::make_pair(std::string(effect), device), handle);
+			return;
+		}
+	}
+
+	// Handles are usually released from the reaper thread, which isn't in any context.
+	std::shared_ptr<::nvidia::cuda::context_stack> cstk;
+	if (device) {
+		cstk = device->context->enter();
+	}
+	DestroyEffect(handle);
 }
 
+#ifdef WIN32
 void nvidia::afx::afx::windows_fix_dll_search_paths()
 {
 	D_LOG_LOUD("");
@@ -326,3 +698,6 @@ void nvidia::afx::afx::windows_fix_dll_search_paths()
 		D_LOG("Unable to add redistributable path to library search paths, load may fail.");
 	}
 }
+#endif
+
+static auto afx_terminator = Steinberg::ModuleTerminator([]() { ::nvidia::afx::afx::shutdown(); });
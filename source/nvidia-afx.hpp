@@ -28,17 +28,18 @@
 
 #include "warning-disable.hpp"
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <nvAudioEffects.h>
+#include <string>
+#include <vector>
 #include "warning-enable.hpp"
 
 #ifdef WIN32
 #include "win-d3d-context.hpp"
 #endif
 
-#define DEFAULT_CONTEXT
-#define PRIMARY_CONTEXT
-
 #define P_AFX_DEFINE_FUNCTION(name, ...)          \
 	private:                                      \
 	typedef NvAFX_Status (*t##name)(__VA_ARGS__); \
@@ -47,11 +48,35 @@
 	t##name name = nullptr;
 
 namespace nvidia::afx {
+	/** A device that effects can run on.
+	 */
+	struct gpu {
+		size_t                   index; // Position in the list of usable devices.
+		::nvidia::cuda::device_t device;
+		::nvidia::cuda::luid_t   luid;
+		::nvidia::cuda::uuid_t   uuid;
+		std::string              name;
+		float                    score;
+		size_t                   load; // Channels currently assigned to this device.
+
+		std::shared_ptr<::nvidia::cuda::context> context; // Primary context, retained on first use.
+	};
+
 	class afx {
 		std::filesystem::path                            _redist_path;
 		std::shared_ptr<::tonplugins::platform::library> _library;
 		std::shared_ptr<::nvidia::cuda::cuda>            _cuda;
-		std::shared_ptr<::nvidia::cuda::context>         _cuda_context;
+
+		// Usable devices, empty if the library picks the device itself.
+		std::mutex                        _gpu_lock;
+		std::vector<std::shared_ptr<gpu>> _gpus;
+		size_t                            _gpu_override;
+		bool                              _gpu_spread;
+
+		// Loaded effects that nobody uses right now, by effect and device. Devices stay alive as long as this does, and
+		// nullptr stands for the device the library picked itself.
+		std::mutex                                                             _pool_lock;
+		std::multimap<std::pair<std::string, ::nvidia::afx::gpu*>, NvAFX_Handle> _pool;
 
 #ifdef WIN32
 		std::shared_ptr<::voicefx::windows::d3d::context> _d3d;
@@ -68,12 +93,40 @@ namespace nvidia::afx {
 		private:
 		std::vector<int32_t> enumerate_devices();
 
+		void select_devices();
+
 		public:
 		std::filesystem::path redistributable_path();
 
 		std::filesystem::path model_path(NvAFX_EffectSelector effect);
 
-		std::shared_ptr<::nvidia::cuda::context> cuda_context();
+		/** Assign a device to a number of channels.
+		 *
+		 * VOICEFX_NVAFX_DEVICE picks the device: "auto" (the default) uses the highest scoring device, "default" leaves
+		 * the choice to the library, and anything else is matched against device UUIDs as shown by nvidia-smi. With
+		 * VOICEFX_NVAFX_SPREAD enabled, automatic assignment instead picks the device with the least load relative to
+		 * its score.
+		 *
+		 * @return The device, which counts the channels as its load until released and keeps this loaded until then, or
+		 *         nullptr if the library picks the device itself.
+		 */
+		std::shared_ptr<::nvidia::afx::gpu> assign_device(size_t channels);
+
+		/** Take a loaded effect out of the idle pool, with its state cleared.
+		 *
+		 * @param device Device the effect has to run on, as assigned by assign_device().
+		 * @return The effect, or nullptr if there is none.
+		 */
+		NvAFX_Handle acquire_effect(NvAFX_EffectSelector effect, ::nvidia::afx::gpu* device);
+
+		/** Put a loaded effect into the idle pool, or destroy it if the pool is full.
+		 *
+		 * The pool holds up to VOICEFX_NVAFX_POOL_SIZE effects (8 by default), and lives as long as this does. Effects
+		 * are only ever reset or destroyed inside the context of their device, so this may be called from any thread.
+		 *
+		 * @param device Device the effect was created on, as assigned by assign_device().
+		 */
+		void release_effect(NvAFX_EffectSelector effect, ::nvidia::afx::gpu* device, NvAFX_Handle handle);
 
 #ifdef WIN32
 		void windows_fix_dll_search_paths();
@@ -95,6 +148,16 @@ namespace nvidia::afx {
 		decltype(NvAFX_Reset)*               Reset;
 
 		public /* Singleton */:
+		/** Get the shared instance, loading it if necessary.
+		 *
+		 * The instance stays loaded for VOICEFX_NVAFX_KEEP_ALIVE seconds (30 by default) after the last user is gone.
+		 * Load failures are remembered, and rethrown without trying again until VOICEFX_NVAFX_RETRY_INTERVAL
+		 * milliseconds (5000 by default) have passed, doubling with every failed retry.
+		 */
 		static std::shared_ptr<::nvidia::afx::afx> instance();
+
+		/** Unload the shared instance once the last user is gone, and stop keeping it alive.
+		 */
+		static void shutdown();
 	};
 } // namespace nvidia::afx
@@ -0,0 +1,604 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "resampler-halfband.hpp"
+#include "lib.hpp"
+#include "resampler-polyphase.hpp"
+#include "util-simd.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "warning-enable.hpp"
+
+static constexpr double pi = 3.14159265358979323846;
+
+// Below this rate a single polyphase stage is already cheap enough.
+static constexpr uint32_t minimum_samplerate = 88200;
+
+static double bessel_i0(double x)
+{
+	double sum  = 1.;
+	double term = 1.;
+	for (size_t k = 1; k < 64; k++) {
+		term *= (x / (2. * k)) * (x / (2. * k));
+		sum += term;
+		if (term < (sum * 1e-12)) {
+			break;
+		}
+	}
+	return sum;
+}
+
+static std::shared_ptr<const voicefx::halfband::filter> create_filter(double transition, double attenuation)
+{
+	auto flt = std::make_shared<voicefx::halfband::filter>();
+
+	// Kaiser's estimate for the full length, with the transition relative to the higher rate. A halfband filter of
+	// length 4m-1 has 2m taps at an odd distance from the center, rounded up here so that the kernels don't need a
+	// tail loop.
+	double length = (attenuation - 8.) / (2.285 * 2. * pi * transition) + 1.;
+	size_t half   = static_cast<size_t>(std::ceil((length + 1.) / 4.));
+	half          = std::max<size_t>((half + 3) & ~size_t(3), 4);
+	flt->taps     = half * 2;
+	flt->delay    = half * 2 - 1;
+
+	double beta   = 0.1102 * (attenuation - 8.7);
+	double center = static_cast<double>(flt->delay);
+	double norm   = bessel_i0(beta);
+	double sum    = 0.;
+
+	std::vector<double> taps(flt->taps);
+	for (size_t idx = 0; idx < flt->taps; idx++) {
+		double t      = static_cast<double>(idx * 2) - center;
+		double x      = t * 0.5;
+		double sinc   = std::sin(pi * x) / (pi * x);
+		double r      = t / center;
+		double window = bessel_i0(beta * std::sqrt(std::max(0., 1. - r * r))) / norm;
+		taps[idx]     = 0.5 * sinc * window;
+		sum += taps[idx];
+	}
+
+	// Together with the center tap, the pass band has unity gain.
+	flt->coefficients.resize(flt->taps);
+	for (size_t idx = 0; idx < flt->taps; idx++) {
+		flt->coefficients[idx] = static_cast<float>(taps[idx] * 0.5 / sum);
+	}
+
+	D_LOG_STATIC("Created halfband filter with %zu taps and %zu samples delay.", flt->taps, flt->delay);
+	return flt;
+}
+
+static std::shared_ptr<const voicefx::halfband::filter> get_filter(double transition, double attenuation)
+{
+	static std::mutex                                                                           lock;
+	static std::map<std::tuple<int64_t, int64_t>, std::weak_ptr<const voicefx::halfband::filter>> filters;
+
+	std::lock_guard<std::mutex> lg(lock);
+	auto                        key = std::make_tuple(std::llround(transition * 1e6), std::llround(attenuation * 1e3));
+	if (auto kv = filters.find(key); kv != filters.end()) {
+		if (auto flt = kv->second.lock(); flt) {
+			return flt;
+		}
+	}
+
+	auto flt     = create_filter(transition, attenuation);
+	filters[key] = flt;
+	return flt;
+}
+
+static bool get_factors(uint32_t in_samplerate, uint32_t out_samplerate, uint32_t& mid_samplerate, size_t& stages)
+{
+	uint32_t high = std::max(in_samplerate, out_samplerate);
+	uint32_t low  = std::min(in_samplerate, out_samplerate);
+
+	// Halve the higher rate for as long as it stays exact and doesn't drop below the lower rate.
+	mid_samplerate = high;
+	stages         = 0;
+	while (((mid_samplerate % 2) == 0) && ((mid_samplerate / 2) >= low)) {
+		mid_samplerate /= 2;
+		stages++;
+	}
+	return (high >= minimum_samplerate) && (stages > 0);
+}
+
+double voicefx::halfband::design::input_delay() const
+{
+	return delay * static_cast<double>(in_samplerate) / static_cast<double>(out_samplerate);
+}
+
+bool voicefx::halfband::supported(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase)
+{
+	double attenuation, rolloff;
+	if ((in_samplerate == 0) || (out_samplerate == 0) || (phase != resampler_phase::LINEAR) || !polyphase::tier(quality, attenuation, rolloff)) {
+		return false;
+	}
+
+	uint32_t mid;
+	size_t   stages;
+	if (!get_factors(in_samplerate, out_samplerate, mid, stages)) {
+		return false;
+	}
+
+	// Whatever is left after the halfband stages has to be handled by the polyphase engine.
+	if (mid != std::min(in_samplerate, out_samplerate)) {
+		return (in_samplerate > out_samplerate) ? polyphase::supported(mid, out_samplerate, quality) : polyphase::supported(in_samplerate, mid, quality);
+	}
+	return true;
+}
+
+std::shared_ptr<const voicefx::halfband::design> voicefx::halfband::get_design(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality)
+{
+	static std::mutex                                                                   lock;
+	static std::map<std::tuple<uint32_t, uint32_t, int32_t>, std::weak_ptr<const design>> designs;
+
+	double attenuation, rolloff;
+	if (!supported(in_samplerate, out_samplerate, quality) || !polyphase::tier(quality, attenuation, rolloff)) {
+		throw_log_static("Conversion from %" PRIu32 " Hz to %" PRIu32 " Hz is not supported.", in_samplerate, out_samplerate);
+	}
+
+	std::lock_guard<std::mutex> lg(lock);
+	auto                        key = std::make_tuple(in_samplerate, out_samplerate, static_cast<int32_t>(quality));
+	if (auto kv = designs.find(key); kv != designs.end()) {
+		if (auto dsg = kv->second.lock(); dsg) {
+			return dsg;
+		}
+	}
+
+	auto dsg            = std::make_shared<design>();
+	dsg->in_samplerate  = in_samplerate;
+	dsg->out_samplerate = out_samplerate;
+	dsg->decimate       = in_samplerate > out_samplerate;
+
+	size_t count;
+	get_factors(in_samplerate, out_samplerate, dsg->mid_samplerate, count);
+	uint32_t low   = std::min(in_samplerate, out_samplerate);
+	bool     exact = (dsg->mid_samplerate == low);
+
+	// The rounded delay of the table is not good enough to line up the stages, so use the exact one.
+	dsg->delay             = 0.;
+	double fraction_delay = 0.;
+	if (!exact) {
+		dsg->fraction  = dsg->decimate ? polyphase::get_table(dsg->mid_samplerate, out_samplerate, quality) : polyphase::get_table(in_samplerate, dsg->mid_samplerate, quality);
+		fraction_delay = static_cast<double>(dsg->fraction->taps * dsg->fraction->up - 1) * 0.5 / static_cast<double>(dsg->fraction->down);
+	}
+	if (dsg->fraction && !dsg->decimate) {
+		dsg->delay += fraction_delay * static_cast<double>(out_samplerate) / static_cast<double>(dsg->mid_samplerate);
+	}
+
+	for (size_t idx = 0; idx < count; idx++) {
+		// Higher of the two rates of this stage, and whether it is the one next to the lower rate.
+		uint32_t rate    = dsg->decimate ? (in_samplerate >> idx) : (dsg->mid_samplerate << (idx + 1));
+		bool     closest = dsg->decimate ? (idx == (count - 1)) : (idx == 0);
+
+		// The stage closest to the lower rate sets the pass band if nothing follows it. Every other stage only has to
+		// keep its images and aliases out of the band of the lower rate, which needs very few taps.
+		double transition = (exact && closest) ? ((1. - rolloff) * 0.5) : (0.5 - static_cast<double>(low) / static_cast<double>(rate));
+		auto   flt        = get_filter(transition, attenuation);
+		dsg->stages.push_back(flt);
+
+		// Express the delay of the stage in output samples.
+		dsg->delay += static_cast<double>(flt->delay) * static_cast<double>(out_samplerate) / static_cast<double>(rate);
+	}
+
+	if (dsg->fraction && dsg->decimate) {
+		dsg->delay += fraction_delay;
+	}
+
+	D_LOG_STATIC("Created %" PRIu32 " Hz -> %" PRIu32 " Hz design with %zu halfband stages%s and %.2f samples delay.", in_samplerate, out_samplerate, count, dsg->fraction ? " and a fractional stage" : "", dsg->delay);
+	designs[key] = dsg;
+	return dsg;
+}
+
+voicefx::halfband::decimator::~decimator() {}
+
+voicefx::halfband::decimator::decimator(std::shared_ptr<const filter> filter, size_t channels, size_t capacity) : _filter(filter), _channels(channels), _stride(0), _even(), _odd(), _lanes(), _results(), _even_filled(0), _odd_filled(0), _position(0), _odd_next(false)
+{
+	_stride = filter->taps + (std::max<size_t>(capacity, 2) + 1) / 2;
+	_even.resize(_stride * _channels);
+	_odd.resize(_stride * _channels);
+	_lanes.resize(_channels);
+	_results.resize(_channels);
+	clear();
+}
+
+void voicefx::halfband::decimator::clear()
+{
+	// Start with a history of silence, lined up so that both arms refer to the same output sample.
+	std::fill(_even.begin(), _even.end(), 0.f);
+	std::fill(_odd.begin(), _odd.end(), 0.f);
+	_even_filled = _filter->taps - 1;
+	_odd_filled  = _filter->taps / 2;
+	_position    = 0;
+	_odd_next    = false;
+}
+
+void voicefx::halfband::decimator::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
+{
+	const size_t taps = _filter->taps;
+	const float* coef = _filter->coefficients.data();
+
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+	while (true) {
+		// Append as much input as fits, split by parity.
+		size_t take = in_buffer ? std::min(in_samples - in_samples_used, 2 * std::min(_stride - _even_filled, _stride - _odd_filled)) : 0;
+		for (size_t ch = 0; (take > 0) && (ch < _channels); ch++) {
+			const float* src  = in_buffer[ch] + in_samples_used;
+			float*       even = _even.data() + ch * _stride + _even_filled;
+			float*       odd  = _odd.data() + ch * _stride + _odd_filled;
+			size_t       idx  = 0;
+			if (_odd_next) {
+				*(odd++) = src[idx++];
+			}
+			float* arms[] = {even, odd};
+			size_t pairs  = (take - idx) / 2;
+			::voicefx::simd::deinterleave(src + idx, arms, 2, pairs);
+			if ((idx + pairs * 2) < take) {
+				even[pairs] = src[take - 1];
+			}
+		}
+		if (take > 0) {
+			size_t first = _odd_next ? 1 : 0;
+			size_t evens = (take - first + 1) / 2;
+			_even_filled += evens;
+			_odd_filled += take - evens;
+			_odd_next = ((take % 2) == 1) ? !_odd_next : _odd_next;
+			in_samples_used += take;
+		}
+
+		// Every channel walks through the same positions, so all of them are filtered together.
+		size_t count = 0;
+		while ((count < (out_samples - out_samples_generated)) && ((_position + taps) <= _even_filled) && (_position < _odd_filled)) {
+			if (_channels == 1) {
+				out_buffer[0][out_samples_generated + count] = ::voicefx::simd::dot(coef, _even.data() + _position, taps) + 0.5f * _odd[_position];
+			} else {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					_lanes[ch] = _even.data() + ch * _stride + _position;
+				}
+				::voicefx::simd::dot(coef, _lanes.data(), _results.data(), _channels, taps);
+				for (size_t ch = 0; ch < _channels; ch++) {
+					out_buffer[ch][out_samples_generated + count] = _results[ch] + 0.5f * _odd[ch * _stride + _position];
+				}
+			}
+			count++;
+			_position++;
+		}
+		out_samples_generated += count;
+
+		// Drop everything that is no longer part of the filter history.
+		if (_position > 0) {
+			for (size_t ch = 0; ch < _channels; ch++) {
+				float* even = _even.data() + ch * _stride;
+				float* odd  = _odd.data() + ch * _stride;
+				memmove(even, even + _position, (_even_filled - _position) * sizeof(float));
+				memmove(odd, odd + _position, (_odd_filled - _position) * sizeof(float));
+			}
+			_even_filled -= _position;
+			_odd_filled -= _position;
+			_position = 0;
+		}
+
+		if ((take == 0) && (count == 0)) {
+			break;
+		}
+	}
+}
+
+voicefx::halfband::interpolator::~interpolator() {}
+
+voicefx::halfband::interpolator::interpolator(std::shared_ptr<const filter> filter, size_t channels, size_t capacity) : _filter(filter), _channels(channels), _stride(0), _history(), _lanes(), _results(), _filled(0), _position(0), _odd_pending(false)
+{
+	_stride = filter->taps + std::max<size_t>(capacity, 1);
+	_history.resize(_stride * _channels);
+	_lanes.resize(_channels);
+	_results.resize(_channels);
+	clear();
+}
+
+void voicefx::halfband::interpolator::clear()
+{
+	// Start with a history of silence.
+	std::fill(_history.begin(), _history.end(), 0.f);
+	_filled      = _filter->taps - 1;
+	_position    = 0;
+	_odd_pending = false;
+}
+
+void voicefx::halfband::interpolator::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
+{
+	const size_t taps = _filter->taps;
+	const size_t half = taps / 2;
+	const float* coef = _filter->coefficients.data();
+
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+	while (true) {
+		// Append as much input as fits.
+		size_t take = in_buffer ? std::min(in_samples - in_samples_used, _stride - _filled) : 0;
+		for (size_t ch = 0; (take > 0) && (ch < _channels); ch++) {
+			memcpy(_history.data() + ch * _stride + _filled, in_buffer[ch] + in_samples_used, take * sizeof(float));
+		}
+		_filled += take;
+		in_samples_used += take;
+
+		// Each input sample produces an even output from the long arm, and an odd output from the center tap. All channels
+		// are filtered together.
+		size_t count = 0;
+		while ((count < (out_samples - out_samples_generated)) && ((_position + taps) <= _filled)) {
+			if (!_odd_pending) {
+				if (_channels == 1) {
+					out_buffer[0][out_samples_generated + count] = 2.f * ::voicefx::simd::dot(coef, _history.data() + _position, taps);
+				} else {
+					for (size_t ch = 0; ch < _channels; ch++) {
+						_lanes[ch] = _history.data() + ch * _stride + _position;
+					}
+					::voicefx::simd::dot(coef, _lanes.data(), _results.data(), _channels, taps);
+					for (size_t ch = 0; ch < _channels; ch++) {
+						out_buffer[ch][out_samples_generated + count] = 2.f * _results[ch];
+					}
+				}
+				_odd_pending = true;
+			} else {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					out_buffer[ch][out_samples_generated + count] = _history[ch * _stride + _position + half];
+				}
+				_odd_pending = false;
+				_position++;
+			}
+			count++;
+		}
+		out_samples_generated += count;
+
+		// Drop everything that is no longer part of the filter history.
+		if (_position > 0) {
+			for (size_t ch = 0; ch < _channels; ch++) {
+				float* history = _history.data() + ch * _stride;
+				memmove(history, history + _position, (_filled - _position) * sizeof(float));
+			}
+			_filled -= _position;
+			_position = 0;
+		}
+
+		if ((take == 0) && (count == 0)) {
+			break;
+		}
+	}
+}
+
+voicefx::halfband::cascade::~cascade() {}
+
+voicefx::halfband::cascade::cascade(std::shared_ptr<const design> design, size_t channels, size_t capacity) : _design(design), _decimators(), _interpolators(), _fraction(), _steps(), _channels(channels), _capacity(std::max<size_t>(capacity, 256)), _links(), _filled(), _in(channels), _out(channels)
+{
+	auto add_fraction = [this]() {
+		auto engine = std::make_shared<polyphase::engine>(_design->fraction, _channels, _capacity);
+		_fraction   = engine;
+		_steps.push_back([engine](const float* ib[], size_t is, size_t& iu, float* ob[], size_t os, size_t& og) { engine->process(ib, is, iu, ob, os, og); });
+	};
+
+	if (_design->fraction && !_design->decimate) {
+		add_fraction();
+	}
+	for (auto const& flt : _design->stages) {
+		if (_design->decimate) {
+			auto stage = std::make_shared<decimator>(flt, _channels, _capacity);
+			_decimators.push_back(stage);
+			_steps.push_back([stage](const float* ib[], size_t is, size_t& iu, float* ob[], size_t os, size_t& og) { stage->process(ib, is, iu, ob, os, og); });
+		} else {
+			auto stage = std::make_shared<interpolator>(flt, _channels, _capacity);
+			_interpolators.push_back(stage);
+			_steps.push_back([stage](const float* ib[], size_t is, size_t& iu, float* ob[], size_t os, size_t& og) { stage->process(ib, is, iu, ob, os, og); });
+		}
+	}
+	if (_design->fraction && _design->decimate) {
+		add_fraction();
+	}
+
+	_links.resize(_steps.size() - 1);
+	_filled.resize(_links.size(), 0);
+	for (auto& link : _links) {
+		link.resize(_capacity * _channels);
+	}
+}
+
+void voicefx::halfband::cascade::clear()
+{
+	for (auto& stage : _decimators) {
+		stage->clear();
+	}
+	for (auto& stage : _interpolators) {
+		stage->clear();
+	}
+	if (_fraction) {
+		_fraction->clear();
+	}
+	std::fill(_filled.begin(), _filled.end(), 0);
+}
+
+void voicefx::halfband::cascade::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
+{
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+
+	// Push data through every step until nothing moves anymore. Links that fill up simply hold back the step before.
+	bool progress = true;
+	while (progress) {
+		progress = false;
+		for (size_t step = 0; step < _steps.size(); step++) {
+			bool first = (step == 0);
+			bool last  = (step == (_steps.size() - 1));
+
+			size_t        in_count  = 0;
+			const float** in_ptrs   = nullptr;
+			size_t        out_count = 0;
+			if (first) {
+				if (in_buffer) {
+					for (size_t ch = 0; ch < _channels; ch++) {
+						_in[ch] = in_buffer[ch] + in_samples_used;
+					}
+					in_ptrs  = _in.data();
+					in_count = in_samples - in_samples_used;
+				}
+			} else {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					_in[ch] = _links[step - 1].data() + ch * _capacity;
+				}
+				in_ptrs  = _in.data();
+				in_count = _filled[step - 1];
+			}
+			if (last) {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					_out[ch] = out_buffer[ch] + out_samples_generated;
+				}
+				out_count = out_samples - out_samples_generated;
+			} else {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					_out[ch] = _links[step].data() + ch * _capacity + _filled[step];
+				}
+				out_count = _capacity - _filled[step];
+			}
+
+			size_t used = 0;
+			size_t gen  = 0;
+			_steps[step](in_ptrs, in_count, used, _out.data(), out_count, gen);
+
+			if (first) {
+				in_samples_used += used;
+			} else if (used > 0) {
+				std::vector<float>& link = _links[step - 1];
+				for (size_t ch = 0; ch < _channels; ch++) {
+					float* ptr = link.data() + ch * _capacity;
+					memmove(ptr, ptr + used, (_filled[step - 1] - used) * sizeof(float));
+				}
+				_filled[step - 1] -= used;
+			}
+			if (last) {
+				out_samples_generated += gen;
+			} else {
+				_filled[step] += gen;
+			}
+			progress |= (used > 0) || (gen > 0);
+		}
+	}
+}
+
+voicefx::halfband::splitter::~splitter() {}
+
+voicefx::halfband::splitter::splitter(std::shared_ptr<const design> down, std::shared_ptr<const design> up, size_t channels, size_t capacity) : _down(), _up(), _channels(channels), _delay(0), _capacity(0), _low(), _band(), _band_filled(0), _delayed(), _delayed_filled(0), _in(channels), _out(channels)
+{
+	if (down->fraction || up->fraction || !down->decimate || up->decimate || (down->in_samplerate != up->out_samplerate) || (down->out_samplerate != up->in_samplerate)) {
+		throw_log("Splitting requires a matching pair of pure halfband designs.");
+	}
+
+	// The round trip is a whole number of samples, as the halfband delays are odd at each stage's higher rate.
+	_delay = static_cast<size_t>(std::llround(down->input_delay() + up->delay));
+
+	// Both cascades work in bursts of a power of two samples, leave room for one burst on top of every block.
+	size_t factor = down->in_samplerate / down->out_samplerate;
+	_capacity     = std::max<size_t>(capacity, 1) + factor * 2;
+	_down         = std::make_shared<cascade>(down, channels, _capacity);
+	_up           = std::make_shared<cascade>(up, channels, _capacity);
+	_low.resize(_capacity * _channels);
+	_band.resize(_capacity * _channels);
+	_delayed.resize((_delay + _capacity) * _channels);
+	clear();
+}
+
+size_t voicefx::halfband::splitter::delay()
+{
+	return _delay;
+}
+
+void voicefx::halfband::splitter::clear()
+{
+	_down->clear();
+	_up->clear();
+	std::fill(_delayed.begin(), _delayed.end(), 0.f);
+	_delayed_filled = _delay;
+	_band_filled    = 0;
+}
+
+void voicefx::halfband::splitter::process(const float* const* in_buffer, float* const* out_buffer, size_t samples)
+{
+	size_t stride = _delay + _capacity;
+	if ((_delayed_filled + samples) > stride) {
+		throw_log("Splitter overflow, %zu samples don't fit into %zu samples.", samples, stride - _delayed_filled);
+	}
+
+	// Delay the input by exactly the round trip.
+	for (size_t ch = 0; ch < _channels; ch++) {
+		memcpy(_delayed.data() + ch * stride + _delayed_filled, in_buffer[ch], samples * sizeof(float));
+	}
+	_delayed_filled += samples;
+
+	// Go down and back up in pieces that fit into the intermediate buffers.
+	size_t done = 0;
+	while (done < samples) {
+		for (size_t ch = 0; ch < _channels; ch++) {
+			_in[ch]  = in_buffer[ch] + done;
+			_out[ch] = _low.data() + ch * _capacity;
+		}
+		size_t used = 0;
+		size_t low  = 0;
+		_down->process(_in.data(), samples - done, used, _out.data(), _capacity, low);
+		done += used;
+
+		for (size_t ch = 0; ch < _channels; ch++) {
+			_in[ch]  = _low.data() + ch * _capacity;
+			_out[ch] = _band.data() + ch * _capacity + _band_filled;
+		}
+		size_t low_used = 0;
+		size_t gen      = 0;
+		_up->process(_in.data(), low, low_used, _out.data(), _capacity - _band_filled, gen);
+		_band_filled += gen;
+		if (low_used < low) {
+			throw_log("Splitter overflow, %zu decimated samples were left over.", low - low_used);
+		}
+
+		if ((used == 0) && (gen == 0)) {
+			throw_log("Splitter stalled with %zu samples left.", samples - done);
+		}
+	}
+
+	// The round trip always produces at least as much as went in, in bursts of the decimation factor.
+	if (_band_filled < samples) {
+		throw_log("Splitter underflow, %zu samples available for %zu samples.", _band_filled, samples);
+	}
+	for (size_t ch = 0; ch < _channels; ch++) {
+		const float* delayed = _delayed.data() + ch * stride;
+		float*       band    = _band.data() + ch * _capacity;
+		float*       out     = out_buffer[ch];
+		for (size_t idx = 0; idx < samples; idx++) {
+			out[idx] = delayed[idx] - band[idx];
+		}
+		memmove(band, band + samples, (_band_filled - samples) * sizeof(float));
+		memmove(_delayed.data() + ch * stride, delayed + samples, (_delayed_filled - samples) * sizeof(float));
+	}
+	_band_filled -= samples;
+	_delayed_filled -= samples;
+}
@@ -0,0 +1,190 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "resampler.hpp"
+
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx::halfband {
+	/** Coefficients of a single 2x halfband stage.
+	 *
+	 * Only the taps at an odd distance from the center are stored. The center tap is always 0.5, and every other tap
+	 * is zero, which is what makes these stages so cheap.
+	 */
+	struct filter {
+		size_t taps;  // Stored taps, always a multiple of 8.
+		size_t delay; // At the higher of the two sample rates.
+
+		std::vector<float> coefficients;
+	};
+
+	/** A conversion split into 2x halfband stages and an optional fractional stage.
+	 *
+	 * The fractional stage always runs at the lower rates, so that the expensive sharp filtering happens on the least
+	 * amount of data.
+	 */
+	struct design {
+		uint32_t in_samplerate;
+		uint32_t out_samplerate;
+		uint32_t mid_samplerate; // Rate between the halfband stages and the fractional stage.
+		bool     decimate;
+
+		std::vector<std::shared_ptr<const filter>> stages;   // In processing order.
+		std::shared_ptr<const polyphase::table>    fraction; // Only if the rates are not a power of two apart.
+
+		double delay; // Exact group delay in output samples.
+
+		/** Group delay in input samples.
+		 */
+		double input_delay() const;
+	};
+
+	/** Check if a conversion benefits from halfband stages.
+	 *
+	 * This is the case if one side runs at 88.2 kHz or more, and is at least twice the other side.
+	 */
+	bool supported(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase = resampler_phase::LINEAR);
+
+	std::shared_ptr<const design> get_design(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality);
+
+	class decimator {
+		std::shared_ptr<const filter> _filter;
+
+		size_t             _channels;
+		size_t             _stride;
+		std::vector<float> _even; // Input samples at even positions, the long filter arm.
+		std::vector<float> _odd;  // Input samples at odd positions, only needed for the center tap.
+
+		std::vector<const float*> _lanes;   // Per channel filter input for the current output sample.
+		std::vector<float>        _results; // Per channel output for the current output sample.
+
+		size_t _even_filled;
+		size_t _odd_filled;
+		size_t _position;
+		bool   _odd_next; // Parity of the next input sample.
+
+		public:
+		~decimator();
+		decimator(std::shared_ptr<const filter> filter, size_t channels, size_t capacity);
+
+		void clear();
+
+		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
+	};
+
+	class interpolator {
+		std::shared_ptr<const filter> _filter;
+
+		size_t             _channels;
+		size_t             _stride;
+		std::vector<float> _history;
+
+		std::vector<const float*> _lanes;   // Per channel filter input for the current output sample.
+		std::vector<float>        _results; // Per channel output for the current output sample.
+
+		size_t _filled;
+		size_t _position;
+		bool   _odd_pending; // The even output of the current position was written, but the odd one was not.
+
+		public:
+		~interpolator();
+		interpolator(std::shared_ptr<const filter> filter, size_t channels, size_t capacity);
+
+		void clear();
+
+		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
+	};
+
+	class cascade {
+		typedef std::function<void(const float*[], size_t, size_t&, float*[], size_t, size_t&)> step_t;
+
+		std::shared_ptr<const design> _design;
+
+		std::vector<std::shared_ptr<decimator>>    _decimators;
+		std::vector<std::shared_ptr<interpolator>> _interpolators;
+		std::shared_ptr<polyphase::engine>         _fraction;
+		std::vector<step_t>                        _steps;
+
+		// Samples passed between steps, one buffer per link.
+		size_t                          _channels;
+		size_t                          _capacity;
+		std::vector<std::vector<float>> _links;
+		std::vector<size_t>             _filled;
+		std::vector<const float*>       _in;
+		std::vector<float*>             _out;
+
+		public:
+		~cascade();
+		cascade(std::shared_ptr<const design> design, size_t channels, size_t capacity);
+
+		void clear();
+
+		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
+	};
+
+	/** Extract everything above the band that survives a round trip through two designs.
+	 *
+	 * The input goes down and back up through the same halfband stages as the resamplers, and the result is taken
+	 * from a copy of the input that is delayed by exactly the round trip. What is left is the band that the lower
+	 * sample rate can't carry, delayed by delay() samples.
+	 */
+	class splitter {
+		std::shared_ptr<cascade> _down;
+		std::shared_ptr<cascade> _up;
+
+		size_t                    _channels;
+		size_t                    _delay;
+		size_t                    _capacity;
+		std::vector<float>        _low;      // Decimated signal.
+		std::vector<float>        _band;     // Round trip result, waiting to be subtracted.
+		size_t                    _band_filled;
+		std::vector<float>        _delayed;  // Input, delayed by the round trip.
+		size_t                    _delayed_filled;
+		std::vector<const float*> _in;
+		std::vector<float*>       _out;
+
+		public:
+		~splitter();
+
+		/** Create a new splitter.
+		 *
+		 * @param down Decimating design without a fractional stage.
+		 * @param up The matching interpolating design.
+		 * @param capacity The largest number of samples passed to process() at once.
+		 */
+		splitter(std::shared_ptr<const design> down, std::shared_ptr<const design> up, size_t channels, size_t capacity);
+
+		size_t delay();
+
+		void clear();
+
+		void process(const float* const* in_buffer, float* const* out_buffer, size_t samples);
+	};
+} // namespace voicefx::halfband
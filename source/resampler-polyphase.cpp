@@ -0,0 +1,564 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "resampler-polyphase.hpp"
+#include "lib.hpp"
+#include "resampler-minimum-phase.hpp"
+#include "util-simd.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include "warning-enable.hpp"
+
+static constexpr double pi = 3.14159265358979323846;
+
+// Only conversions with at most this many phases are handled, anything else is left to secret-rabbit-code.
+static constexpr uint32_t maximum_factor = 320;
+
+struct tier_t {
+	double attenuation; // Stop band attenuation in dB.
+	double rolloff;     // Pass band edge relative to the lower Nyquist frequency.
+};
+
+static bool get_tier(voicefx::resampler_quality quality, tier_t& tier)
+{
+	switch (quality) {
+	case voicefx::resampler_quality::FASTEST:
+		tier = {60., 0.80};
+		return true;
+	case voicefx::resampler_quality::MEDIUM:
+		tier = {90., 0.88};
+		return true;
+	case voicefx::resampler_quality::BEST:
+		tier = {120., 0.92};
+		return true;
+	default:
+		return false;
+	}
+}
+
+static const voicefx::polyphase::minimum_phase::prototype* get_prototype(voicefx::resampler_quality quality)
+{
+	switch (quality) {
+	case voicefx::resampler_quality::FASTEST:
+		return &voicefx::polyphase::minimum_phase::fastest;
+	case voicefx::resampler_quality::MEDIUM:
+		return &voicefx::polyphase::minimum_phase::medium;
+	case voicefx::resampler_quality::BEST:
+		return &voicefx::polyphase::minimum_phase::best;
+	default:
+		return nullptr;
+	}
+}
+
+static void get_factors(uint32_t in_samplerate, uint32_t out_samplerate, uint32_t& up, uint32_t& down)
+{
+	uint32_t divisor = std::gcd(in_samplerate, out_samplerate);
+	up               = out_samplerate / divisor;
+	down             = in_samplerate / divisor;
+}
+
+static double bessel_i0(double x)
+{
+	double sum  = 1.;
+	double term = 1.;
+	for (size_t k = 1; k < 64; k++) {
+		term *= (x / (2. * k)) * (x / (2. * k));
+		sum += term;
+		if (term < (sum * 1e-12)) {
+			break;
+		}
+	}
+	return sum;
+}
+
+static std::shared_ptr<const voicefx::polyphase::table> create_table(uint32_t up, uint32_t down, tier_t tier)
+{
+	auto tbl  = std::make_shared<voicefx::polyphase::table>();
+	tbl->up   = up;
+	tbl->down = down;
+
+	// Kaiser's estimate for the length, with the transition band relative to the lower sample rate. When decimating,
+	// the taps are spaced at the higher input rate, so more of them are needed for the same transition.
+	double transition = (1. - tier.rolloff) * 0.5;
+	double length     = (tier.attenuation - 8.) / (2.285 * 2. * pi * transition);
+	length *= std::max(1., static_cast<double>(down) / static_cast<double>(up));
+	tbl->taps = (static_cast<size_t>(std::ceil(length)) + 7) & ~size_t(7);
+
+	// Prototype low-pass at the up-sampled rate, with the cut-off centered in the transition band.
+	size_t length_up = tbl->taps * up;
+	double cutoff    = (1. + tier.rolloff) * 0.5 / (2. * std::max(up, down));
+	double beta      = 0.1102 * (tier.attenuation - 8.7);
+	double center    = static_cast<double>(length_up - 1) * 0.5;
+	double norm      = bessel_i0(beta);
+
+	std::vector<double> prototype(length_up);
+	double              sum = 0.;
+	for (size_t idx = 0; idx < length_up; idx++) {
+		double t      = static_cast<double>(idx) - center;
+		double x      = 2. * cutoff * t;
+		double sinc   = (std::abs(x) < 1e-12) ? 1. : std::sin(pi * x) / (pi * x);
+		double r      = t / center;
+		double window = bessel_i0(beta * std::sqrt(std::max(0., 1. - r * r))) / norm;
+		prototype[idx] = 2. * cutoff * sinc * window;
+		sum += prototype[idx];
+	}
+
+	// Each phase sees every up-th coefficient, so the prototype needs a gain of up.
+	tbl->coefficients.resize(length_up);
+	for (size_t phase = 0; phase < up; phase++) {
+		float* ptr = tbl->coefficients.data() + phase * tbl->taps;
+		for (size_t tap = 0; tap < tbl->taps; tap++) {
+			ptr[tbl->taps - 1 - tap] = static_cast<float>(prototype[phase + tap * up] * static_cast<double>(up) / sum);
+		}
+	}
+
+	// Group delay of the prototype, expressed in output samples.
+	tbl->exact_delay = center / static_cast<double>(down);
+	tbl->delay       = static_cast<size_t>(std::llround(tbl->exact_delay));
+
+	D_LOG_STATIC("Created %" PRIu32 ":%" PRIu32 " polyphase table with %zu taps per phase and %zu samples delay.", up, down, tbl->taps, tbl->delay);
+	return tbl;
+}
+
+static std::shared_ptr<const voicefx::polyphase::table> create_minimum_phase_table(uint32_t up, uint32_t down, voicefx::polyphase::minimum_phase::prototype const& proto)
+{
+	auto tbl  = std::make_shared<voicefx::polyphase::table>();
+	tbl->up   = up;
+	tbl->down = down;
+
+	// The prototype is given in samples of the lower rate, so decimation needs proportionally more taps.
+	double length = static_cast<double>(proto.length - 1) / static_cast<double>(proto.oversample);
+	length *= std::max(1., static_cast<double>(down) / static_cast<double>(up));
+	tbl->taps = (static_cast<size_t>(std::ceil(length)) + 7) & ~size_t(7);
+
+	// Sample the prototype at the up-sampled rate. Unlike the linear-phase design, the
+	// start of the prototype lines up with the newest input sample, which is what removes most of the delay.
+	size_t              length_up = tbl->taps * up;
+	double              step      = static_cast<double>(proto.oversample) / static_cast<double>(std::max(up, down));
+	std::vector<double> prototype(length_up);
+	double              sum    = 0.;
+	double              moment = 0.;
+	for (size_t idx = 0; idx < length_up; idx++) {
+		double  x     = static_cast<double>(idx) * step;
+		int64_t index = static_cast<int64_t>(std::floor(x));
+		double  t     = x - static_cast<double>(index);
+		double  p[4];
+		for (int64_t k = 0; k < 4; k++) {
+			int64_t at = index - 1 + k;
+			p[k]       = ((at >= 0) && (at < static_cast<int64_t>(proto.length))) ? static_cast<double>(proto.coefficients[at]) : 0.;
+		}
+
+		// Four point Lagrange interpolation.
+		double w0      = -t * (t - 1.) * (t - 2.) / 6.;
+		double w1      = (t + 1.) * (t - 1.) * (t - 2.) / 2.;
+		double w2      = -(t + 1.) * t * (t - 2.) / 2.;
+		double w3      = (t + 1.) * t * (t - 1.) / 6.;
+		prototype[idx] = w0 * p[0] + w1 * p[1] + w2 * p[2] + w3 * p[3];
+		sum += prototype[idx];
+		moment += prototype[idx] * static_cast<double>(idx);
+	}
+
+	// Each phase sees every up-th coefficient, so the prototype needs a gain of up.
+	tbl->coefficients.resize(length_up);
+	for (size_t phase = 0; phase < up; phase++) {
+		float* ptr = tbl->coefficients.data() + phase * tbl->taps;
+		for (size_t tap = 0; tap < tbl->taps; tap++) {
+			ptr[tbl->taps - 1 - tap] = static_cast<float>(prototype[phase + tap * up] * static_cast<double>(up) / sum);
+		}
+	}
+
+	// Group delay at DC is the centroid of the sampled prototype. Measuring it here rather than converting the delay of
+	// the prototype keeps the fraction that the interpolation and the rounding of the taps shift it by.
+	tbl->exact_delay = moment / sum / static_cast<double>(down);
+	tbl->delay       = static_cast<size_t>(std::llround(tbl->exact_delay));
+
+	D_LOG_STATIC("Created %" PRIu32 ":%" PRIu32 " minimum-phase polyphase table with %zu taps per phase and %zu samples delay.", up, down, tbl->taps, tbl->delay);
+	return tbl;
+}
+
+bool voicefx::polyphase::tier(resampler_quality quality, double& attenuation, double& rolloff)
+{
+	tier_t tier;
+	if (!get_tier(quality, tier)) {
+		return false;
+	}
+	attenuation = tier.attenuation;
+	rolloff     = tier.rolloff;
+	return true;
+}
+
+bool voicefx::polyphase::supported(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase)
+{
+	tier_t tier;
+	if ((in_samplerate == 0) || (out_samplerate == 0) || !get_tier(quality, tier)) {
+		return false;
+	}
+	if ((phase == resampler_phase::MINIMUM) && (get_prototype(quality) == nullptr)) {
+		return false;
+	}
+
+	uint32_t up, down;
+	get_factors(in_samplerate, out_samplerate, up, down);
+	return (up <= maximum_factor) && (down <= maximum_factor);
+}
+
+std::shared_ptr<const voicefx::polyphase::table> voicefx::polyphase::get_table(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase)
+{
+	static std::mutex                                                                           lock;
+	static std::map<std::tuple<uint32_t, uint32_t, int32_t, int32_t>, std::weak_ptr<const table>> tables;
+
+	tier_t tier;
+	if (!supported(in_samplerate, out_samplerate, quality, phase) || !get_tier(quality, tier)) {
+		throw_log_static("Conversion from %" PRIu32 " Hz to %" PRIu32 " Hz is not supported.", in_samplerate, out_samplerate);
+	}
+
+	uint32_t up, down;
+	get_factors(in_samplerate, out_samplerate, up, down);
+
+	std::lock_guard<std::mutex> lg(lock);
+	auto                        key = std::make_tuple(up, down, static_cast<int32_t>(quality), static_cast<int32_t>(phase));
+	if (auto kv = tables.find(key); kv != tables.end()) {
+		if (auto tbl = kv->second.lock(); tbl) {
+			return tbl;
+		}
+	}
+
+	auto tbl    = (phase == resampler_phase::MINIMUM) ? create_minimum_phase_table(up, down, *get_prototype(quality)) : create_table(up, down, tier);
+	tables[key] = tbl;
+	return tbl;
+}
+
+voicefx::polyphase::engine::~engine() {}
+
+voicefx::polyphase::engine::engine(std::shared_ptr<const table> table, size_t channels, size_t capacity) : _table(table), _channels(channels), _stride(0), _history(), _lanes(), _results(), _filled(0), _position(0), _phase(0)
+{
+	_stride = (table->taps - 1) + std::max<size_t>(capacity, 1);
+	_history.resize(_stride * _channels);
+	_lanes.resize(_channels);
+	_results.resize(_channels);
+	clear();
+}
+
+void voicefx::polyphase::engine::clear()
+{
+	// Start with a history of silence.
+	std::fill(_history.begin(), _history.end(), 0.f);
+	_filled   = _table->taps - 1;
+	_position = _table->taps - 1;
+	_phase    = 0;
+}
+
+size_t voicefx::polyphase::engine::delay()
+{
+	return _table->delay;
+}
+
+void voicefx::polyphase::engine::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
+{
+	const size_t   taps = _table->taps;
+	const uint32_t up   = _table->up;
+	const uint32_t down = _table->down;
+
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+	while (true) {
+		// Append as much input as fits.
+		size_t take = in_buffer ? std::min(in_samples - in_samples_used, _stride - _filled) : 0;
+		for (size_t ch = 0; (take > 0) && (ch < _channels); ch++) {
+			memcpy(_history.data() + ch * _stride + _filled, in_buffer[ch] + in_samples_used, take * sizeof(float));
+		}
+		_filled += take;
+		in_samples_used += take;
+
+		// Every channel walks through the same phases, so all of them are filtered together and share the loads of the
+		// coefficients. A single channel skips the bookkeeping.
+		size_t count = 0;
+		while ((count < (out_samples - out_samples_generated)) && (_position < _filled)) {
+			const float* coefficients = _table->coefficients.data() + _phase * taps;
+			if (_channels == 1) {
+				out_buffer[0][out_samples_generated + count] = ::voicefx::simd::dot(coefficients, _history.data() + _position - (taps - 1), taps);
+			} else {
+				for (size_t ch = 0; ch < _channels; ch++) {
+					_lanes[ch] = _history.data() + ch * _stride + _position - (taps - 1);
+				}
+				::voicefx::simd::dot(coefficients, _lanes.data(), _results.data(), _channels, taps);
+				for (size_t ch = 0; ch < _channels; ch++) {
+					out_buffer[ch][out_samples_generated + count] = _results[ch];
+				}
+			}
+			count++;
+
+			_phase += down;
+			_position += _phase / up;
+			_phase %= up;
+		}
+		out_samples_generated += count;
+
+		// Drop everything that is no longer part of the filter history.
+		size_t drop = std::min(_position - (taps - 1), _filled);
+		if (drop > 0) {
+			for (size_t ch = 0; ch < _channels; ch++) {
+				float* history = _history.data() + ch * _stride;
+				memmove(history, history + drop, (_filled - drop) * sizeof(float));
+			}
+			_filled -= drop;
+			_position -= drop;
+		}
+
+		if ((take == 0) && (count == 0)) {
+			break;
+		}
+	}
+}
+
+voicefx::polyphase::batch::~batch() {}
+
+voicefx::polyphase::batch::batch(std::shared_ptr<const table> table) : _table(table), _lock(), _lanes(), _ready(), _window(), _results(), _stride(0) {}
+
+std::shared_ptr<const voicefx::polyphase::table> voicefx::polyphase::batch::get_table()
+{
+	return _table;
+}
+
+void voicefx::polyphase::batch::add(lane* lane)
+{
+	// Size the scratch space for the case of every lane being converted at once, so that convert() never allocates.
+	_lanes.push_back(lane);
+	_stride = std::max(_stride, lane->history.size());
+	_ready.reserve(_lanes.size());
+	_results.reserve(_lanes.size());
+	_window.reserve(_stride * _lanes.size());
+}
+
+void voicefx::polyphase::batch::remove(lane* lane)
+{
+	_lanes.erase(std::remove(_lanes.begin(), _lanes.end(), lane), _lanes.end());
+}
+
+void voicefx::polyphase::batch::convert()
+{
+	const size_t   taps = _table->taps;
+	const uint32_t up   = _table->up;
+	const uint32_t down = _table->down;
+
+	_ready.clear();
+	for (auto lane : _lanes) {
+		if (size_t rounds = (lane->filled - (taps - 1)) / down; rounds > 0) {
+			_ready.emplace_back(rounds, lane);
+		}
+	}
+	if (_ready.empty()) {
+		return;
+	}
+
+	// Lanes with the most rounds come first, so that the lanes still converting in later rounds are always the leading
+	// ones and the rest can simply be cut off.
+	std::sort(_ready.begin(), _ready.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+	const size_t lanes  = _ready.size();
+	const size_t rounds = _ready[0].first;
+	const size_t length = (taps - 1) + rounds * down;
+
+	// Lanes are filtered in multiples of eight, which fills the registers of every instruction set, and at most 32 at a
+	// time, so that their part of the window stays in the cache while walking through all phases. Whatever is left
+	// over is filtered on its own, straight from the history, just like the engine does it.
+	constexpr size_t group = 32;
+	const size_t     wide  = lanes & ~size_t(7);
+	_window.resize(length * wide);
+	_results.resize(group);
+
+	for (size_t first = 0, last = 0; first < lanes; first = last) {
+		const size_t width = (first < wide) ? std::min(group, wide - first) : 0;
+		last               = (width > 0) ? (first + width) : lanes;
+
+		// Gather the history and pending input of every lane of the group into a column of its own.
+		float* window = _window.data() + first * length;
+		for (size_t idx = 0; idx < width; idx++) {
+			const float* history = _ready[first + idx].second->history.data();
+			size_t       used    = (taps - 1) + _ready[first + idx].first * down;
+			for (size_t pos = 0; pos < used; pos++) {
+				window[pos * width + idx] = history[pos];
+			}
+			for (size_t pos = used; pos < length; pos++) {
+				window[pos * width + idx] = 0.f;
+			}
+		}
+
+		// Each round starts at the first phase and ends down input samples later, like the engine walks through them.
+		size_t   active   = last;
+		size_t   position = taps - 1;
+		uint32_t phase    = 0;
+		for (size_t round = 0; round < rounds; round++) {
+			while ((active > first) && (_ready[active - 1].first <= round)) {
+				active--;
+			}
+			if (active == first) {
+				break;
+			}
+			size_t columns = std::min(width, ((active - first) + 7) & ~size_t(7));
+
+			for (uint32_t idx = 0; idx < up; idx++) {
+				const float* coefficients = _table->coefficients.data() + phase * taps;
+				size_t       offset       = position - (taps - 1);
+				size_t       out          = round * up + idx;
+				if (columns > 0) {
+					::voicefx::simd::dot(coefficients, window + offset * width, width, _results.data(), columns, taps);
+					for (size_t lane = first; lane < active; lane++) {
+						auto ptr                       = _ready[lane].second;
+						ptr->output[ptr->queued + out] = _results[lane - first];
+					}
+				} else {
+					for (size_t lane = first; lane < active; lane++) {
+						auto ptr                       = _ready[lane].second;
+						ptr->output[ptr->queued + out] = ::voicefx::simd::dot(coefficients, ptr->history.data() + offset, taps);
+					}
+				}
+
+				phase += down;
+				position += phase / up;
+				phase %= up;
+			}
+		}
+	}
+
+	// Drop the converted rounds from the history, and hand their output to the lanes.
+	for (auto const& [count, lane] : _ready) {
+		size_t consumed = count * down;
+		memmove(lane->history.data(), lane->history.data() + consumed, (lane->filled - consumed) * sizeof(float));
+		lane->filled -= consumed;
+		lane->queued += count * up;
+	}
+}
+
+std::shared_ptr<voicefx::polyphase::batch> voicefx::polyphase::get_batch(std::shared_ptr<const table> table)
+{
+	static std::mutex                                           lock;
+	static std::map<const polyphase::table*, std::weak_ptr<batch>> batches;
+
+	// The batch holds on to its table, so the address can't be reused by another table while the batch exists.
+	std::lock_guard<std::mutex> lg(lock);
+	if (auto kv = batches.find(table.get()); kv != batches.end()) {
+		if (auto ptr = kv->second.lock(); ptr) {
+			return ptr;
+		}
+	}
+
+	auto ptr              = std::make_shared<batch>(table);
+	batches[table.get()] = ptr;
+	return ptr;
+}
+
+voicefx::polyphase::stream::~stream()
+{
+	std::lock_guard<std::mutex> lg(_batch->_lock);
+	for (auto& lane : _lanes) {
+		_batch->remove(&lane);
+	}
+}
+
+voicefx::polyphase::stream::stream(std::shared_ptr<batch> batch, size_t channels, size_t capacity) : _batch(batch), _lanes(channels), _stride(0)
+{
+	auto const& table = *_batch->get_table();
+
+	// Up to a round of input may still be pending from earlier calls. The output has to hold everything the history can
+	// turn into, as another stream may convert it at any time.
+	_stride = (table.taps - 1) + (table.down - 1) + std::max<size_t>(capacity, 1);
+	for (auto& lane : _lanes) {
+		lane.history.resize(_stride);
+		lane.output.resize((_stride / table.down + 1) * table.up);
+	}
+
+	std::lock_guard<std::mutex> lg(_batch->_lock);
+	for (auto& lane : _lanes) {
+		lane.filled = table.taps - 1;
+		lane.queued = 0;
+		_batch->add(&lane);
+	}
+}
+
+void voicefx::polyphase::stream::clear()
+{
+	std::lock_guard<std::mutex> lg(_batch->_lock);
+	for (auto& lane : _lanes) {
+		std::fill(lane.history.begin(), lane.history.end(), 0.f);
+		lane.filled = _batch->_table->taps - 1;
+		lane.queued = 0;
+	}
+}
+
+size_t voicefx::polyphase::stream::delay()
+{
+	return _batch->_table->delay;
+}
+
+void voicefx::polyphase::stream::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
+{
+	const size_t   taps = _batch->_table->taps;
+	const uint32_t up   = _batch->_table->up;
+	const uint32_t down = _batch->_table->down;
+
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+	if (_lanes.empty()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lg(_batch->_lock);
+	auto&                       first = _lanes.front();
+
+	// Input from earlier calls is converted now, together with whatever the other streams have pending.
+	if ((first.filled - (taps - 1)) >= down) {
+		_batch->convert();
+	}
+
+	// Hand out whatever was converted so far, by this stream or any other.
+	size_t count = std::min(out_samples, first.queued);
+	if (count > 0) {
+		for (size_t ch = 0; ch < _lanes.size(); ch++) {
+			auto& lane = _lanes[ch];
+			memcpy(out_buffer[ch], lane.output.data(), count * sizeof(float));
+			memmove(lane.output.data(), lane.output.data() + count, (lane.queued - count) * sizeof(float));
+			lane.queued -= count;
+		}
+	}
+	out_samples_generated = count;
+
+	// Queue the new input, but only as much as the output of its rounds is going to fit.
+	if (in_buffer && (in_samples > 0)) {
+		size_t pending = first.filled - (taps - 1);
+		size_t limit   = ((first.output.size() - first.queued) / up) * down + (down - 1);
+		size_t take    = std::min({in_samples, _stride - first.filled, (limit > pending) ? (limit - pending) : size_t(0)});
+		for (size_t ch = 0; (take > 0) && (ch < _lanes.size()); ch++) {
+			memcpy(_lanes[ch].history.data() + _lanes[ch].filled, in_buffer[ch], take * sizeof(float));
+			_lanes[ch].filled += take;
+		}
+		in_samples_used = take;
+	}
+}
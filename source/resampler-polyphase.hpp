@@ -0,0 +1,177 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "resampler.hpp"
+
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx::polyphase {
+	/** Coefficients for a rational conversion by up/down.
+	 *
+	 * Tables are read-only once created and shared between all engines using the same conversion and quality.
+	 */
+	struct table {
+		uint32_t up;
+		uint32_t down;
+		size_t   taps;        // Per phase, always a multiple of 8.
+		size_t   delay;       // In output samples, at DC for minimum-phase tables.
+		double   exact_delay; // Same, including the fraction that delay rounds away.
+
+		// One block of taps per phase, stored reversed so that filtering is a plain inner product.
+		std::vector<float> coefficients;
+	};
+
+	/** Check if a conversion can be done by the polyphase engine.
+	 *
+	 * This is the case for the usual rate pairs like 44.1 kHz <-> 48 kHz or 96 kHz -> 48 kHz, and all sinc tiers.
+	 * Minimum-phase tables are derived from prototypes generated at build time, see tools/resampler-filters.cpp.
+	 */
+	bool supported(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase = resampler_phase::LINEAR);
+
+	/** Filter specification of a sinc tier, shared with the other engines.
+	 *
+	 * @param attenuation Stop band attenuation in dB.
+	 * @param rolloff Pass band edge relative to the lower Nyquist frequency.
+	 * @return false if the tier is not a sinc tier.
+	 */
+	bool tier(resampler_quality quality, double& attenuation, double& rolloff);
+
+	std::shared_ptr<const table> get_table(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase = resampler_phase::LINEAR);
+
+	class engine {
+		std::shared_ptr<const table> _table;
+
+		size_t             _channels;
+		size_t             _stride;
+		std::vector<float> _history;
+
+		std::vector<const float*> _lanes;   // Per channel filter input for the current output sample.
+		std::vector<float>        _results; // Per channel output for the current output sample.
+
+		size_t   _filled;   // Samples per channel in _history.
+		size_t   _position; // Index of the newest input sample needed for the next output sample.
+		uint32_t _phase;
+
+		public:
+		~engine();
+
+		/** Create a new engine.
+		 *
+		 * @param capacity The largest number of input samples accepted per channel at once.
+		 */
+		engine(std::shared_ptr<const table> table, size_t channels, size_t capacity);
+
+		void clear();
+
+		size_t delay();
+
+		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
+	};
+
+	/** Conversion of many streams at once, across all instances in the process that share a table.
+	 *
+	 * Every stream keeps its own history, but the filtering is done for all of them together with one stream per SIMD
+	 * lane. Streams are only converted in whole rounds of down input samples, after each of which the filter is back
+	 * at its first phase, so all lanes are at the same phase no matter when their streams started.
+	 *
+	 * Nothing ever waits for another stream. A stream that needs the output of its previous input converts the rounds
+	 * pending in every stream, and the other streams pick up their output on their next call. This costs one call of
+	 * latency, plus up to one round of input that is held back until it is complete.
+	 */
+	class batch {
+		public:
+		struct lane {
+			std::vector<float> history; // taps - 1 samples of history, followed by the pending input.
+			size_t             filled;
+			std::vector<float> output; // Converted samples that weren't picked up yet.
+			size_t             queued;
+		};
+
+		private:
+		std::shared_ptr<const table> _table;
+
+		std::mutex         _lock;
+		std::vector<lane*> _lanes;
+
+		// Scratch space for a conversion, only ever grown when streams are added.
+		std::vector<std::pair<size_t, lane*>> _ready; // Pending rounds and lane, most rounds first.
+		std::vector<float>                    _window;
+		std::vector<float>                    _results;
+		size_t                                _stride; // Longest history of all lanes.
+
+		public:
+		~batch();
+
+		batch(std::shared_ptr<const table> table);
+
+		std::shared_ptr<const table> get_table();
+
+		private:
+		void add(lane* lane);
+		void remove(lane* lane);
+
+		// Convert every round pending in any lane, with _lock held.
+		void convert();
+
+		friend class stream;
+	};
+
+	/** Retrieve the process-wide batch for a table.
+	 *
+	 * Thread-safe. The batch lives as long as someone holds on to it.
+	 */
+	std::shared_ptr<batch> get_batch(std::shared_ptr<const table> table);
+
+	/** A set of channels converted as part of a batch.
+	 *
+	 * Behaves like an engine, except for the latency described at batch.
+	 */
+	class stream {
+		std::shared_ptr<batch> _batch;
+
+		std::vector<batch::lane> _lanes;
+		size_t                   _stride;
+
+		public:
+		~stream();
+
+		/** Create a new stream and add it to the batch.
+		 *
+		 * @param capacity The largest number of input samples accepted per channel at once.
+		 */
+		stream(std::shared_ptr<batch> batch, size_t channels, size_t capacity);
+
+		void clear();
+
+		size_t delay();
+
+		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
+	};
+} // namespace voicefx::polyphase
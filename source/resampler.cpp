@@ -23,53 +23,223 @@
 
 #include "resampler.hpp"
 #include "lib.hpp"
+#include "resampler-halfband.hpp"
+#include "resampler-polyphase.hpp"
+#include "util-environment.hpp"
+#include "util-simd.hpp"
 
 #include "warning-disable.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
 #include <samplerate.h>
 #include <stdexcept>
+#include <tuple>
 #include "warning-enable.hpp"
 
+static constexpr double pi = 3.14159265358979323846;
+
+static bool use_polyphase(uint32_t in_samplerate, uint32_t out_samplerate, voicefx::resampler_quality quality, voicefx::resampler_phase phase)
+{
+	static bool enabled = voicefx::environment::get_bool("VOICEFX_RESAMPLER_POLYPHASE", true);
+	return enabled && voicefx::polyphase::supported(in_samplerate, out_samplerate, quality, phase);
+}
+
+static bool use_halfband(uint32_t in_samplerate, uint32_t out_samplerate, voicefx::resampler_quality quality, voicefx::resampler_phase phase)
+{
+	static bool enabled = voicefx::environment::get_bool("VOICEFX_RESAMPLER_HALFBAND", true);
+	return enabled && voicefx::halfband::supported(in_samplerate, out_samplerate, quality, phase);
+}
+
+static bool use_batch()
+{
+	// Batching costs a call of latency on every conversion, which only pays off with many instances.
+	static bool enabled = voicefx::environment::get_bool("VOICEFX_RESAMPLER_BATCH", false);
+	return enabled;
+}
+
+static int quality_to_converter(voicefx::resampler_quality quality)
+{
+	switch (quality) {
+	case voicefx::resampler_quality::LINEAR:
+		return SRC_LINEAR;
+	case voicefx::resampler_quality::FASTEST:
+		return SRC_SINC_FASTEST;
+	case voicefx::resampler_quality::MEDIUM:
+		return SRC_SINC_MEDIUM_QUALITY;
+	case voicefx::resampler_quality::BEST:
+		return SRC_SINC_BEST_QUALITY;
+	default:
+		throw std::invalid_argument("Resampler quality must be resolved before use.");
+	}
+}
+
+static double measure_delay(SRC_STATE* templ, size_t channels, uint32_t in_samplerate, uint32_t out_samplerate)
+{
+	// Work on a copy, the template has to stay untouched.
+	int  error    = 0;
+	auto instance = std::shared_ptr<SRC_STATE>(src_clone(templ, &error), [](SRC_STATE* v) { src_delete(v); });
+	if (error != 0) {
+		throw std::runtime_error(src_strerror(error));
+	}
+
+	// A single sample can fall between the output samples of the linear converter, so use a short Hann pulse that is
+	// well inside the pass band of every tier instead. Its centroid moves by exactly the group delay at DC, and with an
+	// even width it sits exactly on a sample.
+	double ratio  = static_cast<double>(out_samplerate) / static_cast<double>(in_samplerate);
+	size_t width  = 2 * static_cast<size_t>(std::ceil(16. * static_cast<double>(in_samplerate) / static_cast<double>(std::min(in_samplerate, out_samplerate))));
+	size_t frames = std::max<size_t>(in_samplerate / 2, width * 4);
+	size_t center = frames / 2;
+
+	std::vector<float> in_buffer(frames * channels, 0.f);
+	std::vector<float> out_buffer((static_cast<size_t>(std::ceil(static_cast<double>(frames) * ratio)) + 1024) * channels, 0.f);
+	for (size_t idx = 0; idx <= width; idx++) {
+		float v = static_cast<float>(0.5 - 0.5 * std::cos(2. * pi * static_cast<double>(idx) / static_cast<double>(width)));
+		for (size_t ch = 0; ch < channels; ch++) {
+			in_buffer[(center - width / 2 + idx) * channels + ch] = v;
+		}
+	}
+
+	// Feed it in host-sized blocks, the same way the plug-in does.
+	constexpr size_t block = 480;
+	size_t           used  = 0;
+	size_t           gen   = 0;
+	while (used < frames) {
+		SRC_DATA data      = {0};
+		data.data_in       = in_buffer.data() + used * channels;
+		data.data_out      = out_buffer.data() + gen * channels;
+		data.input_frames  = static_cast<long>(std::min(block, frames - used));
+		data.output_frames = static_cast<long>(out_buffer.size() / channels - gen);
+		data.src_ratio     = ratio;
+		if (int error = src_process(instance.get(), &data); error != 0) {
+			throw std::runtime_error(src_strerror(error));
+		}
+		used += static_cast<size_t>(data.input_frames_used);
+		gen += static_cast<size_t>(data.output_frames_gen);
+		if ((data.input_frames_used == 0) && (data.output_frames_gen == 0)) {
+			break;
+		}
+	}
+
+	// The latency is where the pulse ends up in the output, plus whatever output is still held back by the converter.
+	double sum    = 0.;
+	double moment = 0.;
+	for (size_t idx = 0; idx < gen; idx++) {
+		sum += out_buffer[idx * channels];
+		moment += out_buffer[idx * channels] * static_cast<double>(idx);
+	}
+	double group_delay = moment / sum - static_cast<double>(center) * ratio;
+	double held_back   = static_cast<double>(used) * ratio - static_cast<double>(gen);
+	return group_delay + held_back;
+}
+
+size_t voicefx::resampler_plan::max_output(size_t in_samples) const
+{
+	// One extra sample covers the fractional position carried over from the previous block.
+	return static_cast<size_t>((static_cast<uint64_t>(in_samples) * out_samplerate + in_samplerate - 1) / in_samplerate) + 1;
+}
+
+size_t voicefx::resampler_plan::max_input(size_t out_samples) const
+{
+	return static_cast<size_t>((static_cast<uint64_t>(out_samples) * in_samplerate + out_samplerate - 1) / out_samplerate) + 1;
+}
+
 voicefx::resampler::~resampler()
 {
 	D_LOG_LOUD("");
-	_instance.clear();
+	_halfband.reset();
+	_polyphase.reset();
+	_stream.reset();
+	_instance.reset();
+	_plan.reset();
 }
 
-voicefx::resampler::resampler() : _instance(), _channels(0), _ratio(0.0), _dirty(true)
+voicefx::resampler::resampler() : _plan(), _halfband(), _polyphase(), _stream(), _instance(), _in_interleaved(), _out_interleaved(), _in_planar(), _out_planar(), _in_capacity(1024), _out_capacity(1024), _ratio_up(1), _ratio_down(1), _consumed(0), _produced(0), _channels(0), _in_samplerate(0), _out_samplerate(0), _quality(resampler_quality::BEST), _phase(resampler_phase::LINEAR), _dirty(true)
 {
 	D_LOG_LOUD("");
 }
 
-voicefx::resampler::resampler(resampler&& r) noexcept : _instance(), _ratio(1.0), _channels(1)
+voicefx::resampler::resampler(resampler&& r) noexcept : _plan(), _halfband(), _polyphase(), _stream(), _instance(), _in_interleaved(), _out_interleaved(), _in_planar(), _out_planar(), _in_capacity(1024), _out_capacity(1024), _ratio_up(1), _ratio_down(1), _consumed(0), _produced(0), _channels(0), _in_samplerate(0), _out_samplerate(0), _quality(resampler_quality::BEST), _phase(resampler_phase::LINEAR), _dirty(true)
 {
 	D_LOG_LOUD("");
+	std::swap(_plan, r._plan);
+	std::swap(_halfband, r._halfband);
+	std::swap(_polyphase, r._polyphase);
+	std::swap(_stream, r._stream);
 	std::swap(_instance, r._instance);
-	std::swap(_ratio, r._ratio);
+	std::swap(_in_interleaved, r._in_interleaved);
+	std::swap(_out_interleaved, r._out_interleaved);
+	std::swap(_in_planar, r._in_planar);
+	std::swap(_out_planar, r._out_planar);
+	std::swap(_in_capacity, r._in_capacity);
+	std::swap(_out_capacity, r._out_capacity);
+	std::swap(_in_samplerate, r._in_samplerate);
+	std::swap(_out_samplerate, r._out_samplerate);
+	std::swap(_ratio_up, r._ratio_up);
+	std::swap(_ratio_down, r._ratio_down);
+	std::swap(_consumed, r._consumed);
+	std::swap(_produced, r._produced);
 	std::swap(_channels, r._channels);
+	std::swap(_quality, r._quality);
+	std::swap(_phase, r._phase);
 	std::swap(_dirty, r._dirty);
 }
 
 voicefx::resampler& voicefx::resampler::operator=(voicefx::resampler&& r) noexcept
 {
 	D_LOG_LOUD("");
+	std::swap(_plan, r._plan);
+	std::swap(_halfband, r._halfband);
+	std::swap(_polyphase, r._polyphase);
+	std::swap(_stream, r._stream);
 	std::swap(_instance, r._instance);
-	std::swap(_ratio, r._ratio);
+	std::swap(_in_interleaved, r._in_interleaved);
+	std::swap(_out_interleaved, r._out_interleaved);
+	std::swap(_in_planar, r._in_planar);
+	std::swap(_out_planar, r._out_planar);
+	std::swap(_in_capacity, r._in_capacity);
+	std::swap(_out_capacity, r._out_capacity);
+	std::swap(_in_samplerate, r._in_samplerate);
+	std::swap(_out_samplerate, r._out_samplerate);
+	std::swap(_ratio_up, r._ratio_up);
+	std::swap(_ratio_down, r._ratio_down);
+	std::swap(_consumed, r._consumed);
+	std::swap(_produced, r._produced);
 	std::swap(_channels, r._channels);
+	std::swap(_quality, r._quality);
+	std::swap(_phase, r._phase);
 	std::swap(_dirty, r._dirty);
 	return *this;
 }
 
-float voicefx::resampler::ratio()
+double voicefx::resampler::ratio()
 {
 	D_LOG_LOUD("");
-	return _ratio;
+	return static_cast<double>(_ratio_up) / static_cast<double>(_ratio_down);
 }
 
 void voicefx::resampler::ratio(uint32_t in_samplerate, uint32_t out_samplerate)
 {
 	D_LOG_LOUD("");
-	_ratio = static_cast<float>(in_samplerate) / static_cast<float>(out_samplerate);
+	if ((in_samplerate == 0) || (out_samplerate == 0)) {
+		throw_log("Sample rates must not be zero.");
+	}
+	if ((_in_samplerate != in_samplerate) || (_out_samplerate != out_samplerate)) {
+		// Plans and the fixed-ratio engines are built for exactly one conversion.
+		_plan.reset();
+		_halfband.reset();
+		_polyphase.reset();
+		_stream.reset();
+		_in_samplerate  = in_samplerate;
+		_out_samplerate = out_samplerate;
+		_ratio_up       = out_samplerate / std::gcd(in_samplerate, out_samplerate);
+		_ratio_down     = in_samplerate / std::gcd(in_samplerate, out_samplerate);
+		_dirty          = true;
+	}
 }
 
 size_t voicefx::resampler::channels()
@@ -81,15 +251,76 @@ size_t voicefx::resampler::channels()
 void voicefx::resampler::channels(size_t channels)
 {
 	D_LOG_LOUD("");
-	if (_channels > std::numeric_limits<int32_t>::max()) {
+	if (channels > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
 		throw_log("Channel limit exceeded.");
 	}
 	if (_channels != channels) {
+		// The channel count is fixed at creation of the state.
+		_plan.reset();
+		_halfband.reset();
+		_polyphase.reset();
+		_stream.reset();
+		_instance.reset();
 		_channels = channels;
 		_dirty    = true;
 	}
 }
 
+voicefx::resampler_quality voicefx::resampler::quality()
+{
+	D_LOG_LOUD("");
+	return _quality;
+}
+
+void voicefx::resampler::quality(resampler_quality quality)
+{
+	D_LOG_LOUD("");
+	if (quality == resampler_quality::AUTOMATIC) {
+		throw_log("Automatic quality must be resolved with automatic_quality() first.");
+	}
+	if (_quality != quality) {
+		// The converter type can't be changed on an existing state.
+		_plan.reset();
+		_halfband.reset();
+		_polyphase.reset();
+		_stream.reset();
+		_instance.reset();
+		_quality = quality;
+		_dirty   = true;
+	}
+}
+
+voicefx::resampler_phase voicefx::resampler::phase()
+{
+	D_LOG_LOUD("");
+	return _phase;
+}
+
+void voicefx::resampler::phase(resampler_phase phase)
+{
+	D_LOG_LOUD("");
+	if (_phase != phase) {
+		_plan.reset();
+		_halfband.reset();
+		_polyphase.reset();
+		_stream.reset();
+		_phase = phase;
+		_dirty = true;
+	}
+}
+
+void voicefx::resampler::reserve(size_t in_samples, size_t out_samples)
+{
+	D_LOG_LOUD("");
+	in_samples  = std::max<size_t>(in_samples, 1);
+	out_samples = std::max<size_t>(out_samples, 1);
+	if ((_in_capacity != in_samples) || (_out_capacity != out_samples)) {
+		_in_capacity  = in_samples;
+		_out_capacity = out_samples;
+		_dirty        = true;
+	}
+}
+
 void voicefx::resampler::load()
 {
 	D_LOG_LOUD("");
@@ -97,32 +328,84 @@ void voicefx::resampler::load()
 		return;
 	}
 
-	_instance.resize(_channels);
-	_instance.shrink_to_fit();
+	if (!_plan) {
+		_plan = get_plan(_in_samplerate, _out_samplerate, _quality, _channels, _phase);
+	}
 
-	for (auto& instance : _instance) {
-		if (instance) {
-			src_reset(reinterpret_cast<SRC_STATE*>(instance.get()));
-		} else {
-			int error = 0;
-			instance  = std::shared_ptr<void>(reinterpret_cast<void*>(src_new(SRC_SINC_BEST_QUALITY, static_cast<int>(_channels), &error)), [](void* v) { src_delete(reinterpret_cast<SRC_STATE*>(v)); });
-			if (error != 0) {
-				throw_log("%s", src_strerror(error));
-			}
+	if (_plan->cascade) {
+		_instance.reset();
+		_polyphase.reset();
+		_stream.reset();
+		_halfband = std::make_shared<halfband::cascade>(_plan->cascade, _channels, _in_capacity);
+		_consumed = 0;
+		_produced = 0;
+		_dirty    = false;
+		return;
+	}
+	_halfband.reset();
+
+	if (_plan->batch) {
+		_instance.reset();
+		_polyphase.reset();
+		_stream   = std::make_shared<polyphase::stream>(_plan->batch, _channels, _in_capacity);
+		_consumed = 0;
+		_produced = 0;
+		_dirty    = false;
+		return;
+	}
+	_stream.reset();
+
+	if (_plan->table) {
+		_instance.reset();
+		_polyphase = std::make_shared<polyphase::engine>(_plan->table, _channels, _in_capacity);
+		_consumed  = 0;
+		_produced  = 0;
+		_dirty     = false;
+		return;
+	}
+	_polyphase.reset();
+
+	if (_instance) {
+		src_reset(reinterpret_cast<SRC_STATE*>(_instance.get()));
+	} else {
+		// Cloning the template skips the filter setup that src_new() does.
+		int error = 0;
+		_instance = std::shared_ptr<void>(reinterpret_cast<void*>(src_clone(reinterpret_cast<SRC_STATE*>(_plan->state.get()), &error)), [](void* v) { src_delete(reinterpret_cast<SRC_STATE*>(v)); });
+		if (error != 0) {
+			_instance.reset();
+			throw_log("%s", src_strerror(error));
 		}
 	}
 
-	_dirty = false;
+	_in_interleaved.resize(_in_capacity * _channels);
+	_in_interleaved.shrink_to_fit();
+	_out_interleaved.resize(_out_capacity * _channels);
+	_out_interleaved.shrink_to_fit();
+	_in_planar.resize(_channels);
+	_out_planar.resize(_channels);
+
+	_consumed = 0;
+	_produced = 0;
+	_dirty    = false;
 }
 
 void voicefx::resampler::clear()
 {
 	D_LOG_LOUD("");
-	for (auto& instance : _instance) {
-		if (instance) {
-			src_reset(reinterpret_cast<SRC_STATE*>(instance.get()));
-		}
+	if (_halfband) {
+		_halfband->clear();
+	}
+	if (_polyphase) {
+		_polyphase->clear();
 	}
+	if (_stream) {
+		_stream->clear();
+	}
+	if (_instance) {
+		src_reset(reinterpret_cast<SRC_STATE*>(_instance.get()));
+	}
+	_consumed = 0;
+	_produced = 0;
 }
 
 void voicefx::resampler::process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated)
@@ -133,80 +416,299 @@ void voicefx::resampler::process(const float* in_buffer[], size_t in_samples, si
 		load();
 	}
 
+	if (_halfband) {
+		_halfband->process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+		_consumed += in_samples_used;
+		_produced += out_samples_generated;
+		return;
+	}
+
+	if (_polyphase) {
+		_polyphase->process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+		_consumed += in_samples_used;
+		_produced += out_samples_generated;
+		return;
+	}
+
+	if (_stream) {
+		_stream->process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+		_consumed += in_samples_used;
+		_produced += out_samples_generated;
+		return;
+	}
+
+	in_samples_used       = 0;
+	out_samples_generated = 0;
+
 	// Prepare the data object.
-	SRC_DATA data      = {0};
-	data.input_frames  = static_cast<long>(in_samples);
-	data.output_frames = static_cast<long>(out_samples);
-	data.end_of_input  = in_buffer == nullptr ? true : false;
-	data.src_ratio     = _ratio;
-
-	// Process each channel.
-	for (size_t idx = 0; idx < _channels; idx++) {
-		auto& instance = _instance[idx];
-
-		data.data_in           = in_buffer[idx];
-		data.data_out          = out_buffer[idx];
+	SRC_DATA data     = {0};
+	data.data_in      = _in_interleaved.data();
+	data.data_out     = _out_interleaved.data();
+	data.end_of_input = in_buffer == nullptr ? true : false;
+	data.src_ratio    = ratio();
+
+	// Convert in chunks that fit into the interleaving buffers.
+	while (out_samples_generated < out_samples) {
+		size_t in_chunk  = in_buffer ? std::min(in_samples - in_samples_used, _in_capacity) : 0;
+		size_t out_chunk = std::min(out_samples - out_samples_generated, _out_capacity);
+
+		if (in_chunk > 0) {
+			for (size_t idx = 0; idx < _channels; idx++) {
+				_in_planar[idx] = in_buffer[idx] + in_samples_used;
+			}
+			::voicefx::simd::interleave(_in_planar.data(), _in_interleaved.data(), _channels, in_chunk);
+		}
+
+		data.input_frames      = static_cast<long>(in_chunk);
+		data.output_frames     = static_cast<long>(out_chunk);
 		data.input_frames_used = 0;
 		data.output_frames_gen = 0;
-
-		if (int error = src_process(reinterpret_cast<SRC_STATE*>(instance.get()), &data); error != 0) {
+		if (int error = src_process(reinterpret_cast<SRC_STATE*>(_instance.get()), &data); error != 0) {
 			throw_log("%s", src_strerror(error));
 		}
 
-		in_samples_used       = data.input_frames_used;
-		out_samples_generated = data.output_frames_gen;
+		if (data.output_frames_gen > 0) {
+			for (size_t idx = 0; idx < _channels; idx++) {
+				_out_planar[idx] = out_buffer[idx] + out_samples_generated;
+			}
+			::voicefx::simd::deinterleave(_out_interleaved.data(), _out_planar.data(), _channels, static_cast<size_t>(data.output_frames_gen));
+		}
+
+		in_samples_used += static_cast<size_t>(data.input_frames_used);
+		out_samples_generated += static_cast<size_t>(data.output_frames_gen);
+
+		// Stop once the converter no longer makes progress, it needs more input or more output space.
+		if ((data.input_frames_used == 0) && (data.output_frames_gen == 0)) {
+			break;
+		}
 	}
+
+	_consumed += in_samples_used;
+	_produced += out_samples_generated;
 }
 
-size_t voicefx::resampler::calculate_delay(uint32_t in_samplerate, uint32_t out_samplerate)
+uint64_t voicefx::resampler::consumed()
+{
+	return _consumed;
+}
+
+uint64_t voicefx::resampler::produced()
+{
+	return _produced;
+}
+
+int64_t voicefx::resampler::drift()
+{
+	// Split the multiplication so that it can't overflow even for weeks of audio at unusual ratios.
+	uint64_t expected = (_consumed / _ratio_down) * _ratio_up + ((_consumed % _ratio_down) * _ratio_up) / _ratio_down;
+	return static_cast<int64_t>(_produced) - static_cast<int64_t>(expected);
+}
+
+std::shared_ptr<const voicefx::resampler_plan> voicefx::resampler::get_plan(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, size_t channels, resampler_phase phase)
 {
 	D_LOG_STATIC_LOUD("");
-	int  error    = 0;
-	auto instance = src_new(SRC_SINC_BEST_QUALITY, 1, &error);
-	if (error != 0) {
-		throw_log_static("%s", src_strerror(error));
-	}
-
-	// Calculate the ratio for the conversion.
-	float sr_ratio = static_cast<float>(in_samplerate) / static_cast<float>(out_samplerate);
-
-	// Prepare some data.
-	SRC_DATA data = {0};
-	float    in_buffer[1024];
-	float    out_buffer[1024];
-	memset(in_buffer, 0, sizeof(in_buffer));
-	memset(out_buffer, 0, sizeof(out_buffer));
-	in_buffer[0]           = 1.;
-	in_buffer[1]           = -1.;
-	data.data_in           = in_buffer;
-	data.data_out          = out_buffer;
-	data.input_frames      = static_cast<long>(sizeof(in_buffer) / sizeof(*in_buffer));
-	data.output_frames     = static_cast<long>(sizeof(out_buffer) / sizeof(*out_buffer));
-	data.input_frames_used = 0;
-	data.output_frames_gen = data.output_frames;
-	data.end_of_input      = 0;
-	data.src_ratio         = sr_ratio;
-
-	// Calculate the delay
-	for (size_t delay = 0; delay < in_samplerate; delay++) {
-		data.input_frames      = static_cast<long>(sizeof(in_buffer) / sizeof(*in_buffer));
-		data.output_frames     = static_cast<long>(sizeof(out_buffer) / sizeof(*out_buffer));
-		data.input_frames_used = 0;
-		data.output_frames_gen = data.output_frames;
-		data.end_of_input      = 0;
-		data.src_ratio         = sr_ratio;
+	static std::mutex                                                                                            lock;
+	static std::map<std::tuple<uint32_t, uint32_t, int32_t, int32_t, size_t>, std::shared_ptr<const resampler_plan>> plans;
+
+	if ((channels == 0) || (channels > static_cast<size_t>(std::numeric_limits<int32_t>::max()))) {
+		throw_log_static("Channel count %zu is not supported.", channels);
+	}
+
+	// Only the polyphase engine has minimum-phase filters, anything else falls back to linear phase.
+	if ((phase == resampler_phase::MINIMUM) && !use_polyphase(in_samplerate, out_samplerate, quality, phase)) {
+		phase = resampler_phase::LINEAR;
+	}
 
-		if (int error = src_process(instance, &data); error != 0) {
+	// Plans are small and few, so they are kept for the lifetime of the process.
+	std::lock_guard<std::mutex> lg(lock);
+	auto                        key = std::make_tuple(in_samplerate, out_samplerate, static_cast<int32_t>(quality), static_cast<int32_t>(phase), channels);
+	if (auto kv = plans.find(key); kv != plans.end()) {
+		return kv->second;
+	}
+
+	auto plan            = std::make_shared<resampler_plan>();
+	plan->in_samplerate  = in_samplerate;
+	plan->out_samplerate = out_samplerate;
+	plan->quality        = quality;
+	plan->phase          = phase;
+	plan->channels       = channels;
+	plan->round          = 0;
+
+	if ((phase == resampler_phase::LINEAR) && use_halfband(in_samplerate, out_samplerate, quality, phase)) {
+		// High sample rates are cheaper to bring down in steps of two, with whatever is left done at the lower rate.
+		plan->cascade     = halfband::get_design(in_samplerate, out_samplerate, quality);
+		plan->exact_delay = plan->cascade->delay;
+		plan->delay       = static_cast<size_t>(std::llround(plan->exact_delay));
+	} else if (use_polyphase(in_samplerate, out_samplerate, quality, phase)) {
+		plan->table       = polyphase::get_table(in_samplerate, out_samplerate, quality, phase);
+		plan->delay       = plan->table->delay;
+		plan->exact_delay = plan->table->exact_delay;
+		if (use_batch()) {
+			plan->batch = polyphase::get_batch(plan->table);
+			plan->round = plan->table->down;
+		}
+	} else {
+		int error   = 0;
+		plan->state = std::shared_ptr<void>(reinterpret_cast<void*>(src_new(quality_to_converter(quality), static_cast<int>(channels), &error)), [](void* v) { src_delete(reinterpret_cast<SRC_STATE*>(v)); });
+		if (error != 0) {
 			throw_log_static("%s", src_strerror(error));
 		}
 
-		if (data.output_frames_gen > 0) {
-			D_LOG_STATIC_LOUD("%" PRId32 " %" PRId32 " %" PRId32 " %" PRId32, data.input_frames, data.output_frames, data.input_frames_used, data.output_frames_gen);
-			src_delete(instance);
-			return (delay * data.input_frames) + (data.output_frames - data.output_frames_gen);
+		// The delay does not depend on the channel count, so reuse it from a sibling plan if there is one.
+		auto sibling = plans.lower_bound(std::make_tuple(in_samplerate, out_samplerate, static_cast<int32_t>(quality), static_cast<int32_t>(phase), size_t(0)));
+		if ((sibling != plans.end()) && (std::get<0>(sibling->first) == in_samplerate) && (std::get<1>(sibling->first) == out_samplerate) && (std::get<2>(sibling->first) == static_cast<int32_t>(quality)) && (std::get<3>(sibling->first) == static_cast<int32_t>(phase))) {
+			plan->exact_delay = sibling->second->exact_delay;
+		} else {
+			plan->exact_delay = measure_delay(reinterpret_cast<SRC_STATE*>(plan->state.get()), channels, in_samplerate, out_samplerate);
 		}
+		plan->delay = static_cast<size_t>(std::max<long long>(std::llround(plan->exact_delay), 0));
 	}
 
-	src_delete(instance);
-	return in_samplerate;
+	D_LOG_STATIC("Planned %" PRIu32 " Hz -> %" PRIu32 " Hz at '%s' with %s phase for %zu channels with a delay of %zu samples.", in_samplerate, out_samplerate, quality_name(quality), (phase == resampler_phase::MINIMUM) ? "minimum" : "linear", channels, plan->delay);
+	plans.emplace(key, plan);
+	return plan;
+}
+
+size_t voicefx::resampler::calculate_delay(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, resampler_phase phase)
+{
+	D_LOG_STATIC_LOUD("");
+	return get_plan(in_samplerate, out_samplerate, quality, 1, phase)->delay;
+}
+
+const char* voicefx::resampler::quality_name(resampler_quality quality)
+{
+	switch (quality) {
+	case resampler_quality::AUTOMATIC:
+		return "Automatic";
+	case resampler_quality::LINEAR:
+		return "Linear";
+	case resampler_quality::FASTEST:
+		return "Fastest";
+	case resampler_quality::MEDIUM:
+		return "Medium";
+	case resampler_quality::BEST:
+		return "Best";
+	}
+	return "Unknown";
+}
+
+double voicefx::resampler::estimate_cost(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality)
+{
+	constexpr double throughput = 1e9; // Multiply-accumulates per second on one core.
+
+	auto   plan = get_plan(in_samplerate, out_samplerate, quality, 1);
+	double macs = 0.;
+	if (plan->cascade) {
+		// Every stage computes one filter output per sample at its lower rate, the center tap is left out.
+		auto const& design = *plan->cascade;
+		double      rate   = design.decimate ? static_cast<double>(in_samplerate) : static_cast<double>(design.mid_samplerate);
+		for (auto const& stage : design.stages) {
+			if (design.decimate) {
+				rate /= 2.;
+				macs += static_cast<double>(stage->taps) * rate;
+			} else {
+				macs += static_cast<double>(stage->taps) * rate;
+				rate *= 2.;
+			}
+		}
+		if (design.fraction) {
+			double fraction_out = design.decimate ? static_cast<double>(out_samplerate) : static_cast<double>(design.mid_samplerate);
+			macs += static_cast<double>(design.fraction->taps) * fraction_out;
+		}
+	} else if (plan->table) {
+		macs = static_cast<double>(plan->table->taps) * static_cast<double>(out_samplerate);
+	} else {
+		// Taps per output sample of the sinc converters, from the length and oversampling of their coefficient tables.
+		// Decimation stretches the filter by the conversion ratio.
+		double taps = 2.;
+		switch (quality) {
+		case resampler_quality::FASTEST:
+			taps = 2. * 2462. / 128.;
+			break;
+		case resampler_quality::MEDIUM:
+			taps = 2. * 22436. / 491.;
+			break;
+		case resampler_quality::BEST:
+			taps = 2. * 340237. / 2381.;
+			break;
+		default:
+			break;
+		}
+		double stretch = std::max(1., static_cast<double>(in_samplerate) / static_cast<double>(out_samplerate));
+		macs           = 4. * taps * stretch * static_cast<double>(out_samplerate);
+	}
+
+	return macs / throughput;
+}
+
+double voicefx::resampler::measure_cost(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality)
+{
+	static std::mutex                                                lock;
+	static std::map<std::tuple<uint32_t, uint32_t, int32_t>, double> costs;
+
+	auto key = std::make_tuple(in_samplerate, out_samplerate, static_cast<int32_t>(quality));
+	{
+		std::lock_guard<std::mutex> lg(lock);
+		if (auto kv = costs.find(key); kv != costs.end()) {
+			return kv->second;
+		}
+	}
+
+	// Convert a tone in typical host-sized blocks, 200ms worth of audio per pass.
+	constexpr size_t block  = 480;
+	constexpr size_t passes = 3;
+	size_t           blocks = std::max<size_t>(1, in_samplerate / 5 / block);
+	float            in_buffer[block];
+	float            out_buffer[block * 16];
+	const float*     ins[]  = {in_buffer};
+	float*           outs[] = {out_buffer};
+	for (size_t idx = 0; idx < block; idx++) {
+		in_buffer[idx] = static_cast<float>(std::sin(static_cast<double>(idx) * 0.1) * 0.5);
+	}
+
+	// Time the same code path that is used for processing.
+	resampler instance;
+	instance.channels(1);
+	instance.quality(quality);
+	instance.ratio(in_samplerate, out_samplerate);
+	instance.reserve(block, sizeof(out_buffer) / sizeof(*out_buffer));
+	instance.load();
+
+	// Keep the fastest pass, everything slower is scheduling noise.
+	double best = std::numeric_limits<double>::max();
+	for (size_t pass = 0; pass <= passes; pass++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < blocks; idx++) {
+			size_t used = 0;
+			size_t gen  = 0;
+			instance.process(ins, block, used, outs, sizeof(out_buffer) / sizeof(*out_buffer), gen);
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start);
+
+		// The first pass only warms up caches and the converter history.
+		if (pass > 0) {
+			best = std::min(best, elapsed.count() / (static_cast<double>(blocks * block) / static_cast<double>(in_samplerate)));
+		}
+	}
+
+	D_LOG_STATIC("%" PRIu32 " Hz -> %" PRIu32 " Hz at '%s' costs %.3f%% of a core per channel.", in_samplerate, out_samplerate, quality_name(quality), best * 100.);
+
+	std::lock_guard<std::mutex> lg(lock);
+	costs[key] = best;
+	return best;
+}
+
+voicefx::resampler_quality voicefx::resampler::automatic_quality(uint32_t in_samplerate, uint32_t out_samplerate, size_t channels, double budget)
+{
+	for (auto quality : {resampler_quality::BEST, resampler_quality::MEDIUM, resampler_quality::FASTEST}) {
+		try {
+			if ((estimate_cost(in_samplerate, out_samplerate, quality) * static_cast<double>(channels)) <= budget) {
+				return quality;
+			}
+		} catch (std::exception const& ex) {
+			// Converters can be compiled out of secret-rabbit-code, skip those.
+			D_LOG_STATIC("Skipping '%s': %s", quality_name(quality), ex.what());
+		}
+	}
+	return resampler_quality::LINEAR;
 }
@@ -29,12 +29,106 @@
 #include "warning-enable.hpp"
 
 namespace voicefx {
+	/** Resampler quality tiers, ordered from cheapest to most expensive.
+	 *
+	 * The numeric values are stored in the plug-in state and must remain stable.
+	 */
+	enum class resampler_quality : int32_t {
+		AUTOMATIC = -1, // Highest tier that fits into the CPU budget.
+		LINEAR    = 0,
+		FASTEST   = 1,
+		MEDIUM    = 2,
+		BEST      = 3,
+	};
+
+	/** Filter phase response.
+	 *
+	 * Minimum phase trades a frequency dependent group delay for a much lower latency, which matters for live
+	 * monitoring. Only available on the polyphase engine, anything else uses linear phase.
+	 */
+	enum class resampler_phase : int32_t {
+		LINEAR  = 0,
+		MINIMUM = 1,
+	};
+
+	namespace polyphase {
+		class batch;
+		class engine;
+		class stream;
+		struct table;
+	} // namespace polyphase
+
+	namespace halfband {
+		class cascade;
+		struct design;
+	} // namespace halfband
+
+	/** Everything about a conversion that does not change between instances.
+	 *
+	 * Plans are created once per process for each combination of rates, quality and channel count, and shared by all
+	 * resamplers using that combination afterwards.
+	 */
+	struct resampler_plan {
+		uint32_t          in_samplerate;
+		uint32_t          out_samplerate;
+		resampler_quality quality;
+		resampler_phase   phase; // Phase actually in use, which may be linear even if minimum was requested.
+		size_t            channels;
+		size_t            delay;       // Latency in output samples: group delay plus output held back by the converter.
+		double            exact_delay; // Same, including the fraction that delay rounds away.
+
+		// Exactly one of these is set, depending on which engine handles the conversion.
+		std::shared_ptr<const halfband::design> cascade;
+		std::shared_ptr<const polyphase::table> table;
+		std::shared_ptr<void>                   state; // Freshly reset secret-rabbit-code state, only ever cloned.
+
+		// Set along with the table if the streams of all instances are converted together, see polyphase::batch.
+		std::shared_ptr<polyphase::batch> batch;
+		size_t                            round; // Input samples per batched round, 0 if not batched.
+
+		/** Largest number of output samples that can be generated from in_samples input samples.
+		 */
+		size_t max_output(size_t in_samples) const;
+
+		/** Largest number of input samples that are consumed to generate out_samples output samples.
+		 */
+		size_t max_input(size_t out_samples) const;
+	};
+
 	class resampler {
-		std::vector<std::shared_ptr<void>> _instance;
+		std::shared_ptr<const resampler_plan> _plan;
+
+		// Common rate pairs use a dedicated fixed-ratio engine, anything else is left to secret-rabbit-code. High sample
+		// rates are first brought down (or up) in steps of two by a cascade of halfband stages.
+		std::shared_ptr<halfband::cascade> _halfband;
+		std::shared_ptr<polyphase::engine> _polyphase;
+		std::shared_ptr<polyphase::stream> _stream;
+
+		// A single state converts all channels, so that the multichannel kernels can share the filter position.
+		std::shared_ptr<void> _instance;
+
+		// Planar data is interleaved into these on the way in and out of the state.
+		std::vector<float>        _in_interleaved;
+		std::vector<float>        _out_interleaved;
+		std::vector<const float*> _in_planar;
+		std::vector<float*>       _out_planar;
+		size_t                    _in_capacity;
+		size_t                    _out_capacity;
+
+		// Conversion ratio as an exact fraction of output over input samples.
+		uint32_t _ratio_up;
+		uint32_t _ratio_down;
 
-		size_t _channels;
-		float  _ratio;
-		bool   _dirty;
+		// Samples consumed and produced since the last clear(), which pin down the exact output position.
+		uint64_t _consumed;
+		uint64_t _produced;
+
+		size_t            _channels;
+		uint32_t          _in_samplerate;
+		uint32_t          _out_samplerate;
+		resampler_quality _quality;
+		resampler_phase   _phase;
+		bool              _dirty;
 
 		public:
 		~resampler();
@@ -53,12 +147,27 @@ namespace voicefx {
 		resampler& operator=(resampler&&) noexcept;
 
 		public:
-		float ratio();
-		void  ratio(uint32_t in_samplerate, uint32_t out_samplerate);
+		/** Output samples per input sample.
+		 */
+		double ratio();
+		void   ratio(uint32_t in_samplerate, uint32_t out_samplerate);
 
 		size_t channels();
 		void   channels(size_t channels);
 
+		resampler_quality quality();
+		void              quality(resampler_quality quality);
+
+		resampler_phase phase();
+		void            phase(resampler_phase phase);
+
+		/** Size the interleaving buffers.
+		 *
+		 * process() converts in chunks of at most this many samples per channel, so larger values mean fewer calls
+		 * into the converter. Should match the largest amount of data passed to process().
+		 */
+		void reserve(size_t in_samples, size_t out_samples);
+
 		/** Load the resampler.
 		 *
 		 * This will try to initialize the resampler with the given configuration.
@@ -82,7 +191,53 @@ namespace voicefx {
 		 */
 		void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated);
 
+		uint64_t consumed();
+		uint64_t produced();
+
+		/** Distance between the produced output and the exact output position of the consumed input.
+		 *
+		 * Negative values are samples still held back by the converter. This settles once the converter is primed and
+		 * only changes by what is held back per call afterwards, a value that keeps growing means the conversion drifts.
+		 */
+		int64_t drift();
+
 		public:
-		static size_t calculate_delay(uint32_t in_samplerate, uint32_t out_samplerate);
+		/** Retrieve the shared plan for a conversion.
+		 *
+		 * The first call for each combination measures the latency and prepares a template state, later calls only look
+		 * it up. Thread-safe.
+		 */
+		static std::shared_ptr<const resampler_plan> get_plan(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality, size_t channels, resampler_phase phase = resampler_phase::LINEAR);
+
+		static size_t calculate_delay(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality = resampler_quality::BEST, resampler_phase phase = resampler_phase::LINEAR);
+
+		static const char* quality_name(resampler_quality quality);
+
+		/** Estimate the cost of a quality tier from the filters it runs.
+		 *
+		 * Counts the multiply-accumulates per second of audio that the planned engine needs, and assumes that a core
+		 * manages 10^9 of them per second. secret-rabbit-code counts four times, as it interpolates every coefficient
+		 * and has no vectorized kernels. Depends on nothing but the plan, so every machine and every run agrees.
+		 *
+		 * @return Fraction of real-time spent converting a single channel, i.e. 0.01 is 1% of one core.
+		 */
+		static double estimate_cost(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality);
+
+		/** Measure the cost of a quality tier by timing it on the calling thread.
+		 *
+		 * Results vary with the machine and its load, which is why automatic selection doesn't use it. Meant for the
+		 * resampler lab, to check estimate_cost() against. Results are cached per conversion and tier.
+		 *
+		 * @return Fraction of real-time spent converting a single channel, i.e. 0.01 is 1% of one core.
+		 */
+		static double measure_cost(uint32_t in_samplerate, uint32_t out_samplerate, resampler_quality quality);
+
+		/** Select the highest quality tier that fits into a CPU budget.
+		 *
+		 * The choice only depends on its arguments, see estimate_cost().
+		 *
+		 * @param budget Fraction of real-time that may be spent on all channels, see estimate_cost().
+		 */
+		static resampler_quality automatic_quality(uint32_t in_samplerate, uint32_t out_samplerate, size_t channels, double budget);
 	};
 } // namespace voicefx
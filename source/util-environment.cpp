@@ -0,0 +1,104 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "util-environment.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <vector>
+#include "warning-enable.hpp"
+
+#ifdef WIN32
+#include "warning-disable.hpp"
+#include <Windows.h>
+#include "warning-enable.hpp"
+#endif
+
+std::optional<std::string> voicefx::environment::get(std::string_view name)
+{
+	std::string key{name};
+#ifdef WIN32
+	DWORD res = GetEnvironmentVariableA(key.c_str(), nullptr, 0);
+	if (res == 0) {
+		return std::nullopt;
+	}
+
+	std::vector<char> buffer(static_cast<size_t>(res) + 1, 0);
+	GetEnvironmentVariableA(key.c_str(), buffer.data(), static_cast<DWORD>(buffer.size()));
+	return std::string(buffer.data());
+#else
+	if (const char* value = std::getenv(key.c_str()); value != nullptr) {
+		return std::string(value);
+	}
+	return std::nullopt;
+#endif
+}
+
+bool voicefx::environment::get_bool(std::string_view name, bool default_value)
+{
+	auto value = get(name);
+	if (!value.has_value()) {
+		return default_value;
+	}
+
+	std::string lower = value.value();
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if ((lower == "1") || (lower == "true") || (lower == "yes") || (lower == "on")) {
+		return true;
+	} else if ((lower == "0") || (lower == "false") || (lower == "no") || (lower == "off")) {
+		return false;
+	}
+	return default_value;
+}
+
+int64_t voicefx::environment::get_integer(std::string_view name, int64_t default_value)
+{
+	auto value = get(name);
+	if (!value.has_value()) {
+		return default_value;
+	}
+
+	char*     end    = nullptr;
+	long long result = std::strtoll(value->c_str(), &end, 0);
+	if ((end == value->c_str()) || (*end != '\0')) {
+		return default_value;
+	}
+	return static_cast<int64_t>(result);
+}
+
+double voicefx::environment::get_float(std::string_view name, double default_value)
+{
+	auto value = get(name);
+	if (!value.has_value()) {
+		return default_value;
+	}
+
+	char*  end    = nullptr;
+	double result = std::strtod(value->c_str(), &end);
+	if ((end == value->c_str()) || (*end != '\0')) {
+		return default_value;
+	}
+	return result;
+}
@@ -0,0 +1,171 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "util-fft.hpp"
+#include "lib.hpp"
+#include "util-simd.hpp"
+
+#include "warning-disable.hpp"
+#include <cmath>
+#include "warning-enable.hpp"
+
+static constexpr double pi = 3.14159265358979323846;
+
+voicefx::fft::real::~real() {}
+
+voicefx::fft::real::real(size_t size) : _size(size), _reverse(), _w_re(), _w_im(), _split_re(), _split_im(), _re(), _im()
+{
+	if ((size < 4) || ((size & (size - 1)) != 0)) {
+		throw_log("Transform size %zu is not a power of two of at least 4.", size);
+	}
+
+	size_t half = size / 2;
+	_re.resize(half);
+	_im.resize(half);
+
+	size_t bits = 0;
+	while ((size_t{1} << bits) < half) {
+		bits++;
+	}
+	_reverse.resize(half);
+	for (size_t idx = 0; idx < half; idx++) {
+		uint32_t rev = 0;
+		for (size_t bit = 0; bit < bits; bit++) {
+			rev |= static_cast<uint32_t>((idx >> bit) & 1) << (bits - 1 - bit);
+		}
+		_reverse[idx] = rev;
+	}
+
+	// Stage with blocks of length 2^k uses 2^(k-1) twiddles, which adds up to half - 1 over all stages.
+	_w_re.reserve(half);
+	_w_im.reserve(half);
+	for (size_t length = 2; length <= half; length <<= 1) {
+		for (size_t idx = 0; idx < length / 2; idx++) {
+			double angle = -2. * pi * static_cast<double>(idx) / static_cast<double>(length);
+			_w_re.push_back(static_cast<float>(std::cos(angle)));
+			_w_im.push_back(static_cast<float>(std::sin(angle)));
+		}
+	}
+
+	_split_re.resize(half + 1);
+	_split_im.resize(half + 1);
+	for (size_t idx = 0; idx <= half; idx++) {
+		double angle   = -2. * pi * static_cast<double>(idx) / static_cast<double>(size);
+		_split_re[idx] = static_cast<float>(std::cos(angle));
+		_split_im[idx] = static_cast<float>(std::sin(angle));
+	}
+}
+
+size_t voicefx::fft::real::size() const
+{
+	return _size;
+}
+
+void voicefx::fft::real::forward(const float* input, float* re, float* im)
+{
+	// Even samples go into the real part, odd ones into the imaginary part.
+	const size_t half = _size / 2;
+	for (size_t idx = 0; idx < half; idx++) {
+		_re[_reverse[idx]] = input[idx * 2];
+		_im[_reverse[idx]] = input[idx * 2 + 1];
+	}
+	transform(_re.data(), _im.data());
+
+	// Separate the spectra of the even and odd samples, and combine them into the spectrum of the whole signal.
+	re[0]    = _re[0] + _im[0];
+	im[0]    = 0.f;
+	re[half] = _re[0] - _im[0];
+	im[half] = 0.f;
+	for (size_t idx = 1; idx < half; idx++) {
+		float z_re = _re[idx], z_im = _im[idx];
+		float c_re = _re[half - idx], c_im = -_im[half - idx];
+		float e_re = (z_re + c_re) * 0.5f, e_im = (z_im + c_im) * 0.5f;
+		float o_re = (z_im - c_im) * 0.5f, o_im = (c_re - z_re) * 0.5f;
+		re[idx]    = e_re + o_re * _split_re[idx] - o_im * _split_im[idx];
+		im[idx]    = e_im + o_re * _split_im[idx] + o_im * _split_re[idx];
+	}
+}
+
+void voicefx::fft::real::inverse(const float* re, const float* im, float* output)
+{
+	// Undo the separation, then run the forward transform on the swapped parts, which is the inverse transform.
+	const size_t half = _size / 2;
+	for (size_t idx = 0; idx < half; idx++) {
+		float x_re = re[idx], x_im = im[idx];
+		float c_re = re[half - idx], c_im = -im[half - idx];
+		float e_re = (x_re + c_re) * 0.5f, e_im = (x_im + c_im) * 0.5f;
+		float d_re = (x_re - c_re) * 0.5f, d_im = (x_im - c_im) * 0.5f;
+		float o_re = d_re * _split_re[idx] + d_im * _split_im[idx];
+		float o_im = d_im * _split_re[idx] - d_re * _split_im[idx];
+
+		size_t rev = _reverse[idx];
+		_im[rev]   = e_re - o_im;
+		_re[rev]   = e_im + o_re;
+	}
+	transform(_re.data(), _im.data());
+
+	const float scale = 1.f / static_cast<float>(half);
+	for (size_t idx = 0; idx < half; idx++) {
+		output[idx * 2]     = _im[idx] * scale;
+		output[idx * 2 + 1] = _re[idx] * scale;
+	}
+}
+
+void voicefx::fft::real::transform(float* re, float* im)
+{
+	// Input must already be in bit reversed order.
+	const size_t half = _size / 2;
+
+	// The first two stages only have twiddles of 1 and -i, and are too short to vectorize.
+	for (size_t idx = 0; idx < half; idx += 2) {
+		float r = re[idx + 1], i = im[idx + 1];
+		re[idx + 1] = re[idx] - r;
+		im[idx + 1] = im[idx] - i;
+		re[idx] += r;
+		im[idx] += i;
+	}
+	for (size_t idx = 0; (idx + 4) <= half; idx += 4) {
+		float r = re[idx + 2], i = im[idx + 2];
+		re[idx + 2] = re[idx] - r;
+		im[idx + 2] = im[idx] - i;
+		re[idx] += r;
+		im[idx] += i;
+
+		r           = im[idx + 3];
+		i           = -re[idx + 3];
+		re[idx + 3] = re[idx + 1] - r;
+		im[idx + 3] = im[idx + 1] - i;
+		re[idx + 1] += r;
+		im[idx + 1] += i;
+	}
+
+	size_t offset = 3;
+	for (size_t length = 8; length <= half; length <<= 1) {
+		size_t step = length / 2;
+		for (size_t start = 0; start < half; start += length) {
+			::voicefx::simd::butterfly(re + start, im + start, re + start + step, im + start + step, _w_re.data() + offset, _w_im.data() + offset, step);
+		}
+		offset += step;
+	}
+}
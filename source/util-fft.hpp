@@ -0,0 +1,72 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+#include "warning-enable.hpp"
+
+namespace voicefx::fft {
+	/** Transform of real signals of a fixed power of two size.
+	 *
+	 * Spectra are stored as separate real and imaginary parts with size / 2 + 1 bins each. The transform runs as a complex
+	 * transform of half the size, whose butterflies are vectorized across each stage.
+	 */
+	class real {
+		size_t _size;
+
+		std::vector<uint32_t> _reverse; // Bit reversed index for the half size transform.
+		std::vector<float>    _w_re;    // Twiddles of every stage, one after another.
+		std::vector<float>    _w_im;
+		std::vector<float>    _split_re; // Twiddles that separate the even and odd halves of the signal.
+		std::vector<float>    _split_im;
+
+		std::vector<float> _re;
+		std::vector<float> _im;
+
+		public:
+		~real();
+
+		/** Create a new transform.
+		 *
+		 * @param size Number of real samples, must be a power of two of at least 4.
+		 */
+		real(size_t size);
+
+		size_t size() const;
+
+		/** Spectrum of size samples of input.
+		 */
+		void forward(const float* input, float* re, float* im);
+
+		/** Signal of a spectrum, scaled so that inverse(forward(x)) == x.
+		 */
+		void inverse(const float* re, const float* im, float* output);
+
+		private:
+		void transform(float* re, float* im);
+	};
+} // namespace voicefx::fft
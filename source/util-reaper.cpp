@@ -0,0 +1,142 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "util-reaper.hpp"
+#include "util-environment.hpp"
+
+#include "warning-disable.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <public.sdk/source/main/moduleinit.h>
+#include "warning-enable.hpp"
+
+namespace {
+	struct reaper_t {
+		std::mutex                        lock;
+		std::condition_variable           cv;
+		std::condition_variable           idle_cv;
+		std::deque<std::function<void()>> queue;
+		std::thread                       thread;
+		bool                              busy = false;
+		bool                              quit = false;
+
+		~reaper_t()
+		{
+			stop();
+		}
+
+		void main()
+		{
+			std::unique_lock<std::mutex> ul(lock);
+			while (true) {
+				cv.wait(ul, [this]() { return quit || !queue.empty(); });
+				if (queue.empty()) {
+					break;
+				}
+
+				// Run outside of the lock, so that more work can be handed over meanwhile.
+				auto task = std::move(queue.front());
+				queue.pop_front();
+				busy = true;
+				ul.unlock();
+				task();
+				task = nullptr;
+				ul.lock();
+				busy = false;
+
+				if (queue.empty()) {
+					idle_cv.notify_all();
+				}
+			}
+		}
+
+		void stop()
+		{
+			{
+				std::unique_lock<std::mutex> ul(lock);
+				quit = true;
+				cv.notify_all();
+			}
+
+			// Whatever is still queued is handled before the thread exits.
+			if (thread.joinable()) {
+				thread.join();
+			}
+		}
+	};
+
+	reaper_t& singleton()
+	{
+		static reaper_t instance;
+		return instance;
+	}
+} // namespace
+
+// Queued objects may still need the NVIDIA Audio Effects library, which is released at the default order.
+static auto reaper_terminator = Steinberg::ModuleTerminator([]() { singleton().stop(); }, 10);
+
+static void enqueue(std::function<void()>&& task)
+{
+	auto&                        state = singleton();
+	std::unique_lock<std::mutex> ul(state.lock);
+	if (state.quit) {
+		// Too late for the thread, so handle it here after letting go of the lock.
+		ul.unlock();
+		task();
+		return;
+	}
+
+	if (!state.thread.joinable()) {
+		state.thread = std::thread([&state]() { state.main(); });
+	}
+	state.queue.push_back(std::move(task));
+	state.cv.notify_all();
+}
+
+void voicefx::reaper::dispose(std::shared_ptr<void> object)
+{
+	static bool enabled = ::voicefx::environment::get_bool("VOICEFX_REAPER", true);
+	if (!object || !enabled) {
+		return;
+	}
+
+	enqueue([object = std::move(object)]() mutable { object.reset(); });
+}
+
+void voicefx::reaper::defer(std::function<void()> task)
+{
+	if (!task) {
+		return;
+	}
+
+	enqueue(std::move(task));
+}
+
+void voicefx::reaper::drain()
+{
+	auto&                        state = singleton();
+	std::unique_lock<std::mutex> ul(state.lock);
+	state.idle_cv.wait(ul, [&state]() { return state.queue.empty() && !state.busy; });
+}
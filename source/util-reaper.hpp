@@ -0,0 +1,50 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "warning-disable.hpp"
+#include <functional>
+#include <memory>
+#include "warning-enable.hpp"
+
+namespace voicefx::reaper {
+	/** Destroy an object on the reaper thread instead of the calling one.
+	 *
+	 * Freeing effects and resamplers can take long enough to stall whatever host thread deletes the plug-in, so the
+	 * last reference is dropped on a background thread instead. Objects are destroyed in the order they were handed
+	 * over. Set VOICEFX_REAPER to 0 to destroy them right away instead.
+	 */
+	void dispose(std::shared_ptr<void> object);
+
+	/** Run a task on the reaper thread.
+	 *
+	 * Meant for work that can block for a while, like asking a system service for something, which should neither
+	 * hold up the thread that needs it nor anyone joining that thread. Tasks and disposed objects are handled in the
+	 * order they were handed over, and the module waits for them before it unloads.
+	 */
+	void defer(std::function<void()> task);
+
+	/** Wait until everything handed over so far has been destroyed.
+	 */
+	void drain();
+} // namespace voicefx::reaper
@@ -0,0 +1,907 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "util-simd.hpp"
+#include "lib.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include "warning-enable.hpp"
+
+#ifdef VOICEFX_SIMD_X86
+#include "warning-disable.hpp"
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "warning-enable.hpp"
+#endif
+
+static voicefx::simd::instruction_set detect_instruction_set()
+{
+#ifdef VOICEFX_SIMD_X86
+#if defined(_MSC_VER)
+	int info[4] = {0};
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2    = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx     = (info[2] & (1 << 28)) != 0;
+	bool fma     = (info[2] & (1 << 12)) != 0;
+
+	bool avx2 = false;
+	if (max_leaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	// The OS must also save the upper halves of the YMM registers.
+	bool ymm = osxsave && ((_xgetbv(0) & 0x6) == 0x6);
+
+	if (avx && avx2 && fma && ymm) {
+		return voicefx::simd::instruction_set::AVX2;
+	} else if (sse2) {
+		return voicefx::simd::instruction_set::SSE2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return voicefx::simd::instruction_set::AVX2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		return voicefx::simd::instruction_set::SSE2;
+	}
+#endif
+#endif
+	return voicefx::simd::instruction_set::NONE;
+}
+
+// Upper limit set by select(), which the detected instruction set is clamped to.
+static std::atomic<voicefx::simd::instruction_set> _limit{voicefx::simd::instruction_set::AVX2};
+
+voicefx::simd::instruction_set voicefx::simd::detect()
+{
+	static instruction_set set = []() {
+		instruction_set v = detect_instruction_set();
+		D_LOG_STATIC("Using %s kernels.", name(v));
+		return v;
+	}();
+	return std::min(set, _limit.load(std::memory_order_relaxed));
+}
+
+voicefx::simd::instruction_set voicefx::simd::select(instruction_set set)
+{
+	_limit.store(set, std::memory_order_relaxed);
+	return detect();
+}
+
+const char* voicefx::simd::name(instruction_set set)
+{
+	switch (set) {
+	case instruction_set::SSE2:
+		return "SSE2";
+	case instruction_set::AVX2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
+//------------------------------------------------------------------------------
+// Scalar
+//------------------------------------------------------------------------------
+
+static void convert_scalar(const double* input, float* output, size_t samples)
+{
+	for (size_t idx = 0; idx < samples; idx++) {
+		output[idx] = static_cast<float>(input[idx]);
+	}
+}
+
+static void convert_scalar(const float* input, double* output, size_t samples)
+{
+	for (size_t idx = 0; idx < samples; idx++) {
+		output[idx] = static_cast<double>(input[idx]);
+	}
+}
+
+template<typename T>
+static void mix_scalar(const float* a, const float* b, T* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	for (size_t idx = 0; idx < samples; idx++) {
+		float ag    = a_gain + static_cast<float>(idx) * a_step;
+		float bg    = b_gain + static_cast<float>(idx) * b_step;
+		output[idx] = static_cast<T>(a[idx] * ag + b[idx] * bg);
+	}
+}
+
+static float dot_scalar(const float* a, const float* b, size_t samples)
+{
+	float v = 0.f;
+	for (size_t idx = 0; idx < samples; idx++) {
+		v += a[idx] * b[idx];
+	}
+	return v;
+}
+
+static void dot_scalar(const float* a, const float* b, size_t stride, float* output, size_t offset, size_t lanes, size_t samples)
+{
+	for (size_t lane = offset; lane < lanes; lane++) {
+		float v = 0.f;
+		for (size_t idx = 0; idx < samples; idx++) {
+			v += a[idx] * b[idx * stride + lane];
+		}
+		output[lane] = v;
+	}
+}
+
+static void multiply_scalar(const float* a, const float* b, float* output, size_t samples)
+{
+	for (size_t idx = 0; idx < samples; idx++) {
+		output[idx] = a[idx] * b[idx];
+	}
+}
+
+static void butterfly_scalar(float* re0, float* im0, float* re1, float* im1, const float* w_re, const float* w_im, size_t samples)
+{
+	for (size_t idx = 0; idx < samples; idx++) {
+		float t_re = re1[idx] * w_re[idx] - im1[idx] * w_im[idx];
+		float t_im = re1[idx] * w_im[idx] + im1[idx] * w_re[idx];
+		re1[idx]   = re0[idx] - t_re;
+		im1[idx]   = im0[idx] - t_im;
+		re0[idx] += t_re;
+		im0[idx] += t_im;
+	}
+}
+
+static void interleave_scalar(const float* const* input, size_t offset, float* output, size_t channels, size_t samples)
+{
+	for (size_t idx = offset; idx < samples; idx++) {
+		for (size_t ch = 0; ch < channels; ch++) {
+			output[idx * channels + ch] = input[ch][idx];
+		}
+	}
+}
+
+static void deinterleave_scalar(const float* input, float* const* output, size_t offset, size_t channels, size_t samples)
+{
+	for (size_t idx = offset; idx < samples; idx++) {
+		for (size_t ch = 0; ch < channels; ch++) {
+			output[ch][idx] = input[idx * channels + ch];
+		}
+	}
+}
+
+#ifdef VOICEFX_SIMD_X86
+//------------------------------------------------------------------------------
+// SSE2
+//------------------------------------------------------------------------------
+
+VOICEFX_SIMD_TARGET("sse2")
+static void convert_sse2(const double* input, float* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(input + idx));
+		__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(input + idx + 2));
+		_mm_storeu_ps(output + idx, _mm_movelh_ps(lo, hi));
+	}
+	convert_scalar(input + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static void convert_sse2(const float* input, double* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		__m128 v = _mm_loadu_ps(input + idx);
+		_mm_storeu_pd(output + idx, _mm_cvtps_pd(v));
+		_mm_storeu_pd(output + idx + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+	}
+	convert_scalar(input + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static void mix_sse2(const float* a, const float* b, float* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	__m128 ag  = _mm_add_ps(_mm_set1_ps(a_gain), _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(a_step)));
+	__m128 bg  = _mm_add_ps(_mm_set1_ps(b_gain), _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(b_step)));
+	__m128 ags = _mm_set1_ps(a_step * 4.f);
+	__m128 bgs = _mm_set1_ps(b_step * 4.f);
+
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + idx), ag), _mm_mul_ps(_mm_loadu_ps(b + idx), bg));
+		_mm_storeu_ps(output + idx, v);
+		ag = _mm_add_ps(ag, ags);
+		bg = _mm_add_ps(bg, bgs);
+	}
+	mix_scalar(a + idx, b + idx, output + idx, samples - idx, a_gain + idx * a_step, a_step, b_gain + idx * b_step, b_step);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static void mix_sse2(const float* a, const float* b, double* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	__m128 ag  = _mm_add_ps(_mm_set1_ps(a_gain), _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(a_step)));
+	__m128 bg  = _mm_add_ps(_mm_set1_ps(b_gain), _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(b_step)));
+	__m128 ags = _mm_set1_ps(a_step * 4.f);
+	__m128 bgs = _mm_set1_ps(b_step * 4.f);
+
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + idx), ag), _mm_mul_ps(_mm_loadu_ps(b + idx), bg));
+		_mm_storeu_pd(output + idx, _mm_cvtps_pd(v));
+		_mm_storeu_pd(output + idx + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+		ag = _mm_add_ps(ag, ags);
+		bg = _mm_add_ps(bg, bgs);
+	}
+	mix_scalar(a + idx, b + idx, output + idx, samples - idx, a_gain + idx * a_step, a_step, b_gain + idx * b_step, b_step);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static float dot_sse2(const float* a, const float* b, size_t samples)
+{
+	// Two accumulators hide the latency of the additions.
+	__m128 v0  = _mm_setzero_ps();
+	__m128 v1  = _mm_setzero_ps();
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		v0 = _mm_add_ps(v0, _mm_mul_ps(_mm_loadu_ps(a + idx), _mm_loadu_ps(b + idx)));
+		v1 = _mm_add_ps(v1, _mm_mul_ps(_mm_loadu_ps(a + idx + 4), _mm_loadu_ps(b + idx + 4)));
+	}
+	v0 = _mm_add_ps(v0, v1);
+	v0 = _mm_add_ps(v0, _mm_movehl_ps(v0, v0));
+	v0 = _mm_add_ss(v0, _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(v0) + dot_scalar(a + idx, b + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static size_t dot_sse2(const float* a, const float* const* b, float* output, size_t count, size_t samples)
+{
+	size_t group = 0;
+	for (; (group + 4) <= count; group += 4) {
+		const float* b0 = b[group];
+		const float* b1 = b[group + 1];
+		const float* b2 = b[group + 2];
+		const float* b3 = b[group + 3];
+
+		__m128 v0  = _mm_setzero_ps();
+		__m128 v1  = _mm_setzero_ps();
+		__m128 v2  = _mm_setzero_ps();
+		__m128 v3  = _mm_setzero_ps();
+		size_t idx = 0;
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 c = _mm_loadu_ps(a + idx);
+			v0       = _mm_add_ps(v0, _mm_mul_ps(c, _mm_loadu_ps(b0 + idx)));
+			v1       = _mm_add_ps(v1, _mm_mul_ps(c, _mm_loadu_ps(b1 + idx)));
+			v2       = _mm_add_ps(v2, _mm_mul_ps(c, _mm_loadu_ps(b2 + idx)));
+			v3       = _mm_add_ps(v3, _mm_mul_ps(c, _mm_loadu_ps(b3 + idx)));
+		}
+
+		// Reduce all four at once, which leaves one result per lane.
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+		_mm_storeu_ps(output + group, _mm_add_ps(_mm_add_ps(v0, v1), _mm_add_ps(v2, v3)));
+		for (size_t lane = 0; lane < 4; lane++) {
+			output[group + lane] += dot_scalar(a + idx, b[group + lane] + idx, samples - idx);
+		}
+	}
+	if ((group + 2) <= count) {
+		const float* b0 = b[group];
+		const float* b1 = b[group + 1];
+
+		__m128 v0  = _mm_setzero_ps();
+		__m128 v1  = _mm_setzero_ps();
+		size_t idx = 0;
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 c = _mm_loadu_ps(a + idx);
+			v0       = _mm_add_ps(v0, _mm_mul_ps(c, _mm_loadu_ps(b0 + idx)));
+			v1       = _mm_add_ps(v1, _mm_mul_ps(c, _mm_loadu_ps(b1 + idx)));
+		}
+
+		__m128 v = _mm_add_ps(_mm_unpacklo_ps(v0, v1), _mm_unpackhi_ps(v0, v1));
+		v        = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		_mm_storel_pi(reinterpret_cast<__m64*>(output + group), v);
+		for (size_t lane = 0; lane < 2; lane++) {
+			output[group + lane] += dot_scalar(a + idx, b[group + lane] + idx, samples - idx);
+		}
+		group += 2;
+	}
+	return group;
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static size_t dot_sse2(const float* a, const float* b, size_t stride, float* output, size_t lanes, size_t samples)
+{
+	// Every coefficient is broadcast once and applied to sixteen lanes, or four for what is left.
+	size_t lane = 0;
+	for (; (lane + 16) <= lanes; lane += 16) {
+		__m128 v0 = _mm_setzero_ps();
+		__m128 v1 = _mm_setzero_ps();
+		__m128 v2 = _mm_setzero_ps();
+		__m128 v3 = _mm_setzero_ps();
+		for (size_t idx = 0; idx < samples; idx++) {
+			__m128       c   = _mm_set1_ps(a[idx]);
+			const float* ptr = b + idx * stride + lane;
+			v0               = _mm_add_ps(v0, _mm_mul_ps(c, _mm_loadu_ps(ptr)));
+			v1               = _mm_add_ps(v1, _mm_mul_ps(c, _mm_loadu_ps(ptr + 4)));
+			v2               = _mm_add_ps(v2, _mm_mul_ps(c, _mm_loadu_ps(ptr + 8)));
+			v3               = _mm_add_ps(v3, _mm_mul_ps(c, _mm_loadu_ps(ptr + 12)));
+		}
+		_mm_storeu_ps(output + lane, v0);
+		_mm_storeu_ps(output + lane + 4, v1);
+		_mm_storeu_ps(output + lane + 8, v2);
+		_mm_storeu_ps(output + lane + 12, v3);
+	}
+	for (; (lane + 4) <= lanes; lane += 4) {
+		__m128 v = _mm_setzero_ps();
+		for (size_t idx = 0; idx < samples; idx++) {
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(a[idx]), _mm_loadu_ps(b + idx * stride + lane)));
+		}
+		_mm_storeu_ps(output + lane, v);
+	}
+	return lane;
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static void multiply_sse2(const float* a, const float* b, float* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		_mm_storeu_ps(output + idx, _mm_mul_ps(_mm_loadu_ps(a + idx), _mm_loadu_ps(b + idx)));
+	}
+	multiply_scalar(a + idx, b + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static void butterfly_sse2(float* re0, float* im0, float* re1, float* im1, const float* w_re, const float* w_im, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 4) <= samples; idx += 4) {
+		__m128 wr   = _mm_loadu_ps(w_re + idx);
+		__m128 wi   = _mm_loadu_ps(w_im + idx);
+		__m128 r1   = _mm_loadu_ps(re1 + idx);
+		__m128 i1   = _mm_loadu_ps(im1 + idx);
+		__m128 r0   = _mm_loadu_ps(re0 + idx);
+		__m128 i0   = _mm_loadu_ps(im0 + idx);
+		__m128 t_re = _mm_sub_ps(_mm_mul_ps(r1, wr), _mm_mul_ps(i1, wi));
+		__m128 t_im = _mm_add_ps(_mm_mul_ps(r1, wi), _mm_mul_ps(i1, wr));
+		_mm_storeu_ps(re1 + idx, _mm_sub_ps(r0, t_re));
+		_mm_storeu_ps(im1 + idx, _mm_sub_ps(i0, t_im));
+		_mm_storeu_ps(re0 + idx, _mm_add_ps(r0, t_re));
+		_mm_storeu_ps(im0 + idx, _mm_add_ps(i0, t_im));
+	}
+	butterfly_scalar(re0 + idx, im0 + idx, re1 + idx, im1 + idx, w_re + idx, w_im + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static size_t interleave_sse2(const float* const* input, float* output, size_t channels, size_t samples)
+{
+	size_t idx = 0;
+	if (channels == 2) {
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 l = _mm_loadu_ps(input[0] + idx);
+			__m128 r = _mm_loadu_ps(input[1] + idx);
+			_mm_storeu_ps(output + idx * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(output + idx * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+	} else if (channels == 4) {
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 a = _mm_loadu_ps(input[0] + idx);
+			__m128 b = _mm_loadu_ps(input[1] + idx);
+			__m128 c = _mm_loadu_ps(input[2] + idx);
+			__m128 d = _mm_loadu_ps(input[3] + idx);
+			_MM_TRANSPOSE4_PS(a, b, c, d);
+			_mm_storeu_ps(output + idx * 4, a);
+			_mm_storeu_ps(output + idx * 4 + 4, b);
+			_mm_storeu_ps(output + idx * 4 + 8, c);
+			_mm_storeu_ps(output + idx * 4 + 12, d);
+		}
+	}
+	return idx;
+}
+
+VOICEFX_SIMD_TARGET("sse2")
+static size_t deinterleave_sse2(const float* input, float* const* output, size_t channels, size_t samples)
+{
+	size_t idx = 0;
+	if (channels == 2) {
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 a = _mm_loadu_ps(input + idx * 2);
+			__m128 b = _mm_loadu_ps(input + idx * 2 + 4);
+			_mm_storeu_ps(output[0] + idx, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(output[1] + idx, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	} else if (channels == 4) {
+		for (; (idx + 4) <= samples; idx += 4) {
+			__m128 a = _mm_loadu_ps(input + idx * 4);
+			__m128 b = _mm_loadu_ps(input + idx * 4 + 4);
+			__m128 c = _mm_loadu_ps(input + idx * 4 + 8);
+			__m128 d = _mm_loadu_ps(input + idx * 4 + 12);
+			_MM_TRANSPOSE4_PS(a, b, c, d);
+			_mm_storeu_ps(output[0] + idx, a);
+			_mm_storeu_ps(output[1] + idx, b);
+			_mm_storeu_ps(output[2] + idx, c);
+			_mm_storeu_ps(output[3] + idx, d);
+		}
+	}
+	return idx;
+}
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+VOICEFX_SIMD_TARGET("avx2")
+static void convert_avx2(const double* input, float* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(input + idx));
+		__m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(input + idx + 4));
+		_mm256_storeu_ps(output + idx, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+	}
+	convert_sse2(input + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("avx2")
+static void convert_avx2(const float* input, double* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		_mm256_storeu_pd(output + idx, _mm256_cvtps_pd(_mm_loadu_ps(input + idx)));
+		_mm256_storeu_pd(output + idx + 4, _mm256_cvtps_pd(_mm_loadu_ps(input + idx + 4)));
+	}
+	convert_sse2(input + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static void mix_avx2(const float* a, const float* b, float* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	__m256 ramp = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+	__m256 ag   = _mm256_fmadd_ps(ramp, _mm256_set1_ps(a_step), _mm256_set1_ps(a_gain));
+	__m256 bg   = _mm256_fmadd_ps(ramp, _mm256_set1_ps(b_step), _mm256_set1_ps(b_gain));
+	__m256 ags  = _mm256_set1_ps(a_step * 8.f);
+	__m256 bgs  = _mm256_set1_ps(b_step * 8.f);
+
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m256 v = _mm256_fmadd_ps(_mm256_loadu_ps(a + idx), ag, _mm256_mul_ps(_mm256_loadu_ps(b + idx), bg));
+		_mm256_storeu_ps(output + idx, v);
+		ag = _mm256_add_ps(ag, ags);
+		bg = _mm256_add_ps(bg, bgs);
+	}
+	mix_sse2(a + idx, b + idx, output + idx, samples - idx, a_gain + idx * a_step, a_step, b_gain + idx * b_step, b_step);
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static void mix_avx2(const float* a, const float* b, double* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	__m256 ramp = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+	__m256 ag   = _mm256_fmadd_ps(ramp, _mm256_set1_ps(a_step), _mm256_set1_ps(a_gain));
+	__m256 bg   = _mm256_fmadd_ps(ramp, _mm256_set1_ps(b_step), _mm256_set1_ps(b_gain));
+	__m256 ags  = _mm256_set1_ps(a_step * 8.f);
+	__m256 bgs  = _mm256_set1_ps(b_step * 8.f);
+
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m256 v = _mm256_fmadd_ps(_mm256_loadu_ps(a + idx), ag, _mm256_mul_ps(_mm256_loadu_ps(b + idx), bg));
+		_mm256_storeu_pd(output + idx, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+		_mm256_storeu_pd(output + idx + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+		ag = _mm256_add_ps(ag, ags);
+		bg = _mm256_add_ps(bg, bgs);
+	}
+	mix_sse2(a + idx, b + idx, output + idx, samples - idx, a_gain + idx * a_step, a_step, b_gain + idx * b_step, b_step);
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static float dot_avx2(const float* a, const float* b, size_t samples)
+{
+	__m256 v0  = _mm256_setzero_ps();
+	__m256 v1  = _mm256_setzero_ps();
+	size_t idx = 0;
+	for (; (idx + 16) <= samples; idx += 16) {
+		v0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + idx), _mm256_loadu_ps(b + idx), v0);
+		v1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + idx + 8), _mm256_loadu_ps(b + idx + 8), v1);
+	}
+	if ((idx + 8) <= samples) {
+		v0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + idx), _mm256_loadu_ps(b + idx), v0);
+		idx += 8;
+	}
+	v0       = _mm256_add_ps(v0, v1);
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(v0), _mm256_extractf128_ps(v0, 1));
+	v        = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v        = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(v) + dot_scalar(a + idx, b + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static size_t dot_avx2(const float* a, const float* const* b, float* output, size_t count, size_t samples)
+{
+	size_t group = 0;
+	for (; (group + 4) <= count; group += 4) {
+		const float* b0 = b[group];
+		const float* b1 = b[group + 1];
+		const float* b2 = b[group + 2];
+		const float* b3 = b[group + 3];
+
+		__m256 v0  = _mm256_setzero_ps();
+		__m256 v1  = _mm256_setzero_ps();
+		__m256 v2  = _mm256_setzero_ps();
+		__m256 v3  = _mm256_setzero_ps();
+		size_t idx = 0;
+		for (; (idx + 8) <= samples; idx += 8) {
+			__m256 c = _mm256_loadu_ps(a + idx);
+			v0       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b0 + idx), v0);
+			v1       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b1 + idx), v1);
+			v2       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b2 + idx), v2);
+			v3       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b3 + idx), v3);
+		}
+
+		// Pairwise sums leave {v0, v1, v2, v3} in each 128-bit half, which then only need to be added.
+		__m256 v = _mm256_hadd_ps(_mm256_hadd_ps(v0, v1), _mm256_hadd_ps(v2, v3));
+		_mm_storeu_ps(output + group, _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+		for (size_t lane = 0; lane < 4; lane++) {
+			output[group + lane] += dot_scalar(a + idx, b[group + lane] + idx, samples - idx);
+		}
+	}
+	if ((group + 2) <= count) {
+		const float* b0 = b[group];
+		const float* b1 = b[group + 1];
+
+		__m256 v0  = _mm256_setzero_ps();
+		__m256 v1  = _mm256_setzero_ps();
+		size_t idx = 0;
+		for (; (idx + 8) <= samples; idx += 8) {
+			__m256 c = _mm256_loadu_ps(a + idx);
+			v0       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b0 + idx), v0);
+			v1       = _mm256_fmadd_ps(c, _mm256_loadu_ps(b1 + idx), v1);
+		}
+
+		__m256 h = _mm256_hadd_ps(v0, v1);
+		__m128 v = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+		v        = _mm_hadd_ps(v, v);
+		_mm_storel_pi(reinterpret_cast<__m64*>(output + group), v);
+		for (size_t lane = 0; lane < 2; lane++) {
+			output[group + lane] += dot_scalar(a + idx, b[group + lane] + idx, samples - idx);
+		}
+		group += 2;
+	}
+	return group;
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static size_t dot_avx2(const float* a, const float* b, size_t stride, float* output, size_t lanes, size_t samples)
+{
+	size_t lane = 0;
+	for (; (lane + 32) <= lanes; lane += 32) {
+		__m256 v0 = _mm256_setzero_ps();
+		__m256 v1 = _mm256_setzero_ps();
+		__m256 v2 = _mm256_setzero_ps();
+		__m256 v3 = _mm256_setzero_ps();
+		for (size_t idx = 0; idx < samples; idx++) {
+			__m256       c   = _mm256_set1_ps(a[idx]);
+			const float* ptr = b + idx * stride + lane;
+			v0               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr), v0);
+			v1               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr + 8), v1);
+			v2               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr + 16), v2);
+			v3               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr + 24), v3);
+		}
+		_mm256_storeu_ps(output + lane, v0);
+		_mm256_storeu_ps(output + lane + 8, v1);
+		_mm256_storeu_ps(output + lane + 16, v2);
+		_mm256_storeu_ps(output + lane + 24, v3);
+	}
+	if ((lane + 16) <= lanes) {
+		__m256 v0 = _mm256_setzero_ps();
+		__m256 v1 = _mm256_setzero_ps();
+		for (size_t idx = 0; idx < samples; idx++) {
+			__m256       c   = _mm256_set1_ps(a[idx]);
+			const float* ptr = b + idx * stride + lane;
+			v0               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr), v0);
+			v1               = _mm256_fmadd_ps(c, _mm256_loadu_ps(ptr + 8), v1);
+		}
+		_mm256_storeu_ps(output + lane, v0);
+		_mm256_storeu_ps(output + lane + 8, v1);
+		lane += 16;
+	}
+	for (; (lane + 8) <= lanes; lane += 8) {
+		// Alternate between two accumulators to hide the latency of the additions.
+		__m256 v0  = _mm256_setzero_ps();
+		__m256 v1  = _mm256_setzero_ps();
+		size_t idx = 0;
+		for (; (idx + 2) <= samples; idx += 2) {
+			v0 = _mm256_fmadd_ps(_mm256_set1_ps(a[idx]), _mm256_loadu_ps(b + idx * stride + lane), v0);
+			v1 = _mm256_fmadd_ps(_mm256_set1_ps(a[idx + 1]), _mm256_loadu_ps(b + (idx + 1) * stride + lane), v1);
+		}
+		if (idx < samples) {
+			v0 = _mm256_fmadd_ps(_mm256_set1_ps(a[idx]), _mm256_loadu_ps(b + idx * stride + lane), v0);
+		}
+		_mm256_storeu_ps(output + lane, _mm256_add_ps(v0, v1));
+	}
+	return lane;
+}
+
+VOICEFX_SIMD_TARGET("avx2")
+static void multiply_avx2(const float* a, const float* b, float* output, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		_mm256_storeu_ps(output + idx, _mm256_mul_ps(_mm256_loadu_ps(a + idx), _mm256_loadu_ps(b + idx)));
+	}
+	multiply_sse2(a + idx, b + idx, output + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("avx2,fma")
+static void butterfly_avx2(float* re0, float* im0, float* re1, float* im1, const float* w_re, const float* w_im, size_t samples)
+{
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m256 wr   = _mm256_loadu_ps(w_re + idx);
+		__m256 wi   = _mm256_loadu_ps(w_im + idx);
+		__m256 r1   = _mm256_loadu_ps(re1 + idx);
+		__m256 i1   = _mm256_loadu_ps(im1 + idx);
+		__m256 r0   = _mm256_loadu_ps(re0 + idx);
+		__m256 i0   = _mm256_loadu_ps(im0 + idx);
+		__m256 t_re = _mm256_fmsub_ps(r1, wr, _mm256_mul_ps(i1, wi));
+		__m256 t_im = _mm256_fmadd_ps(r1, wi, _mm256_mul_ps(i1, wr));
+		_mm256_storeu_ps(re1 + idx, _mm256_sub_ps(r0, t_re));
+		_mm256_storeu_ps(im1 + idx, _mm256_sub_ps(i0, t_im));
+		_mm256_storeu_ps(re0 + idx, _mm256_add_ps(r0, t_re));
+		_mm256_storeu_ps(im0 + idx, _mm256_add_ps(i0, t_im));
+	}
+	butterfly_sse2(re0 + idx, im0 + idx, re1 + idx, im1 + idx, w_re + idx, w_im + idx, samples - idx);
+}
+
+VOICEFX_SIMD_TARGET("avx2")
+static size_t interleave_avx2(const float* const* input, float* output, size_t channels, size_t samples)
+{
+	// Only stereo benefits from the wider registers, quad is a 4x4 transpose either way.
+	if (channels != 2) {
+		return interleave_sse2(input, output, channels, samples);
+	}
+
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m256 l  = _mm256_loadu_ps(input[0] + idx);
+		__m256 r  = _mm256_loadu_ps(input[1] + idx);
+		__m256 lo = _mm256_unpacklo_ps(l, r);
+		__m256 hi = _mm256_unpackhi_ps(l, r);
+		_mm256_storeu_ps(output + idx * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(output + idx * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	return idx;
+}
+
+VOICEFX_SIMD_TARGET("avx2")
+static size_t deinterleave_avx2(const float* input, float* const* output, size_t channels, size_t samples)
+{
+	if (channels != 2) {
+		return deinterleave_sse2(input, output, channels, samples);
+	}
+
+	size_t idx = 0;
+	for (; (idx + 8) <= samples; idx += 8) {
+		__m256 a  = _mm256_loadu_ps(input + idx * 2);
+		__m256 b  = _mm256_loadu_ps(input + idx * 2 + 8);
+		__m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+		__m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+		_mm256_storeu_ps(output[0] + idx, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm256_storeu_ps(output[1] + idx, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	return idx;
+}
+#endif
+
+void voicefx::simd::convert(const float* input, float* output, size_t samples)
+{
+	memcpy(output, input, samples * sizeof(float));
+}
+
+void voicefx::simd::convert(const double* input, float* output, size_t samples)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return convert_avx2(input, output, samples);
+	case instruction_set::SSE2:
+		return convert_sse2(input, output, samples);
+#endif
+	default:
+		return convert_scalar(input, output, samples);
+	}
+}
+
+void voicefx::simd::convert(const float* input, double* output, size_t samples)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return convert_avx2(input, output, samples);
+	case instruction_set::SSE2:
+		return convert_sse2(input, output, samples);
+#endif
+	default:
+		return convert_scalar(input, output, samples);
+	}
+}
+
+void voicefx::simd::mix(const float* a, const float* b, float* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return mix_avx2(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+	case instruction_set::SSE2:
+		return mix_sse2(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+#endif
+	default:
+		return mix_scalar(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+	}
+}
+
+void voicefx::simd::mix(const float* a, const float* b, double* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return mix_avx2(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+	case instruction_set::SSE2:
+		return mix_sse2(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+#endif
+	default:
+		return mix_scalar(a, b, output, samples, a_gain, a_step, b_gain, b_step);
+	}
+}
+
+float voicefx::simd::dot(const float* a, const float* b, size_t samples)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return dot_avx2(a, b, samples);
+	case instruction_set::SSE2:
+		return dot_sse2(a, b, samples);
+#endif
+	default:
+		return dot_scalar(a, b, samples);
+	}
+}
+
+void voicefx::simd::dot(const float* a, const float* const* b, float* output, size_t count, size_t samples)
+{
+	size_t idx = 0;
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		idx = dot_avx2(a, b, output, count, samples);
+		break;
+	case instruction_set::SSE2:
+		idx = dot_sse2(a, b, output, count, samples);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	// Whatever doesn't fill a group of two or four.
+	for (; idx < count; idx++) {
+		output[idx] = dot(a, b[idx], samples);
+	}
+}
+
+void voicefx::simd::dot(const float* a, const float* b, size_t stride, float* output, size_t lanes, size_t samples)
+{
+	size_t idx = 0;
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		idx = dot_avx2(a, b, stride, output, lanes, samples);
+		break;
+	case instruction_set::SSE2:
+		idx = dot_sse2(a, b, stride, output, lanes, samples);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	// Whatever doesn't fill a whole register.
+	dot_scalar(a, b, stride, output, idx, lanes, samples);
+}
+
+void voicefx::simd::multiply(const float* a, const float* b, float* output, size_t samples)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return multiply_avx2(a, b, output, samples);
+	case instruction_set::SSE2:
+		return multiply_sse2(a, b, output, samples);
+#endif
+	default:
+		return multiply_scalar(a, b, output, samples);
+	}
+}
+
+void voicefx::simd::butterfly(float* re0, float* im0, float* re1, float* im1, const float* w_re, const float* w_im, size_t samples)
+{
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		return butterfly_avx2(re0, im0, re1, im1, w_re, w_im, samples);
+	case instruction_set::SSE2:
+		return butterfly_sse2(re0, im0, re1, im1, w_re, w_im, samples);
+#endif
+	default:
+		return butterfly_scalar(re0, im0, re1, im1, w_re, w_im, samples);
+	}
+}
+
+void voicefx::simd::interleave(const float* const* input, float* output, size_t channels, size_t samples)
+{
+	if (channels == 1) {
+		memcpy(output, input[0], samples * sizeof(float));
+		return;
+	}
+
+	size_t idx = 0;
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		idx = interleave_avx2(input, output, channels, samples);
+		break;
+	case instruction_set::SSE2:
+		idx = interleave_sse2(input, output, channels, samples);
+		break;
+#endif
+	default:
+		break;
+	}
+	interleave_scalar(input, idx, output, channels, samples);
+}
+
+void voicefx::simd::deinterleave(const float* input, float* const* output, size_t channels, size_t samples)
+{
+	if (channels == 1) {
+		memcpy(output[0], input, samples * sizeof(float));
+		return;
+	}
+
+	size_t idx = 0;
+	switch (detect()) {
+#ifdef VOICEFX_SIMD_X86
+	case instruction_set::AVX2:
+		idx = deinterleave_avx2(input, output, channels, samples);
+		break;
+	case instruction_set::SSE2:
+		idx = deinterleave_sse2(input, output, channels, samples);
+		break;
+#endif
+	default:
+		break;
+	}
+	deinterleave_scalar(input, output, idx, channels, samples);
+}
@@ -0,0 +1,120 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "warning-disable.hpp"
+#include <cinttypes>
+#include <cstddef>
+#include "warning-enable.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VOICEFX_SIMD_X86
+#endif
+
+// Allow individual functions to use instruction sets that the rest of the code is not compiled for.
+#if defined(VOICEFX_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VOICEFX_SIMD_TARGET(X) __attribute__((target(X)))
+#else
+#define VOICEFX_SIMD_TARGET(X)
+#endif
+
+namespace voicefx::simd {
+	enum class instruction_set : uint8_t {
+		NONE,
+		SSE2,
+		AVX2,
+	};
+
+	/** Detect the best instruction set supported by the current CPU.
+	 *
+	 * The result is cached after the first call.
+	 */
+	instruction_set detect();
+
+	/** Limit the kernels to an instruction set, so that they can be compared against each other.
+	 *
+	 * Sets the CPU does not support are clamped to what it does support.
+	 *
+	 * @return The instruction set now in use.
+	 */
+	instruction_set select(instruction_set set);
+
+	const char* name(instruction_set set);
+
+	/** Copy samples, converting between sample formats where necessary.
+	 *
+	 * Kernels are picked at runtime from the detected instruction set.
+	 */
+	void convert(const float* input, float* output, size_t samples);
+	void convert(const double* input, float* output, size_t samples);
+	void convert(const float* input, double* output, size_t samples);
+
+	/** Mix two signals with linearly ramped gains.
+	 *
+	 * output[n] = a[n] * (a_gain + n * a_step) + b[n] * (b_gain + n * b_step)
+	 */
+	void mix(const float* a, const float* b, float* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step);
+	void mix(const float* a, const float* b, double* output, size_t samples, float a_gain, float a_step, float b_gain, float b_step);
+
+	/** Inner product of two signals, as used by FIR filters.
+	 */
+	float dot(const float* a, const float* b, size_t samples);
+
+	/** Inner products of one set of coefficients with several signals.
+	 *
+	 * output[n] = dot(a, b[n], samples)
+	 *
+	 * Signals are processed in groups of four, or two, that share every load of the coefficients, which is how
+	 * multichannel filters at the same phase avoid reading the same coefficients once per channel.
+	 */
+	void dot(const float* a, const float* const* b, float* output, size_t count, size_t samples);
+
+	/** Inner products of one set of coefficients with several interleaved signals.
+	 *
+	 * output[n] = a[0] * b[n] + a[1] * b[stride + n] + ... for every n below lanes
+	 *
+	 * Each signal occupies one lane of the registers, so unlike the functions above this needs no horizontal sums.
+	 */
+	void dot(const float* a, const float* b, size_t stride, float* output, size_t lanes, size_t samples);
+
+	/** Multiply two signals.
+	 *
+	 * output[n] = a[n] * b[n]
+	 */
+	void multiply(const float* a, const float* b, float* output, size_t samples);
+
+	/** Radix-2 butterflies of a complex FFT on split real and imaginary parts.
+	 *
+	 * t = (re1[n] + i * im1[n]) * (w_re[n] + i * w_im[n])
+	 * re1[n] + i * im1[n] = re0[n] + i * im0[n] - t
+	 * re0[n] + i * im0[n] = re0[n] + i * im0[n] + t
+	 */
+	void butterfly(float* re0, float* im0, float* re1, float* im1, const float* w_re, const float* w_im, size_t samples);
+
+	/** Convert between planar and interleaved layouts.
+	 *
+	 * Mono, stereo and quad have dedicated kernels, other layouts use a generic loop.
+	 */
+	void interleave(const float* const* input, float* output, size_t channels, size_t samples);
+	void deinterleave(const float* input, float* const* output, size_t channels, size_t samples);
+} // namespace voicefx::simd
@@ -0,0 +1,327 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "util-thread.hpp"
+#include <platform.hpp>
+#include "lib.hpp"
+#include "util-environment.hpp"
+#include "util-reaper.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <thread>
+#include "warning-enable.hpp"
+
+#ifdef WIN32
+#include "warning-disable.hpp"
+#include <Windows.h>
+#include "warning-enable.hpp"
+#else
+#include "warning-disable.hpp"
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "warning-enable.hpp"
+#endif
+
+#ifdef __linux__
+// RealtimeKit hands out real-time scheduling to unprivileged processes over D-Bus. libdbus is loaded at runtime so that
+// it stays an optional dependency.
+static bool rtkit_make_realtime(pid_t thread, int32_t priority)
+{
+	struct dbus_error_t {
+		const char*  name;
+		const char*  message;
+		unsigned int dummy;
+		void*        padding;
+	};
+	typedef void* (*dbus_bus_get_private_t)(int, dbus_error_t*);
+	typedef void (*dbus_error_init_t)(dbus_error_t*);
+	typedef void (*dbus_error_free_t)(dbus_error_t*);
+	typedef uint32_t (*dbus_error_is_set_t)(const dbus_error_t*);
+	typedef void* (*dbus_message_new_method_call_t)(const char*, const char*, const char*, const char*);
+	typedef uint32_t (*dbus_message_append_args_t)(void*, int, ...);
+	typedef void* (*dbus_connection_send_with_reply_and_block_t)(void*, void*, int, dbus_error_t*);
+	typedef void (*dbus_message_unref_t)(void*);
+	typedef void (*dbus_connection_close_t)(void*);
+	typedef void (*dbus_connection_unref_t)(void*);
+
+	constexpr int DBUS_BUS_SYSTEM   = 1;
+	constexpr int DBUS_TYPE_INVALID = 0;
+	constexpr int DBUS_TYPE_UINT32  = 'u';
+	constexpr int DBUS_TYPE_UINT64  = 't';
+
+	std::shared_ptr<::tonplugins::platform::library> dbus;
+	try {
+		dbus = ::tonplugins::platform::library::load(std::string_view("libdbus-1.so.3"));
+	} catch (...) {
+		return false;
+	}
+
+#define P_DBUS_LOAD_SYMBOL(NAME)                                                   \
+	auto NAME = reinterpret_cast<NAME##_t>(dbus->load_symbol(#NAME));              \
+	if (!NAME) {                                                                   \
+		return false;                                                              \
+	}
+	P_DBUS_LOAD_SYMBOL(dbus_bus_get_private);
+	P_DBUS_LOAD_SYMBOL(dbus_error_init);
+	P_DBUS_LOAD_SYMBOL(dbus_error_free);
+	P_DBUS_LOAD_SYMBOL(dbus_error_is_set);
+	P_DBUS_LOAD_SYMBOL(dbus_message_new_method_call);
+	P_DBUS_LOAD_SYMBOL(dbus_message_append_args);
+	P_DBUS_LOAD_SYMBOL(dbus_connection_send_with_reply_and_block);
+	P_DBUS_LOAD_SYMBOL(dbus_message_unref);
+	P_DBUS_LOAD_SYMBOL(dbus_connection_close);
+	P_DBUS_LOAD_SYMBOL(dbus_connection_unref);
+#undef P_DBUS_LOAD_SYMBOL
+
+	// RealtimeKit refuses threads that could monopolize a CPU, so it requires a hard limit on real-time CPU time. Hard
+	// limits can't be raised again without privileges, and this one applies to the whole host process, so only ask if
+	// the host already set one. Lowering the soft limit is fine, the host can still raise it back up.
+	constexpr rlim_t rttime = 200000;
+	if (struct rlimit limit; getrlimit(RLIMIT_RTTIME, &limit) == 0) {
+		if ((limit.rlim_max == RLIM_INFINITY) || (limit.rlim_max > rttime)) {
+			D_LOG_STATIC("Not asking RealtimeKit, as it requires a hard RLIMIT_RTTIME of at most %" PRIu64 "us.", static_cast<uint64_t>(rttime));
+			return false;
+		}
+		if ((limit.rlim_cur == RLIM_INFINITY) || (limit.rlim_cur > limit.rlim_max)) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_RTTIME, &limit);
+		}
+	} else {
+		return false;
+	}
+
+	dbus_error_t error;
+	dbus_error_init(&error);
+
+	bool  result     = false;
+	void* connection = dbus_bus_get_private(DBUS_BUS_SYSTEM, &error);
+	if (connection) {
+		void* message = dbus_message_new_method_call("org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1", "org.freedesktop.RealtimeKit1", "MakeThreadRealtime");
+		if (message) {
+			uint64_t tid  = static_cast<uint64_t>(thread);
+			uint32_t prio = static_cast<uint32_t>(priority);
+			if (dbus_message_append_args(message, DBUS_TYPE_UINT64, &tid, DBUS_TYPE_UINT32, &prio, DBUS_TYPE_INVALID)) {
+				if (void* reply = dbus_connection_send_with_reply_and_block(connection, message, 1000, &error); reply) {
+					result = !dbus_error_is_set(&error);
+					dbus_message_unref(reply);
+				}
+			}
+			dbus_message_unref(message);
+		}
+		dbus_connection_close(connection);
+		dbus_connection_unref(connection);
+	}
+
+	if (dbus_error_is_set(&error)) {
+		D_LOG_STATIC("RealtimeKit refused: %s", error.message ? error.message : "Unknown error");
+		dbus_error_free(&error);
+	}
+	return result;
+}
+#endif
+
+voicefx::thread::policy voicefx::thread::policy::from_environment()
+{
+	policy p;
+
+	if (auto v = ::voicefx::environment::get("VOICEFX_THREAD_SCHEDULER"); v.has_value()) {
+		if (v.value() == "normal") {
+			p.scheduler = scheduler::NORMAL;
+		} else if (v.value() == "rr") {
+			p.scheduler = scheduler::ROUND_ROBIN;
+		} else if (v.value() == "fifo") {
+			p.scheduler = scheduler::FIFO;
+		}
+	}
+	p.priority = static_cast<int32_t>(std::clamp<int64_t>(::voicefx::environment::get_integer("VOICEFX_THREAD_PRIORITY", p.priority), 1, 99));
+	p.affinity = static_cast<uint64_t>(::voicefx::environment::get_integer("VOICEFX_THREAD_AFFINITY", static_cast<int64_t>(p.affinity)));
+	p.isolate  = ::voicefx::environment::get_bool("VOICEFX_THREAD_ISOLATE", p.isolate);
+
+	return p;
+}
+
+const char* voicefx::thread::name(scheduler v)
+{
+	switch (v) {
+	case scheduler::FIFO:
+		return "FIFO";
+	case scheduler::ROUND_ROBIN:
+		return "Round-Robin";
+	default:
+		return "Normal";
+	}
+}
+
+std::string voicefx::thread::apply_scheduler(const policy& p)
+{
+	D_LOG_STATIC_LOUD("");
+	if (p.scheduler == scheduler::NORMAL) {
+		return "Normal";
+	}
+
+#ifdef WIN32
+	// Windows has no real-time scheduling for user threads, time critical is the closest we can get.
+	SetThreadPriorityBoost(GetCurrentThread(), FALSE);
+	if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != FALSE) {
+		return "Time Critical";
+	} else if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) != FALSE) {
+		return "Highest";
+	}
+	return "Normal";
+#else
+	int policy = (p.scheduler == scheduler::FIFO) ? SCHED_FIFO : SCHED_RR;
+
+	// 1. Ask the kernel directly, which works if we have CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO.
+	int32_t priority = std::clamp(p.priority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+	if (struct rlimit limit; (getrlimit(RLIMIT_RTPRIO, &limit) == 0) && (limit.rlim_cur != RLIM_INFINITY) && (limit.rlim_cur > 0)) {
+		priority = std::min<int32_t>(priority, static_cast<int32_t>(limit.rlim_cur));
+	}
+	sched_param param = {};
+	param.sched_priority = priority;
+#ifdef __linux__
+	// Don't hand real-time scheduling down to anything the host forks from this thread.
+	policy |= SCHED_RESET_ON_FORK;
+#endif
+	if (pthread_setschedparam(pthread_self(), policy, &param) == 0) {
+		return std::string(name(p.scheduler)) + " " + std::to_string(priority);
+	}
+
+#ifdef __linux__
+	// 2. Ask RealtimeKit, which usually grants priorities up to 20, and 3. at least try to be nicer than everyone else
+	// if that fails too. Both work on another thread of the same process, so the caller doesn't wait for D-Bus.
+	pid_t   tid    = static_cast<pid_t>(syscall(SYS_gettid));
+	int32_t rtprio = std::min<int32_t>(priority, 20);
+	::voicefx::reaper::defer([tid, rtprio]() {
+		// The thread may have already exited by now.
+		if (syscall(SYS_tgkill, getpid(), tid, 0) != 0) {
+			return;
+		}
+
+		if (rtkit_make_realtime(tid, rtprio)) {
+			D_LOG_STATIC("Thread %d now uses RealtimeKit %" PRId32 ".", static_cast<int>(tid), rtprio);
+			return;
+		}
+		for (int nice = -15; nice < 0; nice += 5) {
+			if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), nice) == 0) {
+				D_LOG_STATIC("Thread %d now uses Nice %d.", static_cast<int>(tid), nice);
+				return;
+			}
+		}
+		D_LOG_STATIC("Thread %d stays at Normal scheduling.", static_cast<int>(tid));
+	});
+	return "Normal, RealtimeKit pending";
+#else
+	return "Normal";
+#endif
+#endif
+}
+
+void voicefx::thread::apply_affinity(const policy& p, int32_t avoid_cpu)
+{
+	D_LOG_STATIC_LOUD("");
+	size_t   cpus = std::min<size_t>(std::max<unsigned int>(std::thread::hardware_concurrency(), 1), 64);
+	uint64_t mask = (cpus >= 64) ? ~uint64_t(0) : ((uint64_t(1) << cpus) - 1);
+	if (p.affinity != 0) {
+		mask &= p.affinity;
+	}
+
+	// Stay away from the host audio thread, unless that would leave us with nowhere to run.
+	if (p.isolate && (avoid_cpu >= 0) && (avoid_cpu < 64)) {
+		uint64_t isolated = mask & ~(uint64_t(1) << avoid_cpu);
+		if (isolated != 0) {
+			mask = isolated;
+		}
+	}
+	if (mask == 0) {
+		return;
+	}
+
+#ifdef WIN32
+	SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask));
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t idx = 0; idx < 64; idx++) {
+		if ((mask & (uint64_t(1) << idx)) != 0) {
+			CPU_SET(idx, &set);
+		}
+	}
+	if (int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); error != 0) {
+		D_LOG_STATIC("Failed to set affinity to 0x%016" PRIx64 " (error %d).", mask, error);
+		return;
+	}
+#else
+	// Other systems, like macOS, only take affinity hints that don't map onto a CPU mask.
+	D_LOG_STATIC("Affinity is not supported on this platform, ignoring 0x%016" PRIx64 ".", mask);
+	return;
+#endif
+	D_LOG_STATIC("Affinity is now 0x%016" PRIx64 ".", mask);
+}
+
+int32_t voicefx::thread::current_cpu()
+{
+#ifdef WIN32
+	return static_cast<int32_t>(GetCurrentProcessorNumber());
+#elif defined(__linux__)
+	return static_cast<int32_t>(sched_getcpu());
+#else
+	return -1;
+#endif
+}
+
+std::chrono::nanoseconds voicefx::thread::measure_wakeup_latency(size_t iterations)
+{
+	constexpr auto           interval = std::chrono::milliseconds(1);
+	std::chrono::nanoseconds total    = std::chrono::nanoseconds(0);
+	for (size_t idx = 0; idx < iterations; idx++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		std::this_thread::sleep_for(interval);
+		total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start - interval);
+	}
+	return total / std::max<size_t>(iterations, 1);
+}
+
+voicefx::thread::latency_monitor::latency_monitor(std::string name, size_t interval) : _name(name), _interval(interval), _count(0), _total(0), _minimum(std::chrono::nanoseconds::max()), _maximum(0) {}
+
+void voicefx::thread::latency_monitor::record(std::chrono::nanoseconds latency)
+{
+	_count++;
+	_total += latency;
+	_minimum = std::min(_minimum, latency);
+	_maximum = std::max(_maximum, latency);
+
+	if (_count >= _interval) {
+		D_LOG_STATIC("%s: Wake-up latency over %zu wake-ups is %" PRId64 "ns average, %" PRId64 "ns minimum, %" PRId64 "ns maximum.", _name.c_str(), _count, static_cast<int64_t>((_total / _count).count()), static_cast<int64_t>(_minimum.count()), static_cast<int64_t>(_maximum.count()));
+		_count   = 0;
+		_total   = std::chrono::nanoseconds(0);
+		_minimum = std::chrono::nanoseconds::max();
+		_maximum = std::chrono::nanoseconds(0);
+	}
+}
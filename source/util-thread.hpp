@@ -0,0 +1,97 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "warning-disable.hpp"
+#include <chrono>
+#include <cinttypes>
+#include <string>
+#include "warning-enable.hpp"
+
+namespace voicefx::thread {
+	enum class scheduler : uint8_t {
+		NORMAL,
+		ROUND_ROBIN,
+		FIFO,
+	};
+
+	/** How a worker thread should be scheduled.
+	 *
+	 * The default leaves the thread exactly as the system created it. Defaults can be overridden with the following
+	 * environment variables:
+	 * - VOICEFX_THREAD_SCHEDULER: 'fifo', 'rr' or 'normal'.
+	 * - VOICEFX_THREAD_PRIORITY: Real-time priority, 1 to 99 on Linux. Ignored on Windows.
+	 * - VOICEFX_THREAD_AFFINITY: Bitmask of allowed CPUs, 0 allows all of them.
+	 * - VOICEFX_THREAD_ISOLATE: Keep the thread off the CPU that the host audio thread runs on.
+	 */
+	struct policy {
+		::voicefx::thread::scheduler scheduler = ::voicefx::thread::scheduler::NORMAL;
+		int32_t                      priority  = 10;
+		uint64_t                     affinity  = 0;
+		bool                         isolate   = false;
+
+		static policy from_environment();
+	};
+
+	const char* name(scheduler v);
+
+	/** Apply the scheduling part of a policy to the calling thread.
+	 *
+	 * A normal scheduler changes nothing. If a real-time scheduler is refused, Linux falls back to RealtimeKit and from
+	 * there to a raised nice value. Asking RealtimeKit can block for up to a second, so that happens on the reaper
+	 * thread and its outcome is only logged.
+	 *
+	 * @return A description of what was achieved so far.
+	 */
+	std::string apply_scheduler(const policy& p);
+
+	/** Apply the affinity part of a policy to the calling thread.
+	 *
+	 * @param avoid_cpu CPU to keep the thread off if the policy requests isolation, or -1.
+	 */
+	void apply_affinity(const policy& p, int32_t avoid_cpu);
+
+	/** The CPU the calling thread currently runs on, or -1 if unknown.
+	 */
+	int32_t current_cpu();
+
+	/** Measure how late the calling thread wakes up from short sleeps.
+	 */
+	std::chrono::nanoseconds measure_wakeup_latency(size_t iterations = 20);
+
+	/** Collects wake-up latencies and logs a summary every so often.
+	 */
+	class latency_monitor {
+		std::string              _name;
+		size_t                   _interval;
+		size_t                   _count;
+		std::chrono::nanoseconds _total;
+		std::chrono::nanoseconds _minimum;
+		std::chrono::nanoseconds _maximum;
+
+		public:
+		latency_monitor(std::string name, size_t interval = 1000);
+
+		void record(std::chrono::nanoseconds latency);
+	};
+} // namespace voicefx::thread
@@ -32,5 +32,10 @@
 {
 	voicefx::initialize();
 
-	return Steinberg::Vst::Vst2Wrapper::create(GetPluginFactory(), vst3::effect::processor_uid, FOURCC('X', 'V', 'F', 'X'), audioMaster);
+	auto effect = Steinberg::Vst::Vst2Wrapper::create(GetPluginFactory(), vst3::effect::processor_uid, FOURCC('X', 'V', 'F', 'X'), audioMaster);
+	if (effect) {
+		// The processor accepts 64-bit samples, so let hosts call processDoubleReplacing() on the wrapper directly.
+		effect->canDoubleReplacing(true);
+	}
+	return effect;
 }
@@ -23,9 +23,67 @@
 
 #pragma once
 #include "lib.hpp"
+#include "resampler.hpp"
 
 #define FOURCC_CREATOR_PROCESSOR FOURCC('X', 'm', 'r', 'P')
 #define FOURCC_CREATOR_CONTROLLER FOURCC('X', 'm', 'r', 'C')
 
 #define PARAMETER_MODE FOURCC('M', 'o', 'd', 'e')
 #define PARAMETER_INTENSITY FOURCC('I', 'n', 't', 's')
+#define PARAMETER_MIX FOURCC('M', 'i', 'x', ' ')
+#define PARAMETER_GAIN FOURCC('G', 'a', 'i', 'n')
+#define PARAMETER_QUALITY FOURCC('Q', 'u', 'a', 'l')
+#define PARAMETER_PHASE FOURCC('P', 'h', 'a', 's')
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <cmath>
+#include "warning-enable.hpp"
+
+namespace vst3 {
+	// Message from the controller to the processor with new resampler settings, which have to be in place before the
+	// host restarts the processor for the new latency.
+	static constexpr const char* message_resampler = "Resampler";
+	static constexpr const char* attribute_quality = "Quality";
+	static constexpr const char* attribute_phase   = "Phase";
+
+	// Range of the output gain parameter in decibels.
+	static constexpr double gain_minimum = -24.;
+	static constexpr double gain_maximum = 24.;
+
+	inline float gain_from_normalized(double v)
+	{
+		double db = gain_minimum + std::clamp(v, 0., 1.) * (gain_maximum - gain_minimum);
+		return static_cast<float>(std::pow(10., db / 20.));
+	}
+
+	inline double gain_to_normalized(float v)
+	{
+		double db = 20. * std::log10(std::max<double>(v, 1e-9));
+		return std::clamp((db - gain_minimum) / (gain_maximum - gain_minimum), 0., 1.);
+	}
+
+	// The quality parameter lists every resampler tier, starting with automatic selection.
+	static constexpr int32_t quality_count = static_cast<int32_t>(::voicefx::resampler_quality::BEST) + 2;
+
+	inline ::voicefx::resampler_quality quality_from_normalized(double v)
+	{
+		auto index = static_cast<int32_t>(std::floor(std::min<double>(quality_count - 1, std::max(v, 0.) * quality_count)));
+		return static_cast<::voicefx::resampler_quality>(index - 1);
+	}
+
+	inline double quality_to_normalized(::voicefx::resampler_quality v)
+	{
+		return static_cast<double>(static_cast<int32_t>(v) + 1) / static_cast<double>(quality_count - 1);
+	}
+
+	inline ::voicefx::resampler_phase phase_from_normalized(double v)
+	{
+		return (v >= 0.5) ? ::voicefx::resampler_phase::MINIMUM : ::voicefx::resampler_phase::LINEAR;
+	}
+
+	inline double phase_to_normalized(::voicefx::resampler_phase v)
+	{
+		return (v == ::voicefx::resampler_phase::MINIMUM) ? 1. : 0.;
+	}
+} // namespace vst3
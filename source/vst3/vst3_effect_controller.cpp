@@ -28,7 +28,7 @@
 #include <vstgui/plugin-bindings/vst3editor.h>
 #include <warning-enable.hpp>
 
-vst3::effect::controller::controller()
+vst3::effect::controller::controller() : _enable_echo_removal(false), _enable_reverb_removal(false), _intensity(0.f), _mix(1.f), _gain(1.f), _quality(static_cast<int32>(::voicefx::resampler_quality::AUTOMATIC)), _phase(static_cast<int32>(::voicefx::resampler_phase::LINEAR))
 {
 	D_LOG_LOUD("");
 	D_LOG("(0x%08" PRIxPTR ") Initializing...", this);
@@ -47,6 +47,31 @@ vst3::effect::controller::controller()
 		parameters.addParameter(p);
 	}
 #endif
+	{
+		auto p = new Steinberg::Vst::RangeParameter(STR("Mix"), PARAMETER_MIX, STR("%"), 0.0, 100.0, 100.0, 0, Steinberg::Vst::ParameterInfo::ParameterFlags::kCanAutomate);
+		parameters.addParameter(p);
+	}
+	{
+		auto p = new Steinberg::Vst::RangeParameter(STR("Output Gain"), PARAMETER_GAIN, STR("dB"), ::vst3::gain_minimum, ::vst3::gain_maximum, 0.0, 0, Steinberg::Vst::ParameterInfo::ParameterFlags::kCanAutomate);
+		parameters.addParameter(p);
+	}
+	{
+		// Changing the quality changes the latency, so this can't be automated.
+		auto p = new Steinberg::Vst::StringListParameter(STR("Resampler Quality"), PARAMETER_QUALITY, nullptr, Steinberg::Vst::ParameterInfo::ParameterFlags::kIsList);
+		p->appendString(STR("Automatic"));
+		p->appendString(STR("Linear"));
+		p->appendString(STR("Fastest"));
+		p->appendString(STR("Medium"));
+		p->appendString(STR("Best"));
+		parameters.addParameter(p);
+	}
+	{
+		// Minimum phase cuts the resampling latency for live monitoring, at the cost of a non-linear phase response.
+		auto p = new Steinberg::Vst::StringListParameter(STR("Resampler Phase"), PARAMETER_PHASE, nullptr, Steinberg::Vst::ParameterInfo::ParameterFlags::kIsList);
+		p->appendString(STR("Linear"));
+		p->appendString(STR("Minimum (Low Latency)"));
+		parameters.addParameter(p);
+	}
 }
 
 vst3::effect::controller::~controller() {}
@@ -82,6 +107,19 @@ tresult PLUGIN_API vst3::effect::controller::setComponentState(IBStream* state)
 		return kResultFalse;
 	}
 #endif
+	// Mix and gain were added later, so older states don't have them.
+	if (streamer.readFloat(_mix)) {
+		setParamNormalized(PARAMETER_MIX, _mix);
+	}
+	if (streamer.readFloat(_gain)) {
+		setParamNormalized(PARAMETER_GAIN, ::vst3::gain_to_normalized(_gain));
+	}
+	if (streamer.readInt32(_quality)) {
+		setParamNormalized(PARAMETER_QUALITY, ::vst3::quality_to_normalized(static_cast<::voicefx::resampler_quality>(_quality)));
+	}
+	if (streamer.readInt32(_phase)) {
+		setParamNormalized(PARAMETER_PHASE, ::vst3::phase_to_normalized(static_cast<::voicefx::resampler_phase>(_phase)));
+	}
 
 	return kResultOk;
 }
@@ -92,6 +130,35 @@ tresult PLUGIN_API vst3::effect::controller::setChannelContextInfos(IAttributeLi
 	return kResultOk;
 }
 
+tresult PLUGIN_API vst3::effect::controller::setParamNormalized(ParamID tag, ParamValue value)
+{
+	D_LOG_LOUD("");
+	ParamValue previous = getParamNormalized(tag);
+	if (tresult result = EditControllerEx1::setParamNormalized(tag, value); result != kResultOk) {
+		return result;
+	}
+
+	// A new quality tier or phase changes the latency of the processor.
+	if (((tag == PARAMETER_QUALITY) || (tag == PARAMETER_PHASE)) && (previous != value)) {
+		// Hand the new value to the processor first. The same change also reaches it through process(), but only
+		// after the host may already have restarted it.
+		if (IPtr<IMessage> message = owned(allocateMessage()); message) {
+			message->setMessageID(::vst3::message_resampler);
+			if (tag == PARAMETER_QUALITY) {
+				message->getAttributes()->setInt(::vst3::attribute_quality, static_cast<int64>(::vst3::quality_from_normalized(value)));
+			} else {
+				message->getAttributes()->setInt(::vst3::attribute_phase, static_cast<int64>(::vst3::phase_from_normalized(value)));
+			}
+			sendMessage(message);
+		}
+
+		if (auto handler = getComponentHandler(); handler != nullptr) {
+			handler->restartComponent(kLatencyChanged);
+		}
+	}
+	return kResultOk;
+}
+
 FUnknown* vst3::effect::controller::create(void* data)
 {
 	D_LOG_STATIC_LOUD("");
@@ -47,6 +47,10 @@ namespace vst3::effect {
 		bool  _enable_echo_removal;
 		bool  _enable_reverb_removal;
 		float _intensity;
+		float _mix;
+		float _gain;
+		int32 _quality;
+		int32 _phase;
 
 		public:
 		controller();
@@ -62,6 +66,8 @@ namespace vst3::effect {
 		public /* IEditController */:
 		Steinberg::IPlugView* PLUGIN_API createView(Steinberg::FIDString name) override;
 
+		tresult PLUGIN_API setParamNormalized(ParamID tag, ParamValue value) override;
+
 		public:
 		OBJ_METHODS(controller, EditControllerEx1)
 		DEFINE_INTERFACES
@@ -22,11 +22,16 @@
 // OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "vst3_effect_processor.hpp"
+#include "util-environment.hpp"
+#include "util-reaper.hpp"
+#include "util-simd.hpp"
 #include "vst3_effect_controller.hpp"
 
 #include "warning-disable.hpp"
 #include <base/source/fstreamer.h>
+#include <cstring>
 #include <filesystem>
+#include <pluginterfaces/vst/ivstmessage.h>
 #include <pluginterfaces/vst/ivstparameterchanges.h>
 #include "warning-enable.hpp"
 
@@ -36,7 +41,7 @@
 #include "warning-enable.hpp"
 #endif
 
-vst3::effect::processor::processor() : _dirty(true), _channels(0), _samplerate(0), _resample(false), _delay(0), _local_delay(0), _in_lock(), _in_unresampled(), _in_resampler(), _in_resampled(), _fx(), _out_lock(), _out_unresampled(), _out_resampler(), _out_resampled(), _lock(), _worker(), _worker_cv(), _worker_quit(false), _worker_signal(false)
+vst3::effect::processor::processor() : _dirty(true), _channels(0), _samplerate(0), _resample(false), _delay(0), _local_delay(0), _in_delay(0), _out_delay(0), _host_samples(0), _wet_samples(0), _wet_offset(0), _wet_drift(0), _mix(1.f), _gain(1.f), _wet_gain(1.f), _dry_gain(0.f), _quality(::voicefx::resampler_quality::AUTOMATIC), _resampler_quality(::voicefx::resampler_quality::BEST), _phase(::voicefx::resampler_phase::LINEAR), _arena(), _dry(), _splitter(), _high(), _high_mix(), _in_lock(), _in_unresampled(), _in_resampler(), _in_resampled(), _fx(), _out_lock(), _out_unresampled(), _out_resampler(), _out_resampled(), _lock(), _worker(), _worker_cv(), _worker_quit(false), _worker_signal(false), _worker_policy(), _worker_signal_time(), _host_cpu(-1), _created(std::chrono::high_resolution_clock::now()), _first_audio(false)
 {
 	D_LOG_LOUD("");
 	try {
@@ -58,7 +63,8 @@ vst3::effect::processor::processor() : _dirty(true), _channels(0), _samplerate(0
 
 		{ // Allocate the necessary resources for starting off.
 			std::unique_lock<std::mutex> lock(_lock);
-			_fx = std::make_shared<::nvidia::afx::effect>();
+			_fx = ::voicefx::backend::create();
+			D_LOG("Backend '%s' ready after %.1f ms.", _fx->name(), std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _created).count());
 		}
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
@@ -77,6 +83,12 @@ vst3::effect::processor::~processor()
 		}
 		if (_worker.joinable())
 			_worker.join();
+
+		// Freeing the effect and resamplers can take a while, which the host should not have to wait for.
+		::voicefx::reaper::dispose(std::move(_fx));
+		::voicefx::reaper::dispose(std::move(_in_resampler));
+		::voicefx::reaper::dispose(std::move(_out_resampler));
+		::voicefx::reaper::dispose(std::move(_splitter));
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
 		throw;
@@ -110,7 +122,7 @@ tresult PLUGIN_API vst3::effect::processor::initialize(FUnknown* context)
 tresult PLUGIN_API vst3::effect::processor::canProcessSampleSize(int32 symbolicSampleSize)
 {
 	D_LOG_LOUD("");
-	return (symbolicSampleSize == kSample32) ? kResultTrue : kResultFalse;
+	return ((symbolicSampleSize == kSample32) || (symbolicSampleSize == kSample64)) ? kResultTrue : kResultFalse;
 }
 
 tresult PLUGIN_API vst3::effect::processor::setBusArrangements(SpeakerArrangement* inputs, int32 numIns, SpeakerArrangement* outputs, int32 numOuts)
@@ -176,8 +188,13 @@ tresult PLUGIN_API vst3::effect::processor::setupProcessing(ProcessSetup& newSet
 	try {
 		std::unique_lock<std::mutex> lock(_lock);
 		// Copy non-important stuff.
-		processSetup.maxSamplesPerBlock = newSetup.maxSamplesPerBlock;
-		processSetup.processMode        = newSetup.processMode;
+		processSetup.processMode = newSetup.processMode;
+
+		// Buffers are sized to fit the largest block, so they need to be rebuilt if it changes.
+		if (processSetup.maxSamplesPerBlock != newSetup.maxSamplesPerBlock) {
+			processSetup.maxSamplesPerBlock = newSetup.maxSamplesPerBlock;
+			_dirty                          = true;
+		}
 
 		// Check that this is the appropriate sample size.
 		if (canProcessSampleSize(newSetup.symbolicSampleSize) != kResultTrue)
@@ -191,7 +208,7 @@ tresult PLUGIN_API vst3::effect::processor::setupProcessing(ProcessSetup& newSet
 			_dirty                  = true;
 		}
 
-		calculate_delay();
+		update_resampler_settings();
 
 		// TODO: Are we able to modify the host here?
 		return kResultOk;
@@ -205,8 +222,14 @@ tresult PLUGIN_API vst3::effect::processor::setProcessing(TBool state)
 {
 	D_LOG_LOUD("");
 	try {
-		if ((state == TBool(true)) && _dirty) {
-			reset();
+		if (state == TBool(true)) {
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				update_resampler_settings();
+			}
+			if (_dirty) {
+				reset();
+			}
 		}
 
 		return kResultOk;
@@ -235,11 +258,6 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 			return kNotInitialized;
 		}
 
-		// If the host is ignoring our return codes, do nothing.
-		if (_dirty) {
-			return kNotInitialized;
-		}
-
 		// Exit-early if host application ignores our delay request.
 		if ((_local_delay == _delay) && (data.numSamples < _delay)) {
 			D_LOG(
@@ -249,15 +267,16 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 		}
 
 // If there were any parameter changes, handle them.
-#ifndef TONPLUGINS_DEMO
+		bool reconfigure = false;
 		if (data.inputParameterChanges) {
-			for (Steinberg::int32 idx = 0, edx = (data.inputParameterChanges->getParameterCount() > 0); idx < edx; ++idx) {
+			for (Steinberg::int32 idx = 0, edx = data.inputParameterChanges->getParameterCount(); idx < edx; ++idx) {
 				auto param = data.inputParameterChanges->getParameterData(idx);
 				if (param) {
 					Steinberg::Vst::ParamValue value;
 					Steinberg::int32           sample_offset;
 					if (Steinberg::int32 points = param->getPointCount(); points > 0) {
 						switch (param->getParameterId()) {
+#ifndef TONPLUGINS_DEMO
 						case PARAMETER_MODE:
 							if (param->getPoint(points - 1, sample_offset, value) == kResultTrue) {
 								// Normalized -> Discrete
@@ -271,12 +290,45 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 								_fx->intensity(value);
 							}
 							break;
+#endif
+						case PARAMETER_MIX:
+							if (param->getPoint(points - 1, sample_offset, value) == kResultTrue) {
+								_mix = static_cast<float>(value);
+							}
+							break;
+						case PARAMETER_GAIN:
+							if (param->getPoint(points - 1, sample_offset, value) == kResultTrue) {
+								_gain = ::vst3::gain_from_normalized(value);
+							}
+							break;
+						case PARAMETER_QUALITY:
+							if (param->getPoint(points - 1, sample_offset, value) == kResultTrue) {
+								_quality    = ::vst3::quality_from_normalized(value);
+								reconfigure = true;
+							}
+							break;
+						case PARAMETER_PHASE:
+							if (param->getPoint(points - 1, sample_offset, value) == kResultTrue) {
+								_phase      = ::vst3::phase_from_normalized(value);
+								reconfigure = true;
+							}
+							break;
 						}
 					}
 				}
 			}
 		}
-#endif
+
+		// Settings that need new buffers or resamplers can arrive while processing, from the host or from a loaded
+		// state. Apply them right away, like setProcessing() would, instead of waiting for a reactivation that the host
+		// may already have done before the new value reached us.
+		if (reconfigure) {
+			std::unique_lock<std::mutex> lock(_lock);
+			update_resampler_settings();
+		}
+		if (_dirty) {
+			reset();
+		}
 
 		// process Thread:
 		// 1. We write each channel's data into the corresponding in_unresampled entry.
@@ -290,27 +342,31 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 		//
 		// Either 2 or 4 threads. 2 seems sane for now, so let's go with that.
 
-		for (size_t idx = 0; idx < _channels; idx++) {
-			D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
-		}
+		D_LOG_LOUD("%8zu %8zu %8zu %8zu %8ld %lld", _in_unresampled.used(), _in_resampled.used(), _out_unresampled.used(), _out_resampled.used(), data.numSamples, _local_delay);
 
-		// Push all data into the unresampled buffer.
-		step_copy_in((const float**)(float**)data.inputs[0].channelBuffers32, _in_unresampled, data.numSamples);
+		// Remember where the host runs its audio thread, so that the worker can stay out of its way.
+		_host_cpu = ::voicefx::thread::current_cpu();
 
-		for (size_t idx = 0; idx < _channels; idx++) {
-			D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
+		// Push all data into the unresampled buffer.
+		if (processSetup.symbolicSampleSize == kSample64) {
+			step_copy_in((const double**)data.inputs[0].channelBuffers64, _in_unresampled, data.numSamples);
+		} else {
+			step_copy_in((const float**)data.inputs[0].channelBuffers32, _in_unresampled, data.numSamples);
 		}
 
+		// The worker path is still disabled: it would race process() on the buffers and on reset(). Until it is finished,
+		// everything runs on the host audio thread, and the worker only applies its scheduling policy and waits.
 		if (false) {
 			// Listen to signal
 			{
 				std::unique_lock<std::mutex> lock(_lock);
-				_worker_signal = true;
+				_worker_signal      = true;
+				_worker_signal_time = std::chrono::high_resolution_clock::now();
 				_worker_cv.notify_all();
 			}
 		} else {
-			decltype(_in_unresampled)* ins  = &_in_unresampled;
-			decltype(_in_unresampled)* outs = &_out_resampled;
+			buffer_t* ins  = &_in_unresampled;
+			buffer_t* outs = &_out_resampled;
 
 			// Resample input if necessary.
 			if (_resample) {
@@ -319,10 +375,6 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 
 				step_resample_in(*ins, *outs);
 
-				for (size_t idx = 0; idx < _channels; idx++) {
-					D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
-				}
-
 				// Swap things so the next step works.
 				ins  = outs;
 				outs = &_out_unresampled;
@@ -338,22 +390,16 @@ tresult PLUGIN_API vst3::effect::processor::process(ProcessData& data)
 				ins  = outs;
 				outs = &_out_resampled;
 
-				for (size_t idx = 0; idx < _channels; idx++) {
-					D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
-				}
-
 				step_resample_out(*ins, *outs);
 			}
 		}
 
-		for (size_t idx = 0; idx < _channels; idx++) {
-			D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
-		}
-
-		step_copy_out(_out_resampled, (float**)data.outputs[0].channelBuffers32, data.numSamples);
+		D_LOG_LOUD("%8zu %8zu %8zu %8zu %8ld %lld", _in_unresampled.used(), _in_resampled.used(), _out_unresampled.used(), _out_resampled.used(), data.numSamples, _local_delay);
 
-		for (size_t idx = 0; idx < _channels; idx++) {
-			D_LOG_LOUD("[%zu] %8zu %8zu %8zu %8zu %8ld %lld", idx, _in_unresampled[idx]->used(), _in_resampled.size() > 0 ? _in_resampled[idx]->used() : 0, _out_unresampled.size() > 0 ? _out_unresampled[idx]->used() : 0, _out_resampled[idx]->used(), data.numSamples, _local_delay);
+		if (processSetup.symbolicSampleSize == kSample64) {
+			step_copy_out(_out_resampled, data.outputs[0].channelBuffers64, data.numSamples);
+		} else {
+			step_copy_out(_out_resampled, data.outputs[0].channelBuffers32, data.numSamples);
 		}
 
 		return kResultOk;
@@ -389,6 +435,25 @@ tresult PLUGIN_API vst3::effect::processor::setState(IBStream* state)
 			return kResultFalse;
 		}
 #endif
+		// Mix and gain were added later, so older states don't have them.
+		if (float value = 0; streamer.readFloat(value) == true) {
+			_mix = value;
+		}
+		if (float value = 0; streamer.readFloat(value) == true) {
+			_gain = value;
+		}
+		if (int32 value = 0; streamer.readInt32(value) == true) {
+			_quality = static_cast<::voicefx::resampler_quality>(std::clamp<int32>(value, static_cast<int32>(::voicefx::resampler_quality::AUTOMATIC), static_cast<int32>(::voicefx::resampler_quality::BEST)));
+		}
+		if (int32 value = 0; streamer.readInt32(value) == true) {
+			_phase = (value == static_cast<int32>(::voicefx::resampler_phase::MINIMUM)) ? ::voicefx::resampler_phase::MINIMUM : ::voicefx::resampler_phase::LINEAR;
+		}
+
+		// A preset may use a different quality tier or phase, which changes the latency.
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			update_resampler_settings();
+		}
 
 		return kResultOk;
 	} catch (std::exception const& ex) {
@@ -397,6 +462,35 @@ tresult PLUGIN_API vst3::effect::processor::setState(IBStream* state)
 	}
 }
 
+tresult PLUGIN_API vst3::effect::processor::notify(IMessage* message)
+{
+	D_LOG_LOUD("");
+	try {
+		if (message == nullptr) {
+			return kInvalidArgument;
+		}
+
+		// The controller sends a new quality tier or phase before it asks the host to restart us, so that the restart
+		// already sees it. The same value arriving later through process() then changes nothing.
+		if (strcmp(message->getMessageID(), ::vst3::message_resampler) == 0) {
+			std::unique_lock<std::mutex> lock(_lock);
+			if (int64 value = 0; message->getAttributes()->getInt(::vst3::attribute_quality, value) == kResultOk) {
+				_quality = static_cast<::voicefx::resampler_quality>(std::clamp<int64>(value, static_cast<int64>(::voicefx::resampler_quality::AUTOMATIC), static_cast<int64>(::voicefx::resampler_quality::BEST)));
+			}
+			if (int64 value = 0; message->getAttributes()->getInt(::vst3::attribute_phase, value) == kResultOk) {
+				_phase = (value == static_cast<int64>(::voicefx::resampler_phase::MINIMUM)) ? ::voicefx::resampler_phase::MINIMUM : ::voicefx::resampler_phase::LINEAR;
+			}
+			update_resampler_settings();
+			return kResultOk;
+		}
+
+		return AudioEffect::notify(message);
+	} catch (std::exception const& ex) {
+		D_LOG("EXCEPTION: %s", ex.what());
+		return kInternalError;
+	}
+}
+
 tresult PLUGIN_API vst3::effect::processor::getState(IBStream* state)
 {
 	D_LOG_LOUD("");
@@ -411,6 +505,10 @@ tresult PLUGIN_API vst3::effect::processor::getState(IBStream* state)
 		streamer.writeBool(_fx->dereverb_enabled());
 		streamer.writeFloat(_fx->intensity());
 #endif
+		streamer.writeFloat(_mix);
+		streamer.writeFloat(_gain);
+		streamer.writeInt32(static_cast<int32>(_quality));
+		streamer.writeInt32(static_cast<int32>(_phase));
 
 		return kResultOk;
 	} catch (std::exception const& ex) {
@@ -442,29 +540,87 @@ void vst3::effect::processor::reset()
 		_resample = (_samplerate != _fx->input_samplerate());
 
 		// Allocate Buffers
-		D_LOG_LOUD("Reallocating Buffers to fit %" PRIu64 " and %" PRIu32 " samples...", _samplerate, _fx->input_samplerate());
-		_in_unresampled.resize(_channels);
-		_in_unresampled.shrink_to_fit();
-		_out_resampled.resize(_channels);
-		_out_resampled.shrink_to_fit();
-		if (_resample) {
-			_in_resampled.resize(_channels);
-			_in_resampled.shrink_to_fit();
-			_out_unresampled.resize(_channels);
-			_out_unresampled.shrink_to_fit();
-		} else {
-			_in_resampled.clear();
-			_out_unresampled.clear();
-		}
-		for (size_t idx = 0; idx < _channels; idx++) {
-			_in_unresampled[idx] = std::make_shared<tonplugins::memory::float_ring_t>(_samplerate);
-			_out_resampled[idx]  = std::make_shared<tonplugins::memory::float_ring_t>(_samplerate);
+		calculate_delay();
+		{
+			size_t   block   = static_cast<size_t>(std::max<int32>(processSetup.maxSamplesPerBlock, 1));
+			size_t   frame   = _fx->input_blocksize();
+			uint32_t fx_rate = _fx->input_samplerate();
+
+			// Express the host block and the effect frame in the respective other sample rate.
+			size_t block_fx   = block;
+			size_t frame_host = frame;
 			if (_resample) {
-				_in_resampled[idx]    = std::make_shared<tonplugins::memory::float_ring_t>(_fx->input_samplerate());
-				_out_unresampled[idx] = std::make_shared<tonplugins::memory::float_ring_t>(_fx->input_samplerate());
+				size_t channels = std::max<size_t>(_channels, 1);
+				block_fx        = ::voicefx::resampler::get_plan(_samplerate, fx_rate, _resampler_quality, channels, _phase)->max_output(block);
+				frame_host      = ::voicefx::resampler::get_plan(fx_rate, _samplerate, _resampler_quality, channels, _phase)->max_output(frame);
+			}
+
+			// Each stage has to hold at most one block, one partial frame and whatever the resamplers hold back. The
+			// final stage additionally holds the output that is delayed until the local delay has been satisfied.
+			size_t in_unresampled  = 2 * (block + frame_host + _in_delay);
+			size_t in_resampled    = 2 * (block_fx + frame + _in_delay);
+			size_t out_unresampled = 2 * (block_fx + frame);
+			size_t out_resampled   = 2 * (block + frame_host + _out_delay) + static_cast<size_t>(_local_delay);
+
+			// The dry signal is held back by exactly the reported latency, plus room for one block.
+			size_t dry = static_cast<size_t>(_delay) + block;
+
+			// VOICEFX_RESAMPLER_HIGHBAND carries everything above the Nyquist rate of the effect past it, instead of
+			// dropping it. That band is not denoised even with Mix at 100%, so it is opt-in. It can only be split off
+			// exactly if both directions are pure halfband cascades, as only those have a whole number of samples of
+			// delay, so 192 kHz gets it but 176.4 kHz doesn't. It is then held back by whatever the splitter doesn't
+			// cover.
+			::voicefx::reaper::dispose(std::move(_splitter));
+			if (_resample && ::voicefx::environment::get_bool("VOICEFX_RESAMPLER_HIGHBAND", false)) {
+				size_t channels = std::max<size_t>(_channels, 1);
+				auto   down     = ::voicefx::resampler::get_plan(_samplerate, fx_rate, _resampler_quality, channels, _phase)->cascade;
+				auto   up       = ::voicefx::resampler::get_plan(fx_rate, _samplerate, _resampler_quality, channels, _phase)->cascade;
+				if (down && up && down->decimate && !down->fraction && !up->fraction) {
+					_splitter = std::make_shared<::voicefx::halfband::splitter>(down, up, _channels, block);
+				}
 			}
+			size_t high = _splitter ? dry : 0;
+
+			size_t size = buffer_t::footprint(_channels, in_unresampled) + buffer_t::footprint(_channels, out_resampled) + buffer_t::footprint(_channels, dry) + buffer_t::footprint(_channels, high);
+			if (_resample) {
+				size += buffer_t::footprint(_channels, in_resampled) + buffer_t::footprint(_channels, out_unresampled);
+			}
+			size *= sizeof(float);
+
+			D_LOG_LOUD("Reallocating Buffers to fit %zu samples per block at %" PRIu64 " Hz and %" PRIu32 " Hz...", block, _samplerate, fx_rate);
+			_arena          = std::make_shared<::voicefx::audio::arena>(size, ::voicefx::environment::get_bool("VOICEFX_LOCK_MEMORY", false));
+			_in_unresampled = buffer_t(*_arena, _channels, in_unresampled);
+			_out_resampled  = buffer_t(*_arena, _channels, out_resampled);
+			_dry            = buffer_t(*_arena, _channels, dry);
+			_dry.write(static_cast<size_t>(_delay));
+			if (_splitter) {
+				_high = buffer_t(*_arena, _channels, high);
+				_high.write(static_cast<size_t>(_delay) - _splitter->delay());
+				_high_mix.resize(block);
+				D_LOG("Carrying everything above %" PRIu32 " Hz past the effect, %zu samples of the delay are covered by the split.", fx_rate / 2, _splitter->delay());
+			} else {
+				_high     = buffer_t();
+				_high_mix = std::vector<float>();
+			}
+			if (_resample) {
+				_in_resampled    = buffer_t(*_arena, _channels, in_resampled);
+				_out_unresampled = buffer_t(*_arena, _channels, out_unresampled);
+			} else {
+				_in_resampled    = buffer_t();
+				_out_unresampled = buffer_t();
+			}
+
+			// Compare against the previous layout, which gave every stage and channel a full second of audio.
+			size_t legacy_size = _channels * sizeof(float) * 2 * (static_cast<size_t>(_samplerate) + (_resample ? fx_rate : 0));
+			D_LOG("Buffers use %zu bytes for %zu channels, per-second buffers would use %zu bytes.", _arena->size(), _channels, legacy_size);
 		}
 
+		// Restart the drift monitor, now that the buffers start out empty again.
+		_host_samples = 0;
+		_wet_samples  = 0;
+		_wet_offset   = _local_delay;
+		_wet_drift    = 0;
+
 		// Reset/Allocate Resamplers
 		if (_resample) {
 			D_LOG_LOUD("Resetting resamplers...");
@@ -472,22 +628,27 @@ void vst3::effect::processor::reset()
 				_in_resampler = std::make_shared<::voicefx::resampler>();
 			}
 			_in_resampler->channels(_channels);
+			_in_resampler->quality(_resampler_quality);
+			_in_resampler->phase(_phase);
 			_in_resampler->ratio(_samplerate, _fx->input_samplerate());
+			_in_resampler->reserve(_in_unresampled.capacity(), _in_resampled.capacity());
 			_in_resampler->clear();
 			_in_resampler->load();
 			if (!_out_resampler) {
 				_out_resampler = std::make_shared<::voicefx::resampler>();
 			}
 			_out_resampler->channels(_channels);
+			_out_resampler->quality(_resampler_quality);
+			_out_resampler->phase(_phase);
 			_out_resampler->ratio(_fx->input_samplerate(), _samplerate);
+			_out_resampler->reserve(_out_unresampled.capacity(), _out_resampled.capacity());
 			_out_resampler->clear();
 			_out_resampler->load();
 		} else {
-			_in_resampler.reset();
-			_out_resampler.reset();
+			::voicefx::reaper::dispose(std::move(_in_resampler));
+			::voicefx::reaper::dispose(std::move(_out_resampler));
 		}
 
-		calculate_delay();
 		_dirty = false;
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
@@ -508,45 +669,63 @@ void vst3::effect::processor::set_channel_count(size_t num)
 	}
 }
 
-void vst3::effect::processor::step_copy_in(const float** ins, buffer_container_t& outs, size_t samples)
+template<typename T>
+void vst3::effect::processor::step_copy_in(const T** ins, buffer_t& outs, size_t samples)
 {
 	D_LOG_LOUD("");
 	try {
 		std::unique_lock<std::mutex> ilock(_in_lock);
+		if (samples > outs.free()) {
+			throw_log("Input buffer overflow, %zu samples don't fit into %zu samples.", samples, outs.free());
+		}
+
+		if (samples > _dry.free()) {
+			throw_log("Dry buffer overflow, %zu samples don't fit into %zu samples.", samples, _dry.free());
+		}
+
+		if (_splitter && (samples > _high.free())) {
+			throw_log("High band buffer overflow, %zu samples don't fit into %zu samples.", samples, _high.free());
+		}
+
+		// Conversion to our internal sample format happens while copying, the dry path reuses the converted samples.
 		for (size_t idx = 0; idx < _channels; idx++) {
-			outs[idx]->write(samples, ins[idx]);
+			float* ptr = outs.poke(idx);
+			::voicefx::simd::convert(ins[idx], ptr, samples);
+			memcpy(_dry.poke(idx), ptr, samples * sizeof(float));
+		}
+
+		// Split off the high band from the converted samples, before anything else touches them.
+		if (_splitter) {
+			_splitter->process(outs.poke(), _high.poke(), samples);
+			_high.write(samples);
 		}
+
+		outs.write(samples);
+		_dry.write(samples);
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
 		throw;
 	}
 }
 
-void vst3::effect::processor::step_resample_in(buffer_container_t& ins, buffer_container_t& outs)
+void vst3::effect::processor::step_resample_in(buffer_t& ins, buffer_t& outs)
 {
 	D_LOG_LOUD("");
 	try {
-		std::vector<float const*> inptrs  = {_channels, nullptr};
-		std::vector<float*>       outptrs = {_channels, nullptr};
-
 		// Prepare reads/writes
 		{
 			std::unique_lock<std::mutex> lock(_in_lock);
-			for (size_t idx = 0; idx < _channels; idx++) {
-				inptrs[idx]  = ins[idx]->peek(ins[idx]->used());
-				outptrs[idx] = outs[idx]->poke(outs[idx]->free());
-			}
+			size_t                       in_samples  = ins.used();
+			size_t                       out_samples = outs.free();
 
 			// Resample
 			size_t samples_read    = 0;
 			size_t samples_written = 0;
-			_in_resampler->process(inptrs.data(), ins[0]->used(), samples_read, outptrs.data(), outs[0]->free(), samples_written);
+			_in_resampler->process(ins.peek(), in_samples, samples_read, outs.poke(), out_samples, samples_written);
 
 			// Confirm reads/writes
-			for (size_t idx = 0; idx < _channels; idx++) {
-				ins[idx]->read(samples_read, nullptr);
-				outs[idx]->write(samples_written, nullptr);
-			}
+			ins.read(samples_read);
+			outs.write(samples_written);
 		}
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
@@ -554,31 +733,20 @@ void vst3::effect::processor::step_resample_in(buffer_container_t& ins, buffer_c
 	}
 }
 
-void vst3::effect::processor::step_process(buffer_container_t& ins, buffer_container_t& outs)
+void vst3::effect::processor::step_process(buffer_t& ins, buffer_t& outs)
 {
 	D_LOG_LOUD("");
 	try {
-		std::vector<float const*> inptrs  = {_channels, nullptr};
-		std::vector<float*>       outptrs = {_channels, nullptr};
-
-		size_t samples = ins[0]->used();
+		size_t samples = std::min(ins.used(), outs.free());
 		if (samples > 0) {
-			// Prepare reads/writes
-			for (size_t idx = 0; idx < _channels; idx++) {
-				inptrs[idx]  = ins[idx]->peek(samples);
-				outptrs[idx] = outs[idx]->poke(samples);
-			}
-
 			// This always processes the exact amount of data provided.
 			size_t in_samples  = samples;
 			size_t out_samples = 0;
-			_fx->process(inptrs.data(), in_samples, outptrs.data(), out_samples);
+			_fx->process(ins.peek(), in_samples, outs.poke(), out_samples);
 
 			// Confirm reads/writes
-			for (size_t idx = 0; idx < _channels; idx++) {
-				ins[idx]->read(in_samples, nullptr);
-				outs[idx]->write(out_samples, nullptr);
-			}
+			ins.read(in_samples);
+			outs.write(out_samples);
 		}
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
@@ -586,31 +754,23 @@ void vst3::effect::processor::step_process(buffer_container_t& ins, buffer_conta
 	}
 }
 
-void vst3::effect::processor::step_resample_out(buffer_container_t& ins, buffer_container_t& outs)
+void vst3::effect::processor::step_resample_out(buffer_t& ins, buffer_t& outs)
 {
 	D_LOG_LOUD("");
 	try {
-		std::vector<float const*> inptrs  = {_channels, nullptr};
-		std::vector<float*>       outptrs = {_channels, nullptr};
-
 		{
-			std::unique_lock<std::mutex> _out_lock;
-			// Prepare reads/writes
-			for (size_t idx = 0; idx < _channels; idx++) {
-				inptrs[idx]  = ins[idx]->peek(ins[idx]->used());
-				outptrs[idx] = outs[idx]->poke(outs[idx]->free());
-			}
+			std::unique_lock<std::mutex> lock(_out_lock);
+			size_t                       in_samples  = ins.used();
+			size_t                       out_samples = outs.free();
 
 			// Resample
 			size_t samples_read    = 0;
 			size_t samples_written = 0;
-			_in_resampler->process(inptrs.data(), ins[0]->used(), samples_read, outptrs.data(), outs[0]->free(), samples_written);
+			_out_resampler->process(ins.peek(), in_samples, samples_read, outs.poke(), out_samples, samples_written);
 
 			// Confirm reads/writes
-			for (size_t idx = 0; idx < _channels; idx++) {
-				ins[idx]->read(samples_read, nullptr);
-				outs[idx]->write(samples_written, nullptr);
-			}
+			ins.read(samples_read);
+			outs.write(samples_written);
 		}
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
@@ -618,44 +778,89 @@ void vst3::effect::processor::step_resample_out(buffer_container_t& ins, buffer_
 	}
 }
 
-void vst3::effect::processor::step_copy_out(buffer_container_t& ins, float** outs, size_t samples)
+template<typename T>
+void vst3::effect::processor::step_copy_out(buffer_t& ins, T** outs, size_t samples)
 {
 	D_LOG_LOUD("");
 	try {
-		std::vector<float const*> inptrs  = {_channels, nullptr};
-		std::vector<float*>       outptrs = {_channels, nullptr};
-
 		// Require that the thread is done writing to the output buffers.
 		std::unique_lock lock(_out_lock);
-		size_t           avail = ins[0]->used();
+		size_t           avail = ins.used();
 
+		// Figure out how much of the block is still covered by the local delay.
 		D_LOG_LOUD("Local Delay at %" PRId64 " samples.", _local_delay);
+		size_t offset = samples;
 		if (_local_delay < samples) {
-			size_t real_avail = std::min(samples - _local_delay, avail);
-
-			if (real_avail < samples) {
-				// Return full or partial data.
-				size_t offset = samples - real_avail;
-				for (size_t idx = 0; idx < _channels; idx++) {
-					if (offset > 0) {
-						memset(outs[idx], 0, offset * sizeof(float));
-					}
+			offset = samples - std::min(samples - _local_delay, avail);
+		}
+		size_t wet_samples = samples - offset;
+
+		// Ramp gains across the entire block, so that parameter changes don't cause zipper noise.
+		float wet_target = _gain * _mix;
+		float dry_target = _gain * (1.f - _mix);
+		float wet_step   = (wet_target - _wet_gain) / static_cast<float>(samples);
+		float dry_step   = (dry_target - _dry_gain) / static_cast<float>(samples);
 
-					ins[idx]->read(real_avail, outs[idx] + offset);
+		if (_splitter && (samples > _high_mix.size())) {
+			throw_log("High band mix overflow, %zu samples don't fit into %zu samples.", samples, _high_mix.size());
+		}
+
+		// The high band is part of the wet signal, so it follows the wet gain.
+		auto wet = [this, &ins, offset, wet_samples](size_t idx) -> const float* {
+			if (!_splitter) {
+				return ins.peek(idx);
+			}
+			::voicefx::simd::mix(ins.peek(idx), _high.peek(idx) + offset, _high_mix.data(), wet_samples, 1.f, 0.f, 1.f, 0.f);
+			return _high_mix.data();
+		};
+
+		if ((_wet_gain == 1.f) && (wet_target == 1.f) && (_dry_gain == 0.f) && (dry_target == 0.f)) {
+			// Fully wet at unity gain, so this is just a copy.
+			for (size_t idx = 0; idx < _channels; idx++) {
+				if (offset > 0) {
+					memset(outs[idx], 0, offset * sizeof(T));
 				}
-			} else {
-				for (size_t idx = 0; idx < _channels; idx++) {
-					ins[idx]->read(samples, outs[idx]);
+				if (wet_samples > 0) {
+					::voicefx::simd::convert(wet(idx), outs[idx] + offset, wet_samples);
 				}
 			}
-
 		} else {
 			for (size_t idx = 0; idx < _channels; idx++) {
-				memset(outs[idx], 0, samples * sizeof(float));
+				const float* dry = _dry.peek(idx);
+				if (offset > 0) {
+					// There is no wet signal yet, so mix the dry signal with itself at zero gain.
+					::voicefx::simd::mix(dry, dry, outs[idx], offset, 0.f, 0.f, _dry_gain, dry_step);
+				}
+				if (wet_samples > 0) {
+					::voicefx::simd::mix(wet(idx), dry + offset, outs[idx] + offset, wet_samples, _wet_gain + wet_step * offset, wet_step, _dry_gain + dry_step * offset, dry_step);
+				}
 			}
 		}
+		ins.read(wet_samples);
+		_dry.read(samples);
+		if (_splitter) {
+			_high.read(samples);
+		}
+		_wet_gain = wet_target;
+		_dry_gain = dry_target;
+
 		_local_delay = std::max<int64_t>(0, _local_delay - samples);
 
+		// Check that the round trip through both resamplers still lines up with the host sample count.
+		_host_samples += samples;
+		_wet_samples += wet_samples;
+		if (!_first_audio && (wet_samples > 0)) {
+			_first_audio = true;
+			D_LOG("First processed audio reached the host %.1f ms after creation.", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _created).count());
+		}
+		if (_local_delay == 0) {
+			int64_t drift = static_cast<int64_t>(_host_samples - _wet_samples) - _wet_offset;
+			if (drift != _wet_drift) {
+				D_LOG("Wet signal drifted by %" PRId64 " samples after %" PRIu64 " samples, output resampler is at %" PRId64 ".", drift, _host_samples, _out_resampler ? _out_resampler->drift() : 0);
+				_wet_drift = drift;
+			}
+		}
+
 	} catch (std::exception const& ex) {
 		D_LOG("EXCEPTION: %s", ex.what());
 		throw;
@@ -666,51 +871,69 @@ void vst3::effect::processor::worker()
 {
 	D_LOG_LOUD("");
 	try {
-#if WIN32
-		SetThreadPriority(GetCurrentThread(), HIGH_PRIORITY_CLASS);
-		SetThreadPriorityBoost(GetCurrentThread(), false);
-		SetProcessPriorityBoost(GetCurrentProcess(), false);
-#endif
+		::voicefx::thread::latency_monitor monitor("Worker");
+		int32_t                            affinity_cpu = -1;
+		bool                               scheduled    = false;
 
 		std::unique_lock<std::mutex> lock(_lock);
 		do {
 			_worker_cv.wait(lock, [this] { return _worker_quit || _worker_signal; });
+			if (_worker_signal) {
+				monitor.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - _worker_signal_time));
+
+				// Only touch the scheduling of the worker once there is audio to process, instances that are just
+				// scanned or loaded shouldn't change anything about the host.
+				if (!scheduled) {
+					scheduled          = true;
+					_worker_policy     = ::voicefx::thread::policy::from_environment();
+					std::string result = ::voicefx::thread::apply_scheduler(_worker_policy);
+					affinity_cpu       = _host_cpu;
+					::voicefx::thread::apply_affinity(_worker_policy, affinity_cpu);
+					D_LOG("Worker thread uses %s scheduling (requested %s).", result.c_str(), ::voicefx::thread::name(_worker_policy.scheduler));
+				}
+			}
+
+			// Follow the host audio thread around if it moved to a different CPU.
+			if (scheduled && _worker_policy.isolate && (affinity_cpu != _host_cpu)) {
+				affinity_cpu = _host_cpu;
+				::voicefx::thread::apply_affinity(_worker_policy, affinity_cpu);
+			}
 
 			while (_worker_signal) {
 				_worker_signal = false; // Set this as early as possible.
 
-				decltype(_in_unresampled)& ins  = _in_unresampled;
-				decltype(_in_unresampled)& outs = _out_resampled;
+				buffer_t* ins  = &_in_unresampled;
+				buffer_t* outs = &_out_resampled;
 
 				// Resample input if necessary.
 				if (_resample) {
-					ins  = _in_unresampled;
-					outs = _in_resampled;
+					ins  = &_in_unresampled;
+					outs = &_in_resampled;
 
-					step_resample_in(ins, outs);
+					step_resample_in(*ins, *outs);
 
 					// Swap things so the next step works.
 					ins  = outs;
-					outs = _out_unresampled;
+					outs = &_out_unresampled;
 				} else {
-					ins  = _in_unresampled;
-					outs = _out_resampled;
+					ins  = &_in_unresampled;
+					outs = &_out_resampled;
 				}
 
 				if (_resample) {
-					step_process(ins, outs);
+					step_process(*ins, *outs);
 				} else { // Couldn't figure out how to skip this without an if/else duplication. :/
 					std::unique_lock<std::mutex> ilock(_in_lock);
 					std::unique_lock<std::mutex> ulock(_out_lock);
-					step_process(ins, outs);
+					step_process(*ins, *outs);
 				}
 
 				// Resample output if necessary.
 				if (_resample) {
 					ins  = outs;
-					outs = _out_resampled;
+					outs = &_out_resampled;
 
-					step_resample_out(ins, outs);
+					step_resample_out(*ins, *outs);
 				}
 			}
 		} while (!_worker_quit);
@@ -736,28 +959,83 @@ FUnknown* vst3::effect::processor::create(void* data)
 
 void vst3::effect::processor::calculate_delay()
 {
-	size_t in_delay  = 0;
-	size_t out_delay = 0;
+	// The resampler latency depends on the tier in use.
+	resolve_quality();
+
+	_in_delay  = 0;
+	_out_delay = 0;
+	size_t in_round  = 0;
+	size_t out_round = 0;
+
+	// Everything on the effect side of the resamplers runs at the effect sample rate, so it has to be converted to
+	// host samples. Rounding only happens once at the end, so that the exact delays of both resamplers add up.
+	double scale = _resample ? static_cast<double>(_samplerate) / static_cast<double>(_fx->input_samplerate()) : 1.;
+	double wet   = static_cast<double>(_fx->delay()) * scale;
 	if (_resample) {
-		in_delay  = ::voicefx::resampler::calculate_delay(_samplerate, _fx->input_samplerate());
-		out_delay = ::voicefx::resampler::calculate_delay(_fx->input_samplerate(), _samplerate);
-		D_LOG_LOUD("In/Out delay %zu %zu", in_delay, out_delay);
+		// Plans are shared process-wide, so this only measures anything the first time a configuration is seen.
+		size_t channels = std::max<size_t>(_channels, 1);
+		auto   in_plan  = ::voicefx::resampler::get_plan(_samplerate, _fx->input_samplerate(), _resampler_quality, channels, _phase);
+		auto   out_plan = ::voicefx::resampler::get_plan(_fx->input_samplerate(), _samplerate, _resampler_quality, channels, _phase);
+		_in_delay       = in_plan->delay;
+		_out_delay      = out_plan->delay;
+		in_round        = in_plan->round;
+		out_round       = out_plan->round;
+		wet += in_plan->exact_delay * scale + out_plan->exact_delay;
+		if ((in_plan->phase != _phase) || (out_plan->phase != _phase)) {
+			D_LOG("Minimum phase is not available for '%s' at %" PRId64 " Hz, using linear phase instead.", ::voicefx::resampler::quality_name(_resampler_quality), _samplerate);
+		}
+		D_LOG_LOUD("Resampler latency is %.2f samples in and %.2f samples out at '%s'.", in_plan->exact_delay, out_plan->exact_delay, ::voicefx::resampler::quality_name(_resampler_quality));
 	}
 
-	_local_delay = _fx->input_blocksize();
+	_local_delay = static_cast<int64_t>(std::ceil(static_cast<double>(_fx->input_blocksize()) * scale));
 	if (_resample) {
-		_local_delay += in_delay + out_delay;
+		_local_delay += static_cast<int64_t>(std::ceil(static_cast<double>(_in_delay) * scale)) + static_cast<int64_t>(_out_delay);
 		_local_delay *= 2;
+
+		// Batched resamplers hand out their output one call late, which is one host block for each of them, and hold
+		// back up to a round of input until it is complete.
+		int64_t block = std::max<int64_t>(processSetup.maxSamplesPerBlock, 1);
+		if (in_round > 0) {
+			_local_delay += block + static_cast<int64_t>(in_round);
+		}
+		if (out_round > 0) {
+			_local_delay += block + static_cast<int64_t>(std::ceil(static_cast<double>(out_round) * scale));
+		}
 	}
 	D_LOG("Processing latency appears to be %" PRId64 " samples.", _local_delay);
 
 	// Calculate absolute effect delay
-	_delay = _fx->delay();
-	_delay += _local_delay;
-	if (_resample) {
-		_delay += in_delay + out_delay;
-	}
+	_delay = _local_delay + std::llround(wet);
 	D_LOG("Latency is estimated to be %" PRId64 " samples.", _delay);
 }
 
 void vst3::effect::processor::calculate_local_delay() {}
+
+void vst3::effect::processor::update_resampler_settings()
+{
+	// A different quality tier or phase needs new resamplers.
+	resolve_quality();
+	if (_in_resampler && ((_in_resampler->quality() != _resampler_quality) || (_in_resampler->phase() != _phase))) {
+		_dirty = true;
+	}
+
+	// Report the new latency right away, reset() applies it. Without any change the running state has to stay as it
+	// is, as the local delay is still counting down and the drift monitor is still running.
+	if (_dirty) {
+		calculate_delay();
+	}
+}
+
+void vst3::effect::processor::resolve_quality()
+{
+	if (_quality != ::voicefx::resampler_quality::AUTOMATIC) {
+		_resampler_quality = _quality;
+	} else if (_resample) {
+		// Both directions run once per channel, which is roughly twice the cost of the input direction.
+		double budget      = ::voicefx::environment::get_float("VOICEFX_RESAMPLER_BUDGET", 0.1);
+		_resampler_quality = ::voicefx::resampler::automatic_quality(static_cast<uint32_t>(_samplerate), _fx->input_samplerate(), _channels * 2, budget);
+	} else {
+		_resampler_quality = ::voicefx::resampler_quality::BEST;
+	}
+	D_LOG_LOUD("Resampler quality '%s' resolves to '%s'.", ::voicefx::resampler::quality_name(_quality), ::voicefx::resampler::quality_name(_resampler_quality));
+}
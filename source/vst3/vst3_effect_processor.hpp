@@ -22,14 +22,16 @@
 // OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
-#include <ringbuffer.hpp>
-#include "nvidia-afx-effect.hpp"
-#include "nvidia-afx.hpp"
+#include "audio-buffer.hpp"
+#include "backend.hpp"
+#include "resampler-halfband.hpp"
 #include "resampler.hpp"
+#include "util-thread.hpp"
 #include "vst3.hpp"
 
 #include "warning-disable.hpp"
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <public.sdk/source/vst/vstaudioeffect.h>
@@ -53,21 +55,45 @@ namespace vst3::effect {
 
 		int64_t _delay;
 		int64_t _local_delay;
+		size_t  _in_delay;
+		size_t  _out_delay;
 
-		typedef tonplugins::memory::float_ring_t raw_buffer_t;
-		typedef std::shared_ptr<raw_buffer_t>    buffer_t;
-		typedef std::vector<buffer_t>            buffer_container_t;
+		// Samples handed to the host, and how many of those were wet. Once the local delay has passed both must stay
+		// exactly _wet_offset apart, otherwise the chain has drifted against the reported latency.
+		uint64_t _host_samples;
+		uint64_t _wet_samples;
+		int64_t  _wet_offset;
+		int64_t  _wet_drift;
+
+		float _mix;
+		float _gain;
+		float _wet_gain;
+		float _dry_gain;
+
+		::voicefx::resampler_quality _quality;
+		::voicefx::resampler_quality _resampler_quality;
+		::voicefx::resampler_phase   _phase;
+
+		typedef ::voicefx::audio::planar_buffer buffer_t;
+
+		std::shared_ptr<::voicefx::audio::arena> _arena;
+		buffer_t                                 _dry;
+
+		// Everything above the effect's Nyquist frequency bypasses the effect, delayed to line up with the wet signal.
+		std::shared_ptr<::voicefx::halfband::splitter> _splitter;
+		buffer_t                                       _high;
+		std::vector<float>                             _high_mix;
 
 		std::mutex                            _in_lock;
-		buffer_container_t                    _in_unresampled;
-		buffer_container_t                    _in_resampled;
+		buffer_t                              _in_unresampled;
+		buffer_t                              _in_resampled;
 		std::shared_ptr<::voicefx::resampler> _in_resampler;
 
-		std::shared_ptr<::nvidia::afx::effect> _fx;
+		std::shared_ptr<::voicefx::backend> _fx;
 
 		std::mutex                            _out_lock;
-		buffer_container_t                    _out_resampled;
-		buffer_container_t                    _out_unresampled;
+		buffer_t                              _out_resampled;
+		buffer_t                              _out_unresampled;
 		std::shared_ptr<::voicefx::resampler> _out_resampler;
 
 		std::mutex              _lock;
@@ -76,6 +102,14 @@ namespace vst3::effect {
 		bool                    _worker_quit;
 		bool                    _worker_signal;
 
+		::voicefx::thread::policy                      _worker_policy;
+		std::chrono::high_resolution_clock::time_point _worker_signal_time;
+		std::atomic_int32_t                            _host_cpu;
+
+		// Startup-to-first-audio, logged once per processor.
+		std::chrono::high_resolution_clock::time_point _created;
+		bool                                           _first_audio;
+
 		public:
 		processor();
 		virtual ~processor();
@@ -95,17 +129,23 @@ namespace vst3::effect {
 		Steinberg::tresult PLUGIN_API setState(Steinberg::IBStream* state) override;
 		Steinberg::tresult PLUGIN_API getState(Steinberg::IBStream* state) override;
 
+		Steinberg::tresult PLUGIN_API notify(Steinberg::Vst::IMessage* message) override;
+
 		private:
 		void reset();
 		void set_channel_count(size_t num);
 		void calculate_local_delay();
 		void calculate_delay();
-
-		void step_copy_in(const float** ins, buffer_container_t& outs, size_t samples);
-		void step_resample_in(buffer_container_t& ins, buffer_container_t& outs);
-		void step_process(buffer_container_t& ins, buffer_container_t& outs);
-		void step_resample_out(buffer_container_t& ins, buffer_container_t& outs);
-		void step_copy_out(buffer_container_t& ins, float** outs, size_t samples);
+		void resolve_quality();
+		void update_resampler_settings();
+
+		template<typename T>
+		void step_copy_in(const T** ins, buffer_t& outs, size_t samples);
+		void step_resample_in(buffer_t& ins, buffer_t& outs);
+		void step_process(buffer_t& ins, buffer_t& outs);
+		void step_resample_out(buffer_t& ins, buffer_t& outs);
+		template<typename T>
+		void step_copy_out(buffer_t& ins, T** outs, size_t samples);
 
 		void worker();
 
@@ -17,6 +17,7 @@
 #include <math.h>
 
 #include "common.h"
+#include "src_sinc_simd.h"
 
 #define	SINC_MAGIC_MARKER	MAKE_MAGIC (' ', 's', 'i', 'n', 'c', ' ')
 
@@ -42,6 +43,7 @@
 typedef int32_t increment_t ;
 typedef float	coeff_t ;
 typedef int _CHECK_SHIFT_BITS[2 * (SHIFT_BITS < sizeof (increment_t) * 8 - 1) - 1]; /* sanity check. */
+typedef int _CHECK_SIMD_SHIFT_BITS[2 * (SHIFT_BITS == SINC_SIMD_SHIFT_BITS) - 1]; /* sanity check. */
 
 #ifdef ENABLE_SINC_FAST_CONVERTER
   #include "fastest_coeffs.h"
@@ -65,6 +67,9 @@ typedef struct
 
 	coeff_t const	*coeffs ;
 
+	/* Vectorized filter kernel picked at creation, or NULL for the scalar loops. */
+	sinc_simd_fn	simd ;
+
 	int		b_current, b_end, b_real_end, b_len ;
 
 	/* Sure hope noone does more than 128 channels at once. */
@@ -240,6 +245,8 @@ sinc_filter_new (int converter_type, int channels)
 #endif
 		}
 
+		priv->simd = sinc_simd_select (channels) ;
+
 		priv->b_len = 3 * (int) lrint ((priv->coeff_half_len + 2.0) / priv->index_inc * SRC_MAX_RATIO + 1) ;
 		priv->b_len = MAX (priv->b_len, 4096) ;
 		priv->b_len *= channels ;
@@ -349,14 +356,29 @@ sinc_copy (SRC_STATE *state)
 		return NULL ;
 	}
 	memcpy (to_filter, from_filter, sizeof (SINC_FILTER)) ;
-	to_filter->buffer = (float *) malloc (sizeof (float) * (from_filter->b_len + state->channels)) ;
+
+	/*
+	** A state that has not processed anything since the last reset holds
+	** nothing but zeros, so there is no need to touch the whole buffer.
+	** This keeps cloning of template states cheap.
+	*/
+	if (from_filter->b_current == 0 && from_filter->b_end == 0 && from_filter->b_real_end == -1)
+	{	to_filter->buffer = (float *) calloc (from_filter->b_len + state->channels, sizeof (float)) ;
+		if (to_filter->buffer)
+			memset (to_filter->buffer + to_filter->b_len, 0xAA, state->channels * sizeof (to_filter->buffer [0])) ;
+		}
+	else
+	{	to_filter->buffer = (float *) malloc (sizeof (float) * (from_filter->b_len + state->channels)) ;
+		if (to_filter->buffer)
+			memcpy (to_filter->buffer, from_filter->buffer, sizeof (float) * (from_filter->b_len + state->channels)) ;
+		} ;
+
 	if (!to_filter->buffer)
 	{
 		free (to) ;
 		free (to_filter) ;
 		return NULL ;
 	}
-	memcpy (to_filter->buffer, from_filter->buffer, sizeof (float) * (from_filter->b_len + state->channels)) ;
 
 	to->private_data = to_filter ;
 
@@ -390,6 +412,11 @@ calc_output_single (SINC_FILTER *filter, increment_t increment, increment_t star
 		data_index += steps ;
 	}
 	left = 0.0 ;
+	if (filter->simd != NULL)
+	{	if (filter_index >= MAKE_INCREMENT_T (0))
+			filter->simd (filter->coeffs, filter->buffer + data_index, 1, filter_index / increment + 1, filter_index, -increment, &left) ;
+		}
+	else
 	while (filter_index >= MAKE_INCREMENT_T (0))
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -410,6 +437,12 @@ calc_output_single (SINC_FILTER *filter, increment_t increment, increment_t star
 	data_index = filter->b_current + 1 + coeff_count ;
 
 	right = 0.0 ;
+	if (filter->simd != NULL)
+	{	/* The kernel walks the data forwards, so start with the last tap. */
+		int taps = filter_index > MAKE_INCREMENT_T (0) ? (filter_index - 1) / increment + 1 : 1 ;
+		filter->simd (filter->coeffs, filter->buffer + data_index - 1 * (taps - 1), 1, taps, filter_index - (taps - 1) * increment, increment, &right) ;
+		}
+	else
 	do
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -543,6 +576,11 @@ calc_output_stereo (SINC_FILTER *filter, int channels, increment_t increment, in
 		data_index += steps * 2;
 	}
 	left [0] = left [1] = 0.0 ;
+	if (filter->simd != NULL)
+	{	if (filter_index >= MAKE_INCREMENT_T (0))
+			filter->simd (filter->coeffs, filter->buffer + data_index, 2, filter_index / increment + 1, filter_index, -increment, left) ;
+		}
+	else
 	while (filter_index >= MAKE_INCREMENT_T (0))
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -564,6 +602,12 @@ calc_output_stereo (SINC_FILTER *filter, int channels, increment_t increment, in
 	data_index = filter->b_current + channels * (1 + coeff_count) ;
 
 	right [0] = right [1] = 0.0 ;
+	if (filter->simd != NULL)
+	{	/* The kernel walks the data forwards, so start with the last tap. */
+		int taps = filter_index > MAKE_INCREMENT_T (0) ? (filter_index - 1) / increment + 1 : 1 ;
+		filter->simd (filter->coeffs, filter->buffer + data_index - 2 * (taps - 1), 2, taps, filter_index - (taps - 1) * increment, increment, right) ;
+		}
+	else
 	do
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -698,6 +742,11 @@ calc_output_quad (SINC_FILTER *filter, int channels, increment_t increment, incr
 		data_index += steps * 4;
 	}
 	left [0] = left [1] = left [2] = left [3] = 0.0 ;
+	if (filter->simd != NULL)
+	{	if (filter_index >= MAKE_INCREMENT_T (0))
+			filter->simd (filter->coeffs, filter->buffer + data_index, 4, filter_index / increment + 1, filter_index, -increment, left) ;
+		}
+	else
 	while (filter_index >= MAKE_INCREMENT_T (0))
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -719,6 +768,12 @@ calc_output_quad (SINC_FILTER *filter, int channels, increment_t increment, incr
 	data_index = filter->b_current + channels * (1 + coeff_count) ;
 
 	right [0] = right [1] = right [2] = right [3] = 0.0 ;
+	if (filter->simd != NULL)
+	{	/* The kernel walks the data forwards, so start with the last tap. */
+		int taps = filter_index > MAKE_INCREMENT_T (0) ? (filter_index - 1) / increment + 1 : 1 ;
+		filter->simd (filter->coeffs, filter->buffer + data_index - 4 * (taps - 1), 4, taps, filter_index - (taps - 1) * increment, increment, right) ;
+		}
+	else
 	do
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -854,6 +909,11 @@ calc_output_hex (SINC_FILTER *filter, int channels, increment_t increment, incre
 		data_index += steps * 6;
 	}
 	left [0] = left [1] = left [2] = left [3] = left [4] = left [5] = 0.0 ;
+	if (filter->simd != NULL)
+	{	if (filter_index >= MAKE_INCREMENT_T (0))
+			filter->simd (filter->coeffs, filter->buffer + data_index, 6, filter_index / increment + 1, filter_index, -increment, left) ;
+		}
+	else
 	while (filter_index >= MAKE_INCREMENT_T (0))
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -875,6 +935,12 @@ calc_output_hex (SINC_FILTER *filter, int channels, increment_t increment, incre
 	data_index = filter->b_current + channels * (1 + coeff_count) ;
 
 	right [0] = right [1] = right [2] = right [3] = right [4] = right [5] = 0.0 ;
+	if (filter->simd != NULL)
+	{	/* The kernel walks the data forwards, so start with the last tap. */
+		int taps = filter_index > MAKE_INCREMENT_T (0) ? (filter_index - 1) / increment + 1 : 1 ;
+		filter->simd (filter->coeffs, filter->buffer + data_index - 6 * (taps - 1), 6, taps, filter_index - (taps - 1) * increment, increment, right) ;
+		}
+	else
 	do
 	{	fraction = fp_to_double (filter_index) ;
 		indx = fp_to_int (filter_index) ;
@@ -0,0 +1,500 @@
+/*
+** Copyright (c) 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+** All rights reserved.
+**
+** This code is released under 2-clause BSD license. Please see the
+** file at : https://github.com/libsndfile/libsamplerate/blob/master/COPYING
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "src_sinc_simd.h"
+
+#if defined (_M_X64) || defined (_M_IX86) || defined (__x86_64__) || defined (__i386__)
+#define	SINC_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined (__aarch64__) || defined (_M_ARM64)
+#define	SINC_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* Allow individual functions to use instructions the rest of the library is not compiled for. */
+#if defined (SINC_SIMD_X86) && (defined (__GNUC__) || defined (__clang__))
+#define	SINC_TARGET(x)	__attribute__ ((target (x)))
+#else
+#define	SINC_TARGET(x)
+#endif
+
+#ifdef _MSC_VER
+#define	SINC_ALIGN(x)	__declspec (align (x))
+#else
+#define	SINC_ALIGN(x)	__attribute__ ((aligned (x)))
+#endif
+
+#define	CHUNK			64
+#define	FRACTION_MASK	((1 << SINC_SIMD_SHIFT_BITS) - 1)
+#define	INV_FRACTION	(1.0f / (float) (1 << SINC_SIMD_SHIFT_BITS))
+
+/*========================================================================================
+**	Scalar helpers for the remainders of each chunk.
+*/
+
+static inline void
+interpolate_scalar (const float *coeffs, int count, int32_t index, int32_t step, float *out)
+{	for (int k = 0 ; k < count ; k++)
+	{	int32_t indx = index >> SINC_SIMD_SHIFT_BITS ;
+		float fraction = (float) (index & FRACTION_MASK) * INV_FRACTION ;
+		out [k] = coeffs [indx] + fraction * (coeffs [indx + 1] - coeffs [indx]) ;
+		index += step ;
+		} ;
+} /* interpolate_scalar */
+
+static inline void
+accumulate_scalar (const float *ic, const float *buffer, int channels, int count, float *sum)
+{	for (int k = 0 ; k < count ; k++)
+		for (int ch = 0 ; ch < channels ; ch++)
+			sum [ch] += ic [k] * buffer [k * channels + ch] ;
+} /* accumulate_scalar */
+
+#ifdef SINC_SIMD_X86
+/*========================================================================================
+**	SSE4.1
+*/
+
+SINC_TARGET ("sse4.1")
+static inline void
+interpolate_sse41 (const float *coeffs, int count, int32_t index, int32_t step, float *out)
+{	__m128i vindex = _mm_add_epi32 (_mm_set1_epi32 (index), _mm_mullo_epi32 (_mm_set1_epi32 (step), _mm_setr_epi32 (0, 1, 2, 3))) ;
+	__m128i vstep = _mm_set1_epi32 (step * 4) ;
+	__m128i mask = _mm_set1_epi32 (FRACTION_MASK) ;
+	__m128 scale = _mm_set1_ps (INV_FRACTION) ;
+	int k = 0 ;
+
+	for ( ; k + 4 <= count ; k += 4)
+	{	__m128i indx = _mm_srli_epi32 (vindex, SINC_SIMD_SHIFT_BITS) ;
+		int i0 = _mm_extract_epi32 (indx, 0), i1 = _mm_extract_epi32 (indx, 1) ;
+		int i2 = _mm_extract_epi32 (indx, 2), i3 = _mm_extract_epi32 (indx, 3) ;
+		__m128 c0 = _mm_setr_ps (coeffs [i0], coeffs [i1], coeffs [i2], coeffs [i3]) ;
+		__m128 c1 = _mm_setr_ps (coeffs [i0 + 1], coeffs [i1 + 1], coeffs [i2 + 1], coeffs [i3 + 1]) ;
+		__m128 fraction = _mm_mul_ps (_mm_cvtepi32_ps (_mm_and_si128 (vindex, mask)), scale) ;
+		_mm_store_ps (out + k, _mm_add_ps (c0, _mm_mul_ps (fraction, _mm_sub_ps (c1, c0)))) ;
+		vindex = _mm_add_epi32 (vindex, vstep) ;
+		} ;
+
+	interpolate_scalar (coeffs, count - k, index + k * step, step, out + k) ;
+} /* interpolate_sse41 */
+
+SINC_TARGET ("sse4.1")
+static inline float
+hsum_sse41 (__m128 v)
+{	v = _mm_add_ps (v, _mm_movehl_ps (v, v)) ;
+	v = _mm_add_ss (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 1, 1, 1))) ;
+	return _mm_cvtss_f32 (v) ;
+} /* hsum_sse41 */
+
+SINC_TARGET ("sse4.1")
+static inline void
+accumulate_sse41 (const float *ic, const float *buffer, int channels, int count, float *sum)
+{	SINC_ALIGN (16) float lanes [12] ;
+	int k = 0 ;
+
+	switch (channels)
+	{	case 1 :
+		{	__m128 a = _mm_setzero_ps () ;
+			for ( ; k + 4 <= count ; k += 4)
+				a = _mm_add_ps (a, _mm_mul_ps (_mm_load_ps (ic + k), _mm_loadu_ps (buffer + k))) ;
+			sum [0] += hsum_sse41 (a) ;
+			break ;
+			} ;
+
+		case 2 :
+		{	/* Duplicate each coefficient for both channels. */
+			__m128 a0 = _mm_setzero_ps (), a1 = _mm_setzero_ps () ;
+			for ( ; k + 4 <= count ; k += 4)
+			{	__m128 q = _mm_load_ps (ic + k) ;
+				a0 = _mm_add_ps (a0, _mm_mul_ps (_mm_unpacklo_ps (q, q), _mm_loadu_ps (buffer + 2 * k))) ;
+				a1 = _mm_add_ps (a1, _mm_mul_ps (_mm_unpackhi_ps (q, q), _mm_loadu_ps (buffer + 2 * k + 4))) ;
+				} ;
+			_mm_store_ps (lanes, _mm_add_ps (a0, a1)) ;
+			sum [0] += lanes [0] + lanes [2] ;
+			sum [1] += lanes [1] + lanes [3] ;
+			break ;
+			} ;
+
+		case 4 :
+		{	__m128 a0 = _mm_setzero_ps (), a1 = _mm_setzero_ps () ;
+			for ( ; k + 2 <= count ; k += 2)
+			{	a0 = _mm_add_ps (a0, _mm_mul_ps (_mm_set1_ps (ic [k]), _mm_loadu_ps (buffer + 4 * k))) ;
+				a1 = _mm_add_ps (a1, _mm_mul_ps (_mm_set1_ps (ic [k + 1]), _mm_loadu_ps (buffer + 4 * k + 4))) ;
+				} ;
+			_mm_store_ps (lanes, _mm_add_ps (a0, a1)) ;
+			for (int ch = 0 ; ch < 4 ; ch++)
+				sum [ch] += lanes [ch] ;
+			break ;
+			} ;
+
+		case 6 :
+		{	/* Two frames are three vectors, holding channels 0-3, 4-5 + 0-1 and 2-5. */
+			__m128 a0 = _mm_setzero_ps (), a1 = _mm_setzero_ps (), a2 = _mm_setzero_ps () ;
+			for ( ; k + 2 <= count ; k += 2)
+			{	const float *b = buffer + 6 * k ;
+				a0 = _mm_add_ps (a0, _mm_mul_ps (_mm_set1_ps (ic [k]), _mm_loadu_ps (b))) ;
+				a1 = _mm_add_ps (a1, _mm_mul_ps (_mm_setr_ps (ic [k], ic [k], ic [k + 1], ic [k + 1]), _mm_loadu_ps (b + 4))) ;
+				a2 = _mm_add_ps (a2, _mm_mul_ps (_mm_set1_ps (ic [k + 1]), _mm_loadu_ps (b + 8))) ;
+				} ;
+			_mm_store_ps (lanes, a0) ;
+			_mm_store_ps (lanes + 4, a1) ;
+			_mm_store_ps (lanes + 8, a2) ;
+			sum [0] += lanes [0] + lanes [6] ;
+			sum [1] += lanes [1] + lanes [7] ;
+			sum [2] += lanes [2] + lanes [8] ;
+			sum [3] += lanes [3] + lanes [9] ;
+			sum [4] += lanes [4] + lanes [10] ;
+			sum [5] += lanes [5] + lanes [11] ;
+			break ;
+			} ;
+		} ;
+
+	accumulate_scalar (ic + k, buffer + k * channels, channels, count - k, sum) ;
+} /* accumulate_sse41 */
+
+SINC_TARGET ("sse4.1")
+static void
+sinc_sse41 (const float *coeffs, const float *buffer, int channels, int taps, int32_t index, int32_t step, double *acc)
+{	SINC_ALIGN (32) float ic [CHUNK] ;
+
+	while (taps > 0)
+	{	float sum [6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } ;
+		int count = MIN (taps, CHUNK) ;
+
+		interpolate_sse41 (coeffs, count, index, step, ic) ;
+		accumulate_sse41 (ic, buffer, channels, count, sum) ;
+		for (int ch = 0 ; ch < channels ; ch++)
+			acc [ch] += sum [ch] ;
+
+		index += count * step ;
+		buffer += count * channels ;
+		taps -= count ;
+		} ;
+} /* sinc_sse41 */
+
+/*========================================================================================
+**	AVX2 + FMA
+*/
+
+SINC_TARGET ("avx2,fma")
+static inline void
+interpolate_avx2 (const float *coeffs, int count, int32_t index, int32_t step, float *out)
+{	__m256i vindex = _mm256_add_epi32 (_mm256_set1_epi32 (index), _mm256_mullo_epi32 (_mm256_set1_epi32 (step), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7))) ;
+	__m256i vstep = _mm256_set1_epi32 (step * 8) ;
+	__m256i mask = _mm256_set1_epi32 (FRACTION_MASK) ;
+	__m256 scale = _mm256_set1_ps (INV_FRACTION) ;
+	int k = 0 ;
+
+	for ( ; k + 8 <= count ; k += 8)
+	{	__m256i indx = _mm256_srli_epi32 (vindex, SINC_SIMD_SHIFT_BITS) ;
+		__m256 c0 = _mm256_i32gather_ps (coeffs, indx, 4) ;
+		__m256 c1 = _mm256_i32gather_ps (coeffs + 1, indx, 4) ;
+		__m256 fraction = _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_and_si256 (vindex, mask)), scale) ;
+		_mm256_store_ps (out + k, _mm256_fmadd_ps (fraction, _mm256_sub_ps (c1, c0), c0)) ;
+		vindex = _mm256_add_epi32 (vindex, vstep) ;
+		} ;
+
+	interpolate_scalar (coeffs, count - k, index + k * step, step, out + k) ;
+} /* interpolate_avx2 */
+
+SINC_TARGET ("avx2,fma")
+static inline void
+accumulate_avx2 (const float *ic, const float *buffer, int channels, int count, float *sum)
+{	SINC_ALIGN (32) float lanes [24] ;
+	int k = 0 ;
+
+	switch (channels)
+	{	case 1 :
+		{	__m256 a0 = _mm256_setzero_ps (), a1 = _mm256_setzero_ps () ;
+			for ( ; k + 16 <= count ; k += 16)
+			{	a0 = _mm256_fmadd_ps (_mm256_load_ps (ic + k), _mm256_loadu_ps (buffer + k), a0) ;
+				a1 = _mm256_fmadd_ps (_mm256_load_ps (ic + k + 8), _mm256_loadu_ps (buffer + k + 8), a1) ;
+				} ;
+			for ( ; k + 8 <= count ; k += 8)
+				a0 = _mm256_fmadd_ps (_mm256_load_ps (ic + k), _mm256_loadu_ps (buffer + k), a0) ;
+			_mm256_store_ps (lanes, _mm256_add_ps (a0, a1)) ;
+			sum [0] += ((lanes [0] + lanes [1]) + (lanes [2] + lanes [3])) + ((lanes [4] + lanes [5]) + (lanes [6] + lanes [7])) ;
+			break ;
+			} ;
+
+		case 2 :
+		{	/* Duplicate each coefficient for both channels, four frames per vector. */
+			__m256 a = _mm256_setzero_ps () ;
+			for ( ; k + 4 <= count ; k += 4)
+			{	__m128 q = _mm_load_ps (ic + k) ;
+				__m256 c = _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_unpacklo_ps (q, q)), _mm_unpackhi_ps (q, q), 1) ;
+				a = _mm256_fmadd_ps (c, _mm256_loadu_ps (buffer + 2 * k), a) ;
+				} ;
+			_mm256_store_ps (lanes, a) ;
+			sum [0] += (lanes [0] + lanes [2]) + (lanes [4] + lanes [6]) ;
+			sum [1] += (lanes [1] + lanes [3]) + (lanes [5] + lanes [7]) ;
+			break ;
+			} ;
+
+		case 4 :
+		{	/* Two frames per vector. */
+			__m256 a = _mm256_setzero_ps () ;
+			for ( ; k + 2 <= count ; k += 2)
+			{	__m256 c = _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_set1_ps (ic [k])), _mm_set1_ps (ic [k + 1]), 1) ;
+				a = _mm256_fmadd_ps (c, _mm256_loadu_ps (buffer + 4 * k), a) ;
+				} ;
+			_mm256_store_ps (lanes, a) ;
+			for (int ch = 0 ; ch < 4 ; ch++)
+				sum [ch] += lanes [ch] + lanes [ch + 4] ;
+			break ;
+			} ;
+
+		case 6 :
+		{	/* Four frames are three vectors, holding channels 0-5 + 0-1, 2-5 + 0-3 and 4-5 + 0-5. */
+			const __m256i p0 = _mm256_setr_epi32 (0, 0, 0, 0, 0, 0, 1, 1) ;
+			const __m256i p1 = _mm256_setr_epi32 (1, 1, 1, 1, 2, 2, 2, 2) ;
+			const __m256i p2 = _mm256_setr_epi32 (2, 2, 3, 3, 3, 3, 3, 3) ;
+			__m256 a0 = _mm256_setzero_ps (), a1 = _mm256_setzero_ps (), a2 = _mm256_setzero_ps () ;
+			for ( ; k + 4 <= count ; k += 4)
+			{	const float *b = buffer + 6 * k ;
+				__m256 q = _mm256_castps128_ps256 (_mm_load_ps (ic + k)) ;
+				a0 = _mm256_fmadd_ps (_mm256_permutevar8x32_ps (q, p0), _mm256_loadu_ps (b), a0) ;
+				a1 = _mm256_fmadd_ps (_mm256_permutevar8x32_ps (q, p1), _mm256_loadu_ps (b + 8), a1) ;
+				a2 = _mm256_fmadd_ps (_mm256_permutevar8x32_ps (q, p2), _mm256_loadu_ps (b + 16), a2) ;
+				} ;
+			_mm256_store_ps (lanes, a0) ;
+			_mm256_store_ps (lanes + 8, a1) ;
+			_mm256_store_ps (lanes + 16, a2) ;
+			/* Lane n of the 24 holds channel n % 6. */
+			for (int ch = 0 ; ch < 6 ; ch++)
+				sum [ch] += (lanes [ch] + lanes [ch + 6]) + (lanes [ch + 12] + lanes [ch + 18]) ;
+			break ;
+			} ;
+		} ;
+
+	accumulate_scalar (ic + k, buffer + k * channels, channels, count - k, sum) ;
+} /* accumulate_avx2 */
+
+SINC_TARGET ("avx2,fma")
+static void
+sinc_avx2 (const float *coeffs, const float *buffer, int channels, int taps, int32_t index, int32_t step, double *acc)
+{	SINC_ALIGN (32) float ic [CHUNK] ;
+
+	while (taps > 0)
+	{	float sum [6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } ;
+		int count = MIN (taps, CHUNK) ;
+
+		interpolate_avx2 (coeffs, count, index, step, ic) ;
+		accumulate_avx2 (ic, buffer, channels, count, sum) ;
+		for (int ch = 0 ; ch < channels ; ch++)
+			acc [ch] += sum [ch] ;
+
+		index += count * step ;
+		buffer += count * channels ;
+		taps -= count ;
+		} ;
+} /* sinc_avx2 */
+
+static int
+cpu_features (int *sse41, int *avx2)
+{
+#if defined (_MSC_VER)
+	int info [4] = { 0 } ;
+	int max_leaf, osxsave, avx, fma ;
+
+	__cpuid (info, 0) ;
+	max_leaf = info [0] ;
+
+	__cpuid (info, 1) ;
+	*sse41 = (info [2] & (1 << 19)) != 0 ;
+	osxsave = (info [2] & (1 << 27)) != 0 ;
+	avx = (info [2] & (1 << 28)) != 0 ;
+	fma = (info [2] & (1 << 12)) != 0 ;
+
+	*avx2 = 0 ;
+	if (max_leaf >= 7 && osxsave && avx && fma && (_xgetbv (0) & 0x6) == 0x6)
+	{	__cpuidex (info, 7, 0) ;
+		*avx2 = (info [1] & (1 << 5)) != 0 ;
+		} ;
+#else
+	__builtin_cpu_init () ;
+	*sse41 = __builtin_cpu_supports ("sse4.1") ;
+	*avx2 = __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma") ;
+#endif
+	return 0 ;
+} /* cpu_features */
+#endif
+
+#ifdef SINC_SIMD_NEON
+/*========================================================================================
+**	NEON
+*/
+
+static inline void
+interpolate_neon (const float *coeffs, int count, int32_t index, int32_t step, float *out)
+{	const int32_t offsets [4] = { 0, 1, 2, 3 } ;
+	int32x4_t vindex = vaddq_s32 (vdupq_n_s32 (index), vmulq_s32 (vdupq_n_s32 (step), vld1q_s32 (offsets))) ;
+	int32x4_t vstep = vdupq_n_s32 (step * 4) ;
+	int32x4_t mask = vdupq_n_s32 (FRACTION_MASK) ;
+	int k = 0 ;
+
+	for ( ; k + 4 <= count ; k += 4)
+	{	int32x4_t indx = vshrq_n_s32 (vindex, SINC_SIMD_SHIFT_BITS) ;
+		int32_t i0 = vgetq_lane_s32 (indx, 0), i1 = vgetq_lane_s32 (indx, 1) ;
+		int32_t i2 = vgetq_lane_s32 (indx, 2), i3 = vgetq_lane_s32 (indx, 3) ;
+		const float l0 [4] = { coeffs [i0], coeffs [i1], coeffs [i2], coeffs [i3] } ;
+		const float l1 [4] = { coeffs [i0 + 1], coeffs [i1 + 1], coeffs [i2 + 1], coeffs [i3 + 1] } ;
+		float32x4_t c0 = vld1q_f32 (l0) ;
+		float32x4_t c1 = vld1q_f32 (l1) ;
+		float32x4_t fraction = vmulq_n_f32 (vcvtq_f32_s32 (vandq_s32 (vindex, mask)), INV_FRACTION) ;
+		vst1q_f32 (out + k, vmlaq_f32 (c0, fraction, vsubq_f32 (c1, c0))) ;
+		vindex = vaddq_s32 (vindex, vstep) ;
+		} ;
+
+	interpolate_scalar (coeffs, count - k, index + k * step, step, out + k) ;
+} /* interpolate_neon */
+
+static inline void
+accumulate_neon (const float *ic, const float *buffer, int channels, int count, float *sum)
+{	int k = 0 ;
+
+	switch (channels)
+	{	case 1 :
+		{	float32x4_t a = vdupq_n_f32 (0.0f) ;
+			for ( ; k + 4 <= count ; k += 4)
+				a = vmlaq_f32 (a, vld1q_f32 (ic + k), vld1q_f32 (buffer + k)) ;
+			sum [0] += vaddvq_f32 (a) ;
+			break ;
+			} ;
+
+		case 2 :
+		{	/* Duplicate each coefficient for both channels. */
+			float32x4_t a0 = vdupq_n_f32 (0.0f), a1 = vdupq_n_f32 (0.0f) ;
+			for ( ; k + 4 <= count ; k += 4)
+			{	float32x4_t q = vld1q_f32 (ic + k) ;
+				float32x4x2_t c = vzipq_f32 (q, q) ;
+				a0 = vmlaq_f32 (a0, c.val [0], vld1q_f32 (buffer + 2 * k)) ;
+				a1 = vmlaq_f32 (a1, c.val [1], vld1q_f32 (buffer + 2 * k + 4)) ;
+				} ;
+			a0 = vaddq_f32 (a0, a1) ;
+			sum [0] += vgetq_lane_f32 (a0, 0) + vgetq_lane_f32 (a0, 2) ;
+			sum [1] += vgetq_lane_f32 (a0, 1) + vgetq_lane_f32 (a0, 3) ;
+			break ;
+			} ;
+
+		case 4 :
+		{	float32x4_t a = vdupq_n_f32 (0.0f) ;
+			for ( ; k < count ; k++)
+				a = vmlaq_n_f32 (a, vld1q_f32 (buffer + 4 * k), ic [k]) ;
+			sum [0] += vgetq_lane_f32 (a, 0) ;
+			sum [1] += vgetq_lane_f32 (a, 1) ;
+			sum [2] += vgetq_lane_f32 (a, 2) ;
+			sum [3] += vgetq_lane_f32 (a, 3) ;
+			break ;
+			} ;
+
+		case 6 :
+		{	float32x4_t a4 = vdupq_n_f32 (0.0f) ;
+			float32x2_t a2 = vdup_n_f32 (0.0f) ;
+			for ( ; k < count ; k++)
+			{	a4 = vmlaq_n_f32 (a4, vld1q_f32 (buffer + 6 * k), ic [k]) ;
+				a2 = vmla_n_f32 (a2, vld1_f32 (buffer + 6 * k + 4), ic [k]) ;
+				} ;
+			sum [0] += vgetq_lane_f32 (a4, 0) ;
+			sum [1] += vgetq_lane_f32 (a4, 1) ;
+			sum [2] += vgetq_lane_f32 (a4, 2) ;
+			sum [3] += vgetq_lane_f32 (a4, 3) ;
+			sum [4] += vget_lane_f32 (a2, 0) ;
+			sum [5] += vget_lane_f32 (a2, 1) ;
+			break ;
+			} ;
+		} ;
+
+	accumulate_scalar (ic + k, buffer + k * channels, channels, count - k, sum) ;
+} /* accumulate_neon */
+
+static void
+sinc_neon (const float *coeffs, const float *buffer, int channels, int taps, int32_t index, int32_t step, double *acc)
+{	SINC_ALIGN (16) float ic [CHUNK] ;
+
+	while (taps > 0)
+	{	float sum [6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } ;
+		int count = MIN (taps, CHUNK) ;
+
+		interpolate_neon (coeffs, count, index, step, ic) ;
+		accumulate_neon (ic, buffer, channels, count, sum) ;
+		for (int ch = 0 ; ch < channels ; ch++)
+			acc [ch] += sum [ch] ;
+
+		index += count * step ;
+		buffer += count * channels ;
+		taps -= count ;
+		} ;
+} /* sinc_neon */
+#endif
+
+/*========================================================================================
+**	Dispatch
+*/
+
+static sinc_simd_fn
+sinc_simd_best (const char **name)
+{
+	if (getenv ("SRC_DISABLE_SIMD") != NULL)
+	{	*name = "scalar" ;
+		return NULL ;
+		} ;
+
+#if defined (SINC_SIMD_X86)
+	{	int sse41 = 0, avx2 = 0 ;
+		cpu_features (&sse41, &avx2) ;
+		if (avx2)
+		{	*name = "AVX2" ;
+			return sinc_avx2 ;
+			} ;
+		if (sse41)
+		{	*name = "SSE4.1" ;
+			return sinc_sse41 ;
+			} ;
+		} ;
+#elif defined (SINC_SIMD_NEON)
+	*name = "NEON" ;
+	return sinc_neon ;
+#endif
+
+	*name = "scalar" ;
+	return NULL ;
+} /* sinc_simd_best */
+
+sinc_simd_fn
+sinc_simd_select (int channels)
+{	const char *name ;
+
+	switch (channels)
+	{	case 1 :
+		case 2 :
+		case 4 :
+		case 6 :
+			return sinc_simd_best (&name) ;
+
+		default :
+			return NULL ;
+		} ;
+} /* sinc_simd_select */
+
+const char *
+sinc_simd_name (void)
+{	const char *name ;
+
+	sinc_simd_best (&name) ;
+	return name ;
+} /* sinc_simd_name */
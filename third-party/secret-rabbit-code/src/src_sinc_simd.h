@@ -0,0 +1,43 @@
+/*
+** Copyright (c) 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+** All rights reserved.
+**
+** This code is released under 2-clause BSD license. Please see the
+** file at : https://github.com/libsndfile/libsamplerate/blob/master/COPYING
+*/
+
+#ifndef SRC_SINC_SIMD_H_INCLUDED
+#define SRC_SINC_SIMD_H_INCLUDED
+
+#include <stdint.h>
+
+#include "common.h"
+
+/* Must match SHIFT_BITS in src_sinc.c. */
+#define	SINC_SIMD_SHIFT_BITS	12
+
+/*
+** Apply a run of interpolated filter taps to interleaved data.
+**
+** For k in [0, taps):
+**     index = filter_index + k * step
+**     coeff = coeffs [index >> 12] + fraction (index) * (coeffs [(index >> 12) + 1] - coeffs [index >> 12])
+**     acc [ch] += coeff * buffer [k * channels + ch]
+**
+** All indices must be non-negative. Taps are processed in chunks of 64, with
+** single precision inside a chunk and double precision across chunks. The
+** result differs from the double precision scalar loop by at most
+** 2^-17 * sum (|coeff * buffer|) per channel.
+*/
+typedef void (*sinc_simd_fn) (const float *coeffs, const float *buffer, int channels, int taps, int32_t filter_index, int32_t step, double *acc) ;
+
+/*
+** Pick the best kernel for the CPU and channel count, or NULL if the scalar
+** code should be used. Setting the environment variable SRC_DISABLE_SIMD
+** forces the scalar code.
+*/
+LIBSAMPLERATE_DLL_PRIVATE sinc_simd_fn sinc_simd_select (int channels) ;
+
+LIBSAMPLERATE_DLL_PRIVATE const char * sinc_simd_name (void) ;
+
+#endif /* SRC_SINC_SIMD_H_INCLUDED */
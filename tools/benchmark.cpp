@@ -0,0 +1,730 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for the parts of the processing chain that are not resamplers.
+//
+// Every section can be run on its own with --section, which may be given more than once. Without it all of them run:
+// - conversion: The 64-bit sample conversion kernels against their scalar versions.
+// - kernels: The remaining SIMD kernels against their scalar versions.
+// - scheduling: The wake-up latency each scheduling policy achieves.
+// - secret_rabbit_code: The vectorized sinc kernels against the scalar loops.
+// - interleave: One interleaved secret-rabbit-code state against one state per channel, and the kernels that feed it.
+// - polyphase: The fixed-ratio polyphase engine against secret-rabbit-code, and the kernel it is built on.
+// - plans: The cost of resampler plans once they are cached, and of a whole reconfiguration of the processor.
+//
+// Results are written as JSON, like the resampler lab, timing is the fastest of several passes. Real-time scheduling
+// usually needs CAP_SYS_NICE, RLIMIT_RTPRIO or RealtimeKit, the policy that was actually achieved is part of the
+// results. Run it with VOICEFX_RESAMPLER_POLYPHASE=0 to see the plan cost of every tier on secret-rabbit-code.
+//
+// Usage: benchmark [--quick] [--section <name>]... [--output <file>]
+
+#include "lib.hpp"
+#include "resampler-polyphase.hpp"
+#include "resampler.hpp"
+#include "util-reaper.hpp"
+#include "util-simd.hpp"
+#include "util-thread.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <samplerate.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "warning-enable.hpp"
+
+std::shared_ptr<tonplugins::core> voicefx::core;
+
+static constexpr size_t block = 480;
+
+static void write_number(FILE* file, const char* name, double value, const char* suffix = ", ")
+{
+	// JSON has no representation for NaN or infinity.
+	if (std::isfinite(value)) {
+		fprintf(file, "\"%s\": %.4f%s", name, value, suffix);
+	} else {
+		fprintf(file, "\"%s\": null%s", name, suffix);
+	}
+}
+
+static void set_environment(const char* name, const char* value)
+{
+#ifdef WIN32
+	_putenv_s(name, value ? value : "");
+#else
+	if (value) {
+		setenv(name, value, 1);
+	} else {
+		unsetenv(name);
+	}
+#endif
+}
+
+// Nanoseconds per call, the fastest of several passes after one to warm up.
+template<typename T>
+static double measure(T&& fn, size_t iterations)
+{
+	double best = std::numeric_limits<double>::max();
+	for (size_t pass = 0; pass < 4; pass++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t idx = 0; idx < iterations; idx++) {
+			fn();
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(std::chrono::high_resolution_clock::now() - start);
+		if (pass > 0) {
+			best = std::min(best, elapsed.count() / static_cast<double>(iterations));
+		}
+	}
+	return best;
+}
+
+static std::vector<float> noise(size_t samples, uint32_t seed)
+{
+	// A fixed generator, so that every run converts the same signal.
+	std::vector<float> result(samples);
+	for (size_t idx = 0; idx < samples; idx++) {
+		seed        = seed * 1664525u + 1013904223u;
+		result[idx] = static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f;
+	}
+	return result;
+}
+
+//--------------------------------------------------------------------------------
+// SIMD Kernels
+//--------------------------------------------------------------------------------
+
+struct kernel_t {
+	std::string           name;
+	size_t                samples; // Samples per call, across all channels.
+	std::function<void()> run;
+};
+
+static void measure_kernels(FILE* file, bool quick, std::vector<kernel_t> const& kernels)
+{
+	size_t iterations = quick ? 2000 : 20000;
+	auto   best       = voicefx::simd::detect();
+	bool   first      = true;
+	for (auto& kernel : kernels) {
+		fprintf(stderr, "kernels: %s...\n", kernel.name.c_str());
+		fprintf(file, "%s\n\t\t{\"kernel\": \"%s\", \"samples\": %zu, ", first ? "" : ",", kernel.name.c_str(), kernel.samples);
+		double scalar = 0.;
+		for (auto set : {voicefx::simd::instruction_set::NONE, voicefx::simd::instruction_set::SSE2, voicefx::simd::instruction_set::AVX2}) {
+			if (set > best) {
+				break;
+			}
+			voicefx::simd::select(set);
+			double ns = measure(kernel.run, iterations) / static_cast<double>(kernel.samples);
+			if (set == voicefx::simd::instruction_set::NONE) {
+				scalar = ns;
+			}
+			fprintf(file, "\"%s\": {", voicefx::simd::name(set));
+			write_number(file, "ns_per_sample", ns);
+			write_number(file, "speedup", scalar / ns, "}, ");
+		}
+		fprintf(file, "\"best\": \"%s\"}", voicefx::simd::name(best));
+		first = false;
+		fflush(file);
+	}
+	voicefx::simd::select(best);
+}
+
+static void benchmark_conversion(FILE* file, bool quick)
+{
+	std::vector<float>  a = noise(block, 1);
+	std::vector<float>  b = noise(block, 2);
+	std::vector<float>  f(block);
+	std::vector<double> d(block, 0.25);
+
+	// Everything that touches the host buffers when it processes 64-bit samples.
+	measure_kernels(file, quick,
+					{
+						{"convert_double_to_float", block, [&]() { voicefx::simd::convert(d.data(), f.data(), block); }},
+						{"convert_float_to_double", block, [&]() { voicefx::simd::convert(a.data(), d.data(), block); }},
+						{"mix_double", block, [&]() { voicefx::simd::mix(a.data(), b.data(), d.data(), block, 0.5f, 1e-4f, 0.5f, -1e-4f); }},
+					});
+}
+
+static void benchmark_kernels(FILE* file, bool quick)
+{
+	std::vector<float> a = noise(block, 1);
+	std::vector<float> b = noise(block, 2);
+	std::vector<float> f(block * 4);
+
+	std::vector<kernel_t> kernels = {
+		{"mix", block, [&]() { voicefx::simd::mix(a.data(), b.data(), f.data(), block, 0.5f, 1e-4f, 0.5f, -1e-4f); }},
+		{"multiply", block, [&]() { voicefx::simd::multiply(a.data(), b.data(), f.data(), block); }},
+		{"butterfly", block, [&]() { voicefx::simd::butterfly(f.data(), f.data() + block, f.data() + block * 2, f.data() + block * 3, a.data(), b.data(), block); }},
+	};
+	measure_kernels(file, quick, kernels);
+}
+
+//--------------------------------------------------------------------------------
+// Scheduling
+//--------------------------------------------------------------------------------
+
+struct scheduling_t {
+	std::string achieved;
+	double      sleep_late;   // Average lateness of 1 ms sleeps, in nanoseconds.
+	double      wake_average; // Signal to wake-up through a condition variable, like the processor's worker.
+	double      wake_p99;
+	double      wake_maximum;
+};
+
+// What the calling thread ended up with, including anything RealtimeKit or a nice value granted after the fact.
+static std::string scheduling_in_effect(std::string achieved)
+{
+#ifndef WIN32
+	int         policy = 0;
+	sched_param param  = {};
+	if (pthread_getschedparam(pthread_self(), &policy, &param) == 0) {
+#ifdef __linux__
+		policy &= ~SCHED_RESET_ON_FORK;
+#endif
+		if (policy == SCHED_FIFO) {
+			return std::string(voicefx::thread::name(voicefx::thread::scheduler::FIFO)) + " " + std::to_string(param.sched_priority);
+		} else if (policy == SCHED_RR) {
+			return std::string(voicefx::thread::name(voicefx::thread::scheduler::ROUND_ROBIN)) + " " + std::to_string(param.sched_priority);
+		}
+	}
+#ifdef __linux__
+	errno    = 0;
+	int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+	if ((errno == 0) && (nice < 0)) {
+		return "Nice " + std::to_string(nice);
+	}
+#endif
+	return "Normal";
+#else
+	return achieved;
+#endif
+}
+
+static scheduling_t measure_scheduling(voicefx::thread::scheduler scheduler, size_t wakeups)
+{
+	scheduling_t result;
+
+	std::mutex                                     lock;
+	std::condition_variable                        cv;
+	bool                                           signal = false;
+	bool                                           ready  = false;
+	std::chrono::high_resolution_clock::time_point signal_time;
+	std::vector<double>                            latencies;
+	latencies.reserve(wakeups);
+
+	std::thread worker([&]() {
+		voicefx::thread::policy p;
+		p.scheduler      = scheduler;
+		p.isolate        = false;
+		std::string got  = voicefx::thread::apply_scheduler(p);
+		// Wait for RealtimeKit or the nice fallback, which run on the reaper thread, so the thread is measured with
+		// whatever it really got.
+		voicefx::reaper::drain();
+		got              = scheduling_in_effect(got);
+		double      late = static_cast<double>(voicefx::thread::measure_wakeup_latency(100).count());
+
+		std::unique_lock<std::mutex> ul(lock);
+		result.achieved   = got;
+		result.sleep_late = late;
+		ready             = true;
+		cv.notify_all();
+		while (latencies.size() < wakeups) {
+			cv.wait(ul, [&] { return signal; });
+			latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - signal_time).count());
+			signal = false;
+		}
+	});
+
+	{
+		std::unique_lock<std::mutex> ul(lock);
+		cv.wait(ul, [&] { return ready; });
+	}
+
+	// Signal at roughly the rate of 1 ms host blocks, so that the worker really sleeps in between.
+	for (size_t idx = 0; idx < wakeups; idx++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::unique_lock<std::mutex> ul(lock);
+		signal      = true;
+		signal_time = std::chrono::high_resolution_clock::now();
+		cv.notify_all();
+	}
+	worker.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0.;
+	for (double v : latencies) {
+		sum += v;
+	}
+	result.wake_average = sum / static_cast<double>(latencies.size());
+	result.wake_p99     = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+	result.wake_maximum = latencies.back();
+	return result;
+}
+
+static void benchmark_scheduling(FILE* file, bool quick)
+{
+	bool first = true;
+	for (auto scheduler : {voicefx::thread::scheduler::NORMAL, voicefx::thread::scheduler::ROUND_ROBIN, voicefx::thread::scheduler::FIFO}) {
+		fprintf(stderr, "scheduling: %s...\n", voicefx::thread::name(scheduler));
+		scheduling_t result = measure_scheduling(scheduler, quick ? 500 : 5000);
+		fprintf(file, "%s\n\t\t{\"requested\": \"%s\", \"achieved\": \"%s\", ", first ? "" : ",", voicefx::thread::name(scheduler), result.achieved.c_str());
+		write_number(file, "sleep_late_ns", result.sleep_late);
+		write_number(file, "wake_average_ns", result.wake_average);
+		write_number(file, "wake_p99_ns", result.wake_p99);
+		write_number(file, "wake_maximum_ns", result.wake_maximum, "}");
+		first = false;
+		fflush(file);
+	}
+}
+
+//--------------------------------------------------------------------------------
+// secret-rabbit-code
+//--------------------------------------------------------------------------------
+
+static std::shared_ptr<SRC_STATE> create_src(int converter, size_t channels, bool simd)
+{
+	// The sinc kernel is picked when the state is created, so the switch only has to be in place for that.
+	set_environment("SRC_DISABLE_SIMD", simd ? nullptr : "1");
+	int        error = 0;
+	SRC_STATE* state = src_new(converter, static_cast<int>(channels), &error);
+	set_environment("SRC_DISABLE_SIMD", nullptr);
+	if (!state) {
+		throw std::runtime_error(src_strerror(error));
+	}
+	return std::shared_ptr<SRC_STATE>(state, [](SRC_STATE* v) { src_delete(v); });
+}
+
+// Converts interleaved input in blocks, returning the interleaved output.
+static std::vector<float> run_src(SRC_STATE* state, std::vector<float> const& input, size_t channels, double ratio)
+{
+	size_t             frames = input.size() / channels;
+	std::vector<float> output(static_cast<size_t>(std::ceil(static_cast<double>(frames) * ratio) + 64) * channels);
+	size_t             used = 0;
+	size_t             gen  = 0;
+	src_reset(state);
+	while (used < frames) {
+		SRC_DATA data      = {};
+		data.data_in       = input.data() + used * channels;
+		data.data_out      = output.data() + gen * channels;
+		data.input_frames  = static_cast<long>(std::min(block, frames - used));
+		data.output_frames = static_cast<long>(output.size() / channels - gen);
+		data.src_ratio     = ratio;
+		if (int error = src_process(state, &data); error != 0) {
+			throw std::runtime_error(src_strerror(error));
+		}
+		used += static_cast<size_t>(data.input_frames_used);
+		gen += static_cast<size_t>(data.output_frames_gen);
+		if ((data.input_frames_used == 0) && (data.output_frames_gen == 0)) {
+			break;
+		}
+	}
+	output.resize(gen * channels);
+	return output;
+}
+
+static void benchmark_src(FILE* file, bool quick)
+{
+	constexpr uint32_t in    = 44100;
+	constexpr uint32_t out   = 48000;
+	constexpr double   ratio = static_cast<double>(out) / static_cast<double>(in);
+
+	struct converter_t {
+		const char* name;
+		int         converter;
+	};
+	const converter_t converters[] = {{"Fastest", SRC_SINC_FASTEST}, {"Medium", SRC_SINC_MEDIUM_QUALITY}, {"Best", SRC_SINC_BEST_QUALITY}};
+
+	// Three channels have no vectorized kernel, and show what the scalar fallback costs.
+	size_t frames = quick ? in / 2 : in * 2;
+	bool   first  = true;
+	for (auto const& conv : converters) {
+		for (size_t channels : {1, 2, 3, 4, 6}) {
+			fprintf(stderr, "secret-rabbit-code: %s, %zu channels...\n", conv.name, channels);
+			try {
+				auto input = noise(frames * channels, 3);
+
+				// The vectorized kernels against the scalar loops, on one interleaved state.
+				auto   scalar_state = create_src(conv.converter, channels, false);
+				auto   simd_state   = create_src(conv.converter, channels, true);
+				double scalar       = measure([&]() { run_src(scalar_state.get(), input, channels, ratio); }, 1);
+				double simd         = measure([&]() { run_src(simd_state.get(), input, channels, ratio); }, 1);
+
+				// Both have to agree to within the error bound documented in src_sinc_simd.h.
+				auto   scalar_output = run_src(scalar_state.get(), input, channels, ratio);
+				auto   simd_output   = run_src(simd_state.get(), input, channels, ratio);
+				double difference    = 0.;
+				for (size_t idx = 0; idx < std::min(scalar_output.size(), simd_output.size()); idx++) {
+					difference = std::max(difference, static_cast<double>(std::abs(scalar_output[idx] - simd_output[idx])));
+				}
+
+				double samples = static_cast<double>(frames * channels);
+				fprintf(file, "%s\n\t\t{\"converter\": \"%s\", \"channels\": %zu, \"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", ", first ? "" : ",", conv.name, channels, in, out);
+				write_number(file, "scalar_ns_per_sample", scalar / samples);
+				write_number(file, "simd_ns_per_sample", simd / samples);
+				write_number(file, "simd_speedup", scalar / simd);
+				fprintf(file, "\"max_difference\": %.3e}", difference);
+				first = false;
+			} catch (std::exception const& ex) {
+				fprintf(stderr, "  skipped: %s\n", ex.what());
+			}
+			fflush(file);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Interleaved secret-rabbit-code States
+//--------------------------------------------------------------------------------
+
+static void benchmark_interleave(FILE* file, bool quick)
+{
+	{ // The kernels that move planar host data in and out of an interleaved state.
+		std::vector<float>              a = noise(block * 6, 1);
+		std::vector<float>              f(block * 6);
+		std::vector<std::vector<float>> planes(6, std::vector<float>(block));
+		std::vector<const float*>       ins;
+		std::vector<float*>             outs;
+		for (auto& plane : planes) {
+			ins.push_back(plane.data());
+			outs.push_back(plane.data());
+		}
+
+		std::vector<kernel_t> kernels;
+		for (size_t channels : {2, 4, 6}) {
+			kernels.push_back({"interleave_" + std::to_string(channels), block * channels, [&, channels]() { voicefx::simd::interleave(ins.data(), f.data(), channels, block); }});
+			kernels.push_back({"deinterleave_" + std::to_string(channels), block * channels, [&, channels]() { voicefx::simd::deinterleave(a.data(), outs.data(), channels, block); }});
+		}
+		measure_kernels(file, quick, kernels);
+	}
+
+	// One multichannel state fed through the interleave kernels, against one mono state per channel, which is how the
+	// resampler used to do it.
+	constexpr uint32_t in    = 48000;
+	constexpr uint32_t out   = 44100;
+	constexpr double   ratio = static_cast<double>(out) / static_cast<double>(in);
+
+	struct converter_t {
+		const char* name;
+		int         converter;
+	};
+	const converter_t converters[] = {{"Fastest", SRC_SINC_FASTEST}, {"Medium", SRC_SINC_MEDIUM_QUALITY}, {"Best", SRC_SINC_BEST_QUALITY}};
+
+	size_t frames = quick ? in : in * 4;
+	for (auto const& conv : converters) {
+		for (size_t channels : {2, 4, 6}) {
+			fprintf(stderr, "interleave: %s, %zu channels...\n", conv.name, channels);
+			try {
+				std::vector<std::vector<float>> planar(channels);
+				std::vector<const float*>       planar_in;
+				for (size_t ch = 0; ch < channels; ch++) {
+					planar[ch] = noise(frames, static_cast<uint32_t>(3 + ch));
+					planar_in.push_back(planar[ch].data());
+				}
+
+				auto               interleaved_state = create_src(conv.converter, channels, true);
+				std::vector<float> interleaved(frames * channels);
+				double             combined = measure(
+					[&]() {
+						voicefx::simd::interleave(planar_in.data(), interleaved.data(), channels, frames);
+						auto                output = run_src(interleaved_state.get(), interleaved, channels, ratio);
+						size_t              gen    = output.size() / channels;
+						std::vector<float*> planar_out;
+						std::vector<std::vector<float>> result(channels, std::vector<float>(gen));
+						for (auto& plane : result) {
+							planar_out.push_back(plane.data());
+						}
+						voicefx::simd::deinterleave(output.data(), planar_out.data(), channels, gen);
+					},
+					1);
+
+				std::vector<std::shared_ptr<SRC_STATE>> mono_states;
+				for (size_t ch = 0; ch < channels; ch++) {
+					mono_states.push_back(create_src(conv.converter, 1, true));
+				}
+				double separate = measure(
+					[&]() {
+						for (size_t ch = 0; ch < channels; ch++) {
+							run_src(mono_states[ch].get(), planar[ch], 1, ratio);
+						}
+					},
+					1);
+
+				double samples = static_cast<double>(frames * channels);
+				fprintf(file, ",\n\t\t{\"converter\": \"%s\", \"channels\": %zu, \"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", ", conv.name, channels, in, out);
+				write_number(file, "per_channel_states_ns_per_sample", separate / samples);
+				write_number(file, "interleaved_ns_per_sample", combined / samples);
+				write_number(file, "interleaved_speedup", separate / combined, "}");
+			} catch (std::exception const& ex) {
+				fprintf(stderr, "  skipped: %s\n", ex.what());
+			}
+			fflush(file);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Polyphase Engine
+//--------------------------------------------------------------------------------
+
+static void benchmark_polyphase(FILE* file, bool quick)
+{
+	{ // Every output sample of the engine is one of these.
+		std::vector<float> a = noise(block, 1);
+		std::vector<float> b = noise(block, 2);
+		float              f = 0.f;
+		measure_kernels(file, quick, {{"dot", block, [&]() { f = voicefx::simd::dot(a.data(), b.data(), block); }}});
+	}
+
+	// The engine against the vectorized secret-rabbit-code state that handled these conversions before it.
+	struct pair_t {
+		uint32_t in;
+		uint32_t out;
+	};
+	const pair_t pairs[] = {{44100, 48000}, {48000, 44100}, {96000, 48000}, {88200, 48000}};
+
+	struct tier_t {
+		voicefx::resampler_quality quality;
+		int                        converter;
+	};
+	const tier_t tiers[] = {{voicefx::resampler_quality::FASTEST, SRC_SINC_FASTEST}, {voicefx::resampler_quality::MEDIUM, SRC_SINC_MEDIUM_QUALITY}, {voicefx::resampler_quality::BEST, SRC_SINC_BEST_QUALITY}};
+
+	for (auto const& pair : pairs) {
+		for (auto const& tier : tiers) {
+			for (size_t channels : {1, 2}) {
+				fprintf(stderr, "polyphase: %" PRIu32 " Hz -> %" PRIu32 " Hz, %s, %zu channels...\n", pair.in, pair.out, voicefx::resampler::quality_name(tier.quality), channels);
+				size_t frames  = quick ? pair.in / 2 : pair.in * 2;
+				double ratio   = static_cast<double>(pair.out) / static_cast<double>(pair.in);
+				double samples = static_cast<double>(frames * channels);
+
+				std::vector<std::vector<float>> planar(channels);
+				std::vector<const float*>       planar_in(channels);
+				for (size_t ch = 0; ch < channels; ch++) {
+					planar[ch]    = noise(frames, static_cast<uint32_t>(5 + ch));
+					planar_in[ch] = planar[ch].data();
+				}
+
+				auto                            table = voicefx::polyphase::get_table(pair.in, pair.out, tier.quality);
+				voicefx::polyphase::engine      engine(table, channels, block);
+				size_t                          capacity = static_cast<size_t>(std::ceil(static_cast<double>(block) * ratio)) + 1;
+				std::vector<std::vector<float>> planar_out(channels, std::vector<float>(capacity));
+				double                          polyphase = measure(
+					[&]() {
+						engine.clear();
+						std::vector<const float*> ins(channels);
+						std::vector<float*>       outs(channels);
+						for (size_t used = 0; used < frames;) {
+							for (size_t ch = 0; ch < channels; ch++) {
+								ins[ch]  = planar_in[ch] + used;
+								outs[ch] = planar_out[ch].data();
+							}
+							size_t in_used = 0;
+							size_t gen     = 0;
+							engine.process(ins.data(), std::min(block, frames - used), in_used, outs.data(), capacity, gen);
+							used += in_used;
+						}
+					},
+					1);
+
+				fprintf(file, ",\n\t\t{\"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"channels\": %zu, \"taps\": %zu, ", pair.in, pair.out, voicefx::resampler::quality_name(tier.quality), channels, table->taps);
+				write_number(file, "polyphase_ns_per_sample", polyphase / samples);
+				try {
+					std::vector<float> interleaved(frames * channels);
+					voicefx::simd::interleave(planar_in.data(), interleaved.data(), channels, frames);
+					auto   state = create_src(tier.converter, channels, true);
+					double src   = measure([&]() { run_src(state.get(), interleaved, channels, ratio); }, 1);
+					write_number(file, "secret_rabbit_code_ns_per_sample", src / samples);
+					write_number(file, "speedup", src / polyphase, "}");
+				} catch (std::exception const& ex) {
+					// Converters can be compiled out of secret-rabbit-code.
+					fprintf(stderr, "  secret-rabbit-code skipped: %s\n", ex.what());
+					fprintf(file, "\"secret_rabbit_code_ns_per_sample\": null, \"speedup\": null}");
+				}
+				fflush(file);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Resampler Plans
+//--------------------------------------------------------------------------------
+
+static void benchmark_plans(FILE* file, bool quick)
+{
+	struct pair_t {
+		uint32_t in;
+		uint32_t out;
+	};
+	const pair_t pairs[] = {{44100, 48000}, {48000, 44100}, {96000, 48000}, {22050, 48000}};
+
+	bool first = true;
+	for (auto const& pair : pairs) {
+		for (auto quality : {voicefx::resampler_quality::LINEAR, voicefx::resampler_quality::FASTEST, voicefx::resampler_quality::MEDIUM, voicefx::resampler_quality::BEST}) {
+			fprintf(stderr, "plans: %" PRIu32 " Hz -> %" PRIu32 " Hz, %s...\n", pair.in, pair.out, voicefx::resampler::quality_name(quality));
+			try {
+				// Nothing else in this process asks for these plans, so the first one pays for designing the filters or
+				// measuring the latency, which is what every configuration change used to cost.
+				auto start = std::chrono::high_resolution_clock::now();
+				auto plan  = voicefx::resampler::get_plan(pair.in, pair.out, quality, 2);
+				auto cold  = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+				double warm = measure([&]() { voicefx::resampler::get_plan(pair.in, pair.out, quality, 2); }, quick ? 1000 : 10000);
+
+				// A new instance on a cached plan, as created by every reset() of the processor.
+				double instance = measure(
+					[&]() {
+						voicefx::resampler r;
+						r.channels(2);
+						r.quality(quality);
+						r.ratio(pair.in, pair.out);
+						r.reserve(block, plan->max_output(block));
+						r.load();
+					},
+					quick ? 20 : 200);
+
+				const char* engine = plan->cascade ? "halfband" : (plan->table ? "polyphase" : "secret-rabbit-code");
+				fprintf(file, "%s\n\t\t{\"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"engine\": \"%s\", ", first ? "" : ",", pair.in, pair.out, voicefx::resampler::quality_name(quality), engine);
+				write_number(file, "first_plan_us", cold / 1000.);
+				write_number(file, "cached_plan_us", warm / 1000.);
+				write_number(file, "instance_us", instance / 1000., "}");
+				first = false;
+			} catch (std::exception const& ex) {
+				fprintf(stderr, "  skipped: %s\n", ex.what());
+			}
+			fflush(file);
+		}
+	}
+
+	// Everything the processor does when the configuration changes once all plans exist: both delays, and a new
+	// resampler for each direction. The first pass creates the plans for the way back.
+	for (auto const& pair : pairs) {
+		for (auto quality : {voicefx::resampler_quality::LINEAR, voicefx::resampler_quality::FASTEST, voicefx::resampler_quality::MEDIUM, voicefx::resampler_quality::BEST}) {
+			fprintf(stderr, "plans: reconfiguring %" PRIu32 " Hz <-> %" PRIu32 " Hz, %s...\n", pair.in, pair.out, voicefx::resampler::quality_name(quality));
+			try {
+				double reconfiguration = measure(
+					[&]() {
+						voicefx::resampler::calculate_delay(pair.in, pair.out, quality);
+						voicefx::resampler::calculate_delay(pair.out, pair.in, quality);
+						for (auto const& direction : {pair, pair_t{pair.out, pair.in}}) {
+							voicefx::resampler r;
+							r.channels(2);
+							r.quality(quality);
+							r.ratio(direction.in, direction.out);
+							r.reserve(block, voicefx::resampler::get_plan(direction.in, direction.out, quality, 2)->max_output(block));
+							r.load();
+						}
+					},
+					quick ? 20 : 200);
+
+				fprintf(file, "%s\n\t\t{\"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", ", first ? "" : ",", pair.in, pair.out, voicefx::resampler::quality_name(quality));
+				write_number(file, "reconfiguration_us", reconfiguration / 1000., "}");
+				first = false;
+			} catch (std::exception const& ex) {
+				fprintf(stderr, "  skipped: %s\n", ex.what());
+			}
+			fflush(file);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Sections
+//--------------------------------------------------------------------------------
+
+struct section_t {
+	const char* name;
+	void (*run)(FILE* file, bool quick);
+};
+
+static const section_t sections[] = {
+	{"conversion", benchmark_conversion}, {"kernels", benchmark_kernels}, {"scheduling", benchmark_scheduling}, {"secret_rabbit_code", benchmark_src}, {"interleave", benchmark_interleave}, {"polyphase", benchmark_polyphase}, {"plans", benchmark_plans},
+};
+
+int main(int argc, const char* argv[])
+{
+	bool                          quick = false;
+	const char*                   path  = nullptr;
+	std::vector<const section_t*> selected;
+	for (int idx = 1; idx < argc; idx++) {
+		if (strcmp(argv[idx], "--quick") == 0) {
+			quick = true;
+		} else if ((strcmp(argv[idx], "--output") == 0) && ((idx + 1) < argc)) {
+			path = argv[++idx];
+		} else if ((strcmp(argv[idx], "--section") == 0) && ((idx + 1) < argc)) {
+			const char* name    = argv[++idx];
+			auto        section = std::find_if(std::begin(sections), std::end(sections), [name](section_t const& v) { return strcmp(v.name, name) == 0; });
+			if (section == std::end(sections)) {
+				fprintf(stderr, "Unknown section '%s'.\n", name);
+				return 1;
+			}
+			selected.push_back(&*section);
+		} else {
+			fprintf(stderr, "Usage: %s [--quick] [--section <name>]... [--output <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (selected.empty()) {
+		for (auto const& section : sections) {
+			selected.push_back(&section);
+		}
+	}
+
+	voicefx::core = tonplugins::core::instance(std::string{voicefx::product_name});
+
+	FILE* file = path ? fopen(path, "wb") : stdout;
+	if (!file) {
+		fprintf(stderr, "Failed to open '%s' for writing.\n", path);
+		return 1;
+	}
+
+	fprintf(file, "{\n\t\"format\": 1,\n\t\"instruction_set\": \"%s\"", voicefx::simd::name(voicefx::simd::detect()));
+	for (auto section : selected) {
+		fprintf(file, ",\n\t\"%s\": [", section->name);
+		section->run(file, quick);
+		fprintf(file, "\n\t]");
+	}
+	fprintf(file, "\n}\n");
+
+	if (path) {
+		fclose(file);
+	}
+	return 0;
+}
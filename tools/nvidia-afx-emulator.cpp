@@ -0,0 +1,702 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// NVIDIA Audio Effects emulator.
+//
+// A stand-in for the NVIDIA Audio Effects library that implements the same C interface without a GPU, so that the
+// host-facing pipeline can be benchmarked and tested on any build machine. It reports the frame sizes and sample rates
+// of the real effects, takes as long as it is told to, optionally applies a deterministic filter, and counts every
+// call. Place it where the plug-in looks for the real library, for example by pointing NVAFX_SDK_DIR at it.
+//
+// Configuration is read from the environment once, when the library is loaded:
+//   VOICEFX_EMULATOR_CREATE_LATENCY  Milliseconds spent in NvAFX_CreateEffect. Default 0.
+//   VOICEFX_EMULATOR_LOAD_LATENCY    Milliseconds spent in NvAFX_Load. Default 0.
+//   VOICEFX_EMULATOR_DESTROY_LATENCY Milliseconds spent in NvAFX_DestroyEffect. Default 0.
+//   VOICEFX_EMULATOR_RUN_LATENCY     Microseconds spent in NvAFX_Run. Default 0.
+//   VOICEFX_EMULATOR_RUN_JITTER      Up to this many microseconds are added to every NvAFX_Run. Default 0.
+//   VOICEFX_EMULATOR_WARMUP_RUNS     The first this many NvAFX_Run after every NvAFX_Load are slow. Default 0.
+//   VOICEFX_EMULATOR_WARMUP_LATENCY  Microseconds added to each of those slow calls. Default 0.
+//   VOICEFX_EMULATOR_GRAPH_LATENCY   Microseconds added to every NvAFX_Run while CUDA graphs are enabled, which may be
+//                                    negative to make them faster instead. Default 0.
+//   VOICEFX_EMULATOR_SEED            Seed of the jitter, which is drawn per effect in order of creation. Default 0.
+//   VOICEFX_EMULATOR_FILTER          "copy" to pass audio through unchanged, or "lowpass" to blend in a one-pole low
+//                                    pass at 4 kHz by the intensity ratio. Default "copy".
+//   VOICEFX_EMULATOR_DEVICES         Number of devices reported by NvAFX_GetSupportedDevices. Default 1.
+//   VOICEFX_EMULATOR_CHECK_MODEL     Fail NvAFX_Load like the real library if the model file does not exist.
+//   VOICEFX_EMULATOR_FAIL            Comma separated entry points, without the NvAFX_ prefix, that always fail.
+//   VOICEFX_EMULATOR_REPORT          File that receives the call counts as JSON when the library is unloaded, or "-"
+//                                    for the standard error output.
+//
+// Call counts are also available at runtime through two additional exports:
+//   uint64_t NvAFXEmulator_GetCallCount(const char* entry_point);
+//   void     NvAFXEmulator_ResetCallCounts();
+
+#include "util-environment.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <nvAudioEffects.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "warning-enable.hpp"
+
+#ifdef WIN32
+#define EMULATOR_API __declspec(dllexport)
+#else
+#define EMULATOR_API __attribute__((visibility("default")))
+#endif
+
+extern "C" {
+EMULATOR_API uint64_t NvAFXEmulator_GetCallCount(const char* entry_point);
+EMULATOR_API void     NvAFXEmulator_ResetCallCounts();
+}
+
+static constexpr double pi = 3.14159265358979323846;
+
+//--------------------------------------------------------------------------------
+// Configuration and statistics
+//--------------------------------------------------------------------------------
+
+enum class entry_point : size_t {
+	GetEffectList,
+	CreateEffect,
+	CreateChainedEffect,
+	DestroyEffect,
+	SetU32,
+	SetU32List,
+	SetString,
+	SetStringList,
+	SetFloat,
+	SetFloatList,
+	GetU32,
+	GetString,
+	GetStringList,
+	GetFloat,
+	GetFloatList,
+	Load,
+	GetSupportedDevices,
+	Run,
+	Reset,
+	_COUNT,
+};
+
+static const char* entry_point_names[] = {
+	"GetEffectList", "CreateEffect", "CreateChainedEffect", "DestroyEffect", "SetU32", "SetU32List", "SetString", "SetStringList", "SetFloat", "SetFloatList", "GetU32", "GetString", "GetStringList", "GetFloat", "GetFloatList", "Load", "GetSupportedDevices", "Run", "Reset",
+};
+static_assert((sizeof(entry_point_names) / sizeof(const char*)) == static_cast<size_t>(entry_point::_COUNT));
+
+struct emulator {
+	std::chrono::microseconds create_latency;
+	std::chrono::microseconds load_latency;
+	std::chrono::microseconds destroy_latency;
+	std::chrono::microseconds run_latency;
+	std::chrono::microseconds run_jitter;
+	uint64_t                  warmup_runs;
+	std::chrono::microseconds warmup_latency;
+	std::chrono::microseconds graph_latency;
+	uint32_t                  seed;
+	bool                      lowpass;
+	int32_t                   devices;
+	bool                      check_model;
+	std::string               report;
+
+	std::array<bool, static_cast<size_t>(entry_point::_COUNT)>                  fail;
+	std::array<std::atomic<uint64_t>, static_cast<size_t>(entry_point::_COUNT)> calls;
+
+	std::atomic<uint64_t> created;      // Effects created so far, which also selects the jitter of the next one.
+	std::atomic<uint64_t> run_total_ns; // Wall time spent in NvAFX_Run.
+	std::atomic<uint64_t> run_max_ns;
+
+	emulator() : fail(), calls(), created(0), run_total_ns(0), run_max_ns(0)
+	{
+		namespace env  = ::voicefx::environment;
+		create_latency  = std::chrono::milliseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_CREATE_LATENCY", 0), 0));
+		load_latency    = std::chrono::milliseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_LOAD_LATENCY", 0), 0));
+		destroy_latency = std::chrono::milliseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_DESTROY_LATENCY", 0), 0));
+		run_latency     = std::chrono::microseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_RUN_LATENCY", 0), 0));
+		run_jitter      = std::chrono::microseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_RUN_JITTER", 0), 0));
+		warmup_runs     = static_cast<uint64_t>(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_WARMUP_RUNS", 0), 0));
+		warmup_latency  = std::chrono::microseconds(std::max<int64_t>(env::get_integer("VOICEFX_EMULATOR_WARMUP_LATENCY", 0), 0));
+		graph_latency   = std::chrono::microseconds(env::get_integer("VOICEFX_EMULATOR_GRAPH_LATENCY", 0));
+		seed            = static_cast<uint32_t>(env::get_integer("VOICEFX_EMULATOR_SEED", 0));
+		lowpass         = (env::get("VOICEFX_EMULATOR_FILTER").value_or("copy") == "lowpass");
+		devices         = static_cast<int32_t>(std::clamp<int64_t>(env::get_integer("VOICEFX_EMULATOR_DEVICES", 1), 0, 64));
+		check_model     = env::get_bool("VOICEFX_EMULATOR_CHECK_MODEL", false);
+		report          = env::get("VOICEFX_EMULATOR_REPORT").value_or("");
+
+		if (auto v = env::get("VOICEFX_EMULATOR_FAIL"); v.has_value()) {
+			std::string_view list = v.value();
+			while (!list.empty()) {
+				size_t           end  = std::min(list.find(','), list.size());
+				std::string_view name = list.substr(0, end);
+				for (size_t idx = 0; idx < fail.size(); idx++) {
+					if (name == entry_point_names[idx]) {
+						fail[idx] = true;
+					}
+				}
+				list.remove_prefix(std::min(end + 1, list.size()));
+			}
+		}
+	}
+
+	~emulator()
+	{
+		if (report.empty()) {
+			return;
+		}
+
+		FILE* file = (report == "-") ? stderr : fopen(report.c_str(), "wb");
+		if (!file) {
+			return;
+		}
+
+		fprintf(file, "{\"calls\": {");
+		for (size_t idx = 0; idx < calls.size(); idx++) {
+			fprintf(file, "%s\"%s\": %" PRIu64, idx ? ", " : "", entry_point_names[idx], calls[idx].load());
+		}
+		fprintf(file, "}, \"run_total_ns\": %" PRIu64 ", \"run_max_ns\": %" PRIu64 "}\n", run_total_ns.load(), run_max_ns.load());
+		if (file != stderr) {
+			fclose(file);
+		}
+	}
+
+	// Count a call, and decide whether it should fail.
+	bool enter(entry_point ep)
+	{
+		calls[static_cast<size_t>(ep)].fetch_add(1, std::memory_order_relaxed);
+		return !fail[static_cast<size_t>(ep)];
+	}
+};
+
+static emulator& instance()
+{
+	static emulator inst;
+	return inst;
+}
+
+// Sleeping alone overshoots by up to a scheduler tick, so the last stretch is spent yielding.
+static void wait(std::chrono::microseconds duration)
+{
+	if (duration.count() <= 0) {
+		return;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + duration;
+	if (duration > std::chrono::milliseconds(2)) {
+		std::this_thread::sleep_for(duration - std::chrono::milliseconds(2));
+	}
+	while (std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Effects
+//--------------------------------------------------------------------------------
+
+static const char* effect_names[] = {
+	NVAFX_EFFECT_DENOISER,
+	NVAFX_EFFECT_DEREVERB,
+	NVAFX_EFFECT_DEREVERB_DENOISER,
+	NVAFX_EFFECT_SUPERRES,
+};
+
+struct effect {
+	std::string name;
+	bool        superres;
+
+	std::string model_path;
+	uint32_t    in_samplerate;
+	uint32_t    out_samplerate;
+	uint32_t    streams;
+	uint32_t    use_default_gpu;
+	uint32_t    user_cuda_context;
+	uint32_t    disable_cuda_graph;
+	uint32_t    vad;
+	float       intensity;
+	bool        loaded;
+	uint64_t    runs; // Calls to NvAFX_Run since the last NvAFX_Load.
+
+	std::vector<float> lowpass; // Filter state per stream.
+	std::mt19937       jitter;
+
+	effect(std::string_view name, uint64_t index)
+		: name(name), superres(name == NVAFX_EFFECT_SUPERRES), model_path(), in_samplerate(superres ? 16000 : 48000), out_samplerate(48000), streams(1), use_default_gpu(0), user_cuda_context(0), disable_cuda_graph(0), vad(0), intensity(1.f), loaded(false), runs(0), lowpass(), jitter(instance().seed + static_cast<uint32_t>(index))
+	{}
+
+	// The real effects process 10 ms per call.
+	uint32_t in_frame() const
+	{
+		return in_samplerate / 100;
+	}
+
+	uint32_t out_frame() const
+	{
+		return out_samplerate / 100;
+	}
+
+	bool valid_samplerates(uint32_t in, uint32_t out) const
+	{
+		if (superres) {
+			return ((in == 8000) && (out == 16000)) || ((in == 16000) && (out == 48000));
+		}
+		return (in == out) && ((in == 16000) || (in == 48000));
+	}
+};
+
+static NvAFX_Status set_samplerates(effect* fx, uint32_t in, uint32_t out)
+{
+	if (!fx->valid_samplerates(in, out)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	fx->in_samplerate  = in;
+	fx->out_samplerate = out;
+	fx->loaded         = false;
+	return NVAFX_STATUS_SUCCESS;
+}
+
+//--------------------------------------------------------------------------------
+// Interface
+//--------------------------------------------------------------------------------
+
+NvAFX_Status NVAFX_API NvAFX_GetEffectList(int* num_effects, NvAFX_EffectSelector* effects[])
+{
+	if (!instance().enter(entry_point::GetEffectList)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	if (!num_effects || !effects) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	static NvAFX_EffectSelector list[] = {effect_names[0], effect_names[1], effect_names[2], effect_names[3]};
+	*num_effects                       = static_cast<int>(sizeof(list) / sizeof(NvAFX_EffectSelector));
+	*effects                           = list;
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_CreateEffect(NvAFX_EffectSelector code, NvAFX_Handle* handle)
+{
+	auto& emu = instance();
+	if (!emu.enter(entry_point::CreateEffect)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	if (!code || !handle) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	for (auto name : effect_names) {
+		if (strcmp(code, name) == 0) {
+			try {
+				wait(emu.create_latency);
+				*handle = new effect(name, emu.created.fetch_add(1));
+				return NVAFX_STATUS_SUCCESS;
+			} catch (...) {
+				return NVAFX_STATUS_FAILED;
+			}
+		}
+	}
+	return NVAFX_STATUS_EFFECT_NOT_AVAILABLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_CreateChainedEffect(NvAFX_EffectSelector, NvAFX_Handle*)
+{
+	if (!instance().enter(entry_point::CreateChainedEffect)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return NVAFX_STATUS_EFFECT_NOT_AVAILABLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_DestroyEffect(NvAFX_Handle handle)
+{
+	auto& emu = instance();
+	if (!emu.enter(entry_point::DestroyEffect)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	if (!handle) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+
+	wait(emu.destroy_latency);
+	delete reinterpret_cast<effect*>(handle);
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetU32(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, unsigned int val)
+{
+	if (!instance().enter(entry_point::SetU32)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	std::string_view key = param_name;
+	if (key == NVAFX_PARAM_INPUT_SAMPLE_RATE) {
+		// Superres only has one output rate per input rate, and the other way around.
+		return set_samplerates(fx, val, fx->superres ? ((val == 8000) ? 16000 : ((val == 16000) ? 48000 : 0)) : val);
+	} else if (key == NVAFX_PARAM_OUTPUT_SAMPLE_RATE) {
+		return set_samplerates(fx, fx->superres ? ((val == 16000) ? 8000 : ((val == 48000) ? 16000 : 0)) : val, val);
+	} else if (key == NVAFX_PARAM_SAMPLE_RATE) {
+		return set_samplerates(fx, val, val);
+	} else if (key == NVAFX_PARAM_NUM_STREAMS) {
+		if ((val < 1) || (val > 512)) {
+			return NVAFX_STATUS_INVALID_PARAM;
+		}
+		fx->streams = val;
+		fx->loaded  = false;
+	} else if (key == NVAFX_PARAM_USE_DEFAULT_GPU) {
+		fx->use_default_gpu = val;
+	} else if (key == NVAFX_PARAM_USER_CUDA_CONTEXT) {
+		fx->user_cuda_context = val;
+	} else if (key == NVAFX_PARAM_DISABLE_CUDA_GRAPH) {
+		fx->disable_cuda_graph = val;
+	} else if (key == NVAFX_PARAM_ENABLE_VAD) {
+		fx->vad = val;
+	} else {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetU32List(NvAFX_Handle handle, NvAFX_ParameterSelector, unsigned int*, unsigned int)
+{
+	if (!instance().enter(entry_point::SetU32List)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return handle ? NVAFX_STATUS_INVALID_PARAM : NVAFX_STATUS_INVALID_HANDLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetString(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, const char* val)
+{
+	if (!instance().enter(entry_point::SetString)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name || !val || (strcmp(param_name, NVAFX_PARAM_MODEL_PATH) != 0)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	fx->model_path = val;
+	fx->loaded     = false;
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetStringList(NvAFX_Handle handle, NvAFX_ParameterSelector, const char**, unsigned int)
+{
+	if (!instance().enter(entry_point::SetStringList)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return handle ? NVAFX_STATUS_INVALID_PARAM : NVAFX_STATUS_INVALID_HANDLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetFloat(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, float val)
+{
+	if (!instance().enter(entry_point::SetFloat)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name || (strcmp(param_name, NVAFX_PARAM_INTENSITY_RATIO) != 0) || !(val >= 0.f) || !(val <= 1.f)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	fx->intensity = val;
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_SetFloatList(NvAFX_Handle handle, NvAFX_ParameterSelector, float*, unsigned int)
+{
+	if (!instance().enter(entry_point::SetFloatList)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return handle ? NVAFX_STATUS_INVALID_PARAM : NVAFX_STATUS_INVALID_HANDLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetU32(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, unsigned int* val)
+{
+	if (!instance().enter(entry_point::GetU32)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name || !val) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	std::string_view key = param_name;
+	if ((key == NVAFX_PARAM_INPUT_SAMPLE_RATE) || (key == NVAFX_PARAM_SAMPLE_RATE)) {
+		*val = fx->in_samplerate;
+	} else if (key == NVAFX_PARAM_OUTPUT_SAMPLE_RATE) {
+		*val = fx->out_samplerate;
+	} else if ((key == NVAFX_PARAM_NUM_INPUT_SAMPLES_PER_FRAME) || (key == NVAFX_PARAM_NUM_SAMPLES_PER_FRAME)) {
+		*val = fx->in_frame();
+	} else if (key == NVAFX_PARAM_NUM_OUTPUT_SAMPLES_PER_FRAME) {
+		*val = fx->out_frame();
+	} else if ((key == NVAFX_PARAM_NUM_INPUT_CHANNELS) || (key == NVAFX_PARAM_NUM_OUTPUT_CHANNELS) || (key == NVAFX_PARAM_NUM_CHANNELS)) {
+		*val = 1;
+	} else if (key == NVAFX_PARAM_NUM_STREAMS) {
+		*val = fx->streams;
+	} else if (key == NVAFX_PARAM_USE_DEFAULT_GPU) {
+		*val = fx->use_default_gpu;
+	} else if (key == NVAFX_PARAM_USER_CUDA_CONTEXT) {
+		*val = fx->user_cuda_context;
+	} else if (key == NVAFX_PARAM_DISABLE_CUDA_GRAPH) {
+		*val = fx->disable_cuda_graph;
+	} else if (key == NVAFX_PARAM_ENABLE_VAD) {
+		*val = fx->vad;
+	} else {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetString(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, char* val, int max_length)
+{
+	if (!instance().enter(entry_point::GetString)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name || !val || (strcmp(param_name, NVAFX_PARAM_MODEL_PATH) != 0)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	if ((max_length <= 0) || (static_cast<size_t>(max_length) <= fx->model_path.size())) {
+		return NVAFX_STATUS_OUTPUT_BUFFER_TOO_SMALL;
+	}
+
+	memcpy(val, fx->model_path.c_str(), fx->model_path.size() + 1);
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetStringList(NvAFX_Handle handle, NvAFX_ParameterSelector, char**, int*, unsigned int)
+{
+	if (!instance().enter(entry_point::GetStringList)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return handle ? NVAFX_STATUS_INVALID_PARAM : NVAFX_STATUS_INVALID_HANDLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetFloat(NvAFX_Handle handle, NvAFX_ParameterSelector param_name, float* val)
+{
+	if (!instance().enter(entry_point::GetFloat)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!param_name || !val || (strcmp(param_name, NVAFX_PARAM_INTENSITY_RATIO) != 0)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	*val = fx->intensity;
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetFloatList(NvAFX_Handle handle, NvAFX_ParameterSelector, float*, unsigned int)
+{
+	if (!instance().enter(entry_point::GetFloatList)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	return handle ? NVAFX_STATUS_INVALID_PARAM : NVAFX_STATUS_INVALID_HANDLE;
+}
+
+NvAFX_Status NVAFX_API NvAFX_Load(NvAFX_Handle handle)
+{
+	auto& emu = instance();
+	if (!emu.enter(entry_point::Load)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!fx->valid_samplerates(fx->in_samplerate, fx->out_samplerate)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	if (emu.check_model) {
+		std::error_code ec;
+		if (fx->model_path.empty() || !std::filesystem::exists(std::filesystem::u8path(fx->model_path), ec)) {
+			return NVAFX_STATUS_MODEL_LOAD_FAILED;
+		}
+	}
+
+	try {
+		wait(emu.load_latency);
+		fx->lowpass.assign(fx->streams, 0.f);
+		fx->loaded = true;
+		fx->runs   = 0;
+		return NVAFX_STATUS_SUCCESS;
+	} catch (...) {
+		return NVAFX_STATUS_FAILED;
+	}
+}
+
+NvAFX_Status NVAFX_API NvAFX_GetSupportedDevices(NvAFX_Handle handle, int* num, int* devices)
+{
+	auto& emu = instance();
+	if (!emu.enter(entry_point::GetSupportedDevices)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	if (!handle) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!num) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+	if (!devices || (*num < emu.devices)) {
+		*num = emu.devices;
+		return NVAFX_STATUS_OUTPUT_BUFFER_TOO_SMALL;
+	}
+
+	*num = emu.devices;
+	for (int32_t idx = 0; idx < emu.devices; idx++) {
+		devices[idx] = idx;
+	}
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_Run(NvAFX_Handle handle, const float** input, float** output, unsigned num_input_samples, unsigned num_input_channels)
+{
+	auto& emu   = instance();
+	auto  start = std::chrono::steady_clock::now();
+	if (!emu.enter(entry_point::Run)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+	if (!fx->loaded) {
+		return NVAFX_STATUS_FAILED;
+	}
+	if (!input || !output || (num_input_samples != fx->in_frame()) || (num_input_channels != fx->streams)) {
+		return NVAFX_STATUS_INVALID_PARAM;
+	}
+
+	// Superres holds each input sample for the whole ratio, which is always a whole number.
+	const uint32_t ratio = fx->out_samplerate / fx->in_samplerate;
+	const float    alpha = static_cast<float>(1. - std::exp(-2. * pi * 4000. / static_cast<double>(fx->out_samplerate)));
+	for (size_t stream = 0; stream < fx->streams; stream++) {
+		const float* in  = input[stream];
+		float*       out = output[stream];
+		if (!in || !out) {
+			return NVAFX_STATUS_INVALID_PARAM;
+		}
+
+		if (emu.lowpass) {
+			float state = fx->lowpass[stream];
+			for (size_t idx = 0; idx < fx->out_frame(); idx++) {
+				float v = in[idx / ratio];
+				state += alpha * (v - state);
+				out[idx] = v + fx->intensity * (state - v);
+			}
+			fx->lowpass[stream] = state;
+		} else if (ratio == 1) {
+			memmove(out, in, num_input_samples * sizeof(float));
+		} else {
+			// Back to front, in case the output overlaps the input.
+			for (size_t idx = fx->out_frame(); idx > 0; idx--) {
+				out[idx - 1] = in[(idx - 1) / ratio];
+			}
+		}
+	}
+
+	// Pretend that the work took as long as it was configured to.
+	auto jitter = std::chrono::microseconds(0);
+	if (emu.run_jitter.count() > 0) {
+		jitter = std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, emu.run_jitter.count())(fx->jitter));
+	}
+	auto extra = (fx->disable_cuda_graph == 0) ? emu.graph_latency : std::chrono::microseconds(0);
+	if (fx->runs++ < emu.warmup_runs) {
+		extra += emu.warmup_latency;
+	}
+	wait(std::chrono::duration_cast<std::chrono::microseconds>(start - std::chrono::steady_clock::now()) + emu.run_latency + jitter + extra);
+
+	uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	emu.run_total_ns.fetch_add(elapsed, std::memory_order_relaxed);
+	for (uint64_t max = emu.run_max_ns.load(); (elapsed > max) && !emu.run_max_ns.compare_exchange_weak(max, elapsed);) {
+	}
+	return NVAFX_STATUS_SUCCESS;
+}
+
+NvAFX_Status NVAFX_API NvAFX_Reset(NvAFX_Handle handle)
+{
+	if (!instance().enter(entry_point::Reset)) {
+		return NVAFX_STATUS_FAILED;
+	}
+	auto fx = reinterpret_cast<effect*>(handle);
+	if (!fx) {
+		return NVAFX_STATUS_INVALID_HANDLE;
+	}
+
+	std::fill(fx->lowpass.begin(), fx->lowpass.end(), 0.f);
+	return NVAFX_STATUS_SUCCESS;
+}
+
+uint64_t NvAFXEmulator_GetCallCount(const char* name)
+{
+	auto& emu = instance();
+	for (size_t idx = 0; name && (idx < emu.calls.size()); idx++) {
+		if (strcmp(name, entry_point_names[idx]) == 0) {
+			return emu.calls[idx].load();
+		}
+	}
+	return 0;
+}
+
+void NvAFXEmulator_ResetCallCounts()
+{
+	auto& emu = instance();
+	for (auto& v : emu.calls) {
+		v.store(0);
+	}
+	emu.run_total_ns.store(0);
+	emu.run_max_ns.store(0);
+}
@@ -0,0 +1,415 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// CUDA driver emulator.
+//
+// A stand-in for the CUDA driver (nvcuda.dll, libcuda.so.1) that implements the handful of entry points the plug-in
+// loads, with any number of made up devices and no GPU behind them. Together with the NVIDIA Audio Effects emulator it
+// lets device selection be tested on any build machine. Place it where the plug-in looks for the real driver, for
+// example by putting it on LD_LIBRARY_PATH, and set VOICEFX_EMULATOR_DEVICES to the same number of devices.
+//
+// Configuration is read from the environment once, when the library is loaded:
+//   VOICEFX_EMULATOR_CUDA_DEVICES  Semicolon separated devices, each as "name:major.minor:multiprocessors:MHz", with
+//                                  an optional ":integrated" at the end. Default "Emulated GPU:8.6:28:1500".
+//
+// Device N has the UUID GPU-00000000-0000-0000-0000-0000000000NN, with NN being N + 1 in hexadecimal, and the LUID
+// N + 1.
+//
+// Retained primary contexts per device are also available at runtime through an additional export:
+//   int32_t NvCudaEmulator_GetPrimaryContextRetains(int32_t device);
+
+#include "nvidia-cuda.hpp"
+#include "util-environment.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "warning-enable.hpp"
+
+#ifdef WIN32
+#define EMULATOR_API __declspec(dllexport)
+#else
+#define EMULATOR_API __attribute__((visibility("default")))
+#endif
+
+namespace cuda = ::nvidia::cuda;
+
+//--------------------------------------------------------------------------------
+// Configuration
+//--------------------------------------------------------------------------------
+
+struct device {
+	std::string          name;
+	int32_t              major;
+	int32_t              minor;
+	int32_t              multiprocessors;
+	int32_t              kilohertz;
+	bool                 integrated;
+	std::atomic<int32_t> retains;
+};
+
+struct context {
+	cuda::device_t device;
+	bool           primary;
+};
+
+struct emulator {
+	std::vector<std::unique_ptr<device>>  devices;
+	std::vector<std::unique_ptr<context>> primaries;
+
+	emulator()
+	{
+		std::string      config = ::voicefx::environment::get("VOICEFX_EMULATOR_CUDA_DEVICES").value_or("Emulated GPU:8.6:28:1500");
+		std::string_view list   = config;
+		while (!list.empty()) {
+			size_t           end   = std::min(list.find(';'), list.size());
+			std::string_view entry = list.substr(0, end);
+			list.remove_prefix(std::min(end + 1, list.size()));
+			if (entry.empty()) {
+				continue;
+			}
+
+			// Split into its fields.
+			std::vector<std::string> fields;
+			while (!entry.empty()) {
+				size_t split = std::min(entry.find(':'), entry.size());
+				fields.emplace_back(entry.substr(0, split));
+				entry.remove_prefix(std::min(split + 1, entry.size()));
+			}
+			fields.resize(std::max<size_t>(fields.size(), 4));
+
+			auto dev             = std::make_unique<device>();
+			dev->name            = fields[0];
+			dev->major           = static_cast<int32_t>(std::strtol(fields[1].c_str(), nullptr, 10));
+			dev->minor           = (fields[1].find('.') != std::string::npos) ? static_cast<int32_t>(std::strtol(fields[1].c_str() + fields[1].find('.') + 1, nullptr, 10)) : 0;
+			dev->multiprocessors = static_cast<int32_t>(std::strtol(fields[2].c_str(), nullptr, 10));
+			dev->kilohertz       = static_cast<int32_t>(std::strtol(fields[3].c_str(), nullptr, 10)) * 1000;
+			dev->integrated      = (fields.size() > 4) && (fields[4] == "integrated");
+			dev->retains         = 0;
+			devices.push_back(std::move(dev));
+
+			auto ctx     = std::make_unique<context>();
+			ctx->device  = static_cast<cuda::device_t>(primaries.size());
+			ctx->primary = true;
+			primaries.push_back(std::move(ctx));
+		}
+	}
+
+	bool valid(cuda::device_t dev)
+	{
+		return (dev >= 0) && (static_cast<size_t>(dev) < devices.size());
+	}
+};
+
+static emulator& instance()
+{
+	static emulator inst;
+	return inst;
+}
+
+// Contexts are per thread, just like the real ones.
+static thread_local std::vector<context*> context_stack;
+
+//--------------------------------------------------------------------------------
+// Exports
+//--------------------------------------------------------------------------------
+
+extern "C" {
+EMULATOR_API cuda::result cuInit(int32_t)
+{
+	instance();
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDriverGetVersion(int32_t* version)
+{
+	if (!version) {
+		return cuda::result::INVALID_VALUE;
+	}
+	*version = 12000;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGetCount(int32_t* count)
+{
+	if (!count) {
+		return cuda::result::INVALID_VALUE;
+	}
+	*count = static_cast<int32_t>(instance().devices.size());
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGet(cuda::device_t* dev, int32_t idx)
+{
+	if (!dev) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!instance().valid(idx)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	*dev = idx;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGetName(char* name, int32_t length, cuda::device_t dev)
+{
+	auto& emu = instance();
+	if (!name || (length <= 0)) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!emu.valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	snprintf(name, static_cast<size_t>(length), "%s", emu.devices[dev]->name.c_str());
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGetLuid(cuda::luid_t* luid, uint32_t* device_node_mask, cuda::device_t dev)
+{
+	if (!luid || !device_node_mask) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!instance().valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	luid->parts.low   = static_cast<uint32_t>(dev) + 1;
+	luid->parts.high  = 0;
+	*device_node_mask = 1;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGetUuid(cuda::uuid_t* uuid, cuda::device_t dev)
+{
+	if (!uuid) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!instance().valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	memset(uuid->bytes, 0, sizeof(uuid->bytes));
+	uuid->bytes[15] = static_cast<char>(dev + 1);
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDeviceGetAttribute(int32_t* value, cuda::device_attribute attribute, cuda::device_t dev)
+{
+	auto& emu = instance();
+	if (!value) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!emu.valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+
+	auto& info = *emu.devices[dev];
+	switch (attribute) {
+	case cuda::device_attribute::KILOHERTZ:
+		*value = info.kilohertz;
+		break;
+	case cuda::device_attribute::MULTIPROCESSORS:
+		*value = info.multiprocessors;
+		break;
+	case cuda::device_attribute::INTEGRATED:
+		*value = info.integrated ? 1 : 0;
+		break;
+	case cuda::device_attribute::ASYNC_ENGINES:
+		*value = 2;
+		break;
+	case cuda::device_attribute::COMPUTE_CAPABILITY_MAJOR:
+		*value = info.major;
+		break;
+	case cuda::device_attribute::COMPUTE_CAPABILITY_MINOR:
+		*value = info.minor;
+		break;
+	default:
+		return cuda::result::INVALID_VALUE;
+	}
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDevicePrimaryCtxRetain(cuda::context_t* ctx, cuda::device_t dev)
+{
+	auto& emu = instance();
+	if (!ctx) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!emu.valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	emu.devices[dev]->retains++;
+	*ctx = emu.primaries[dev].get();
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuDevicePrimaryCtxRelease(cuda::device_t dev)
+{
+	auto& emu = instance();
+	if (!emu.valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	if (emu.devices[dev]->retains.fetch_sub(1) <= 0) {
+		emu.devices[dev]->retains++;
+		return cuda::result::INVALID_CONTEXT;
+	}
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxCreate_v2(cuda::context_t* ctx, cuda::context_flags, cuda::device_t dev)
+{
+	if (!ctx) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (!instance().valid(dev)) {
+		return cuda::result::INVALID_DEVICE;
+	}
+	auto created = new context{dev, false};
+	context_stack.push_back(created);
+	*ctx = created;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxDestroy_v2(cuda::context_t ctx)
+{
+	auto created = reinterpret_cast<context*>(ctx);
+	if (!created || created->primary) {
+		return cuda::result::INVALID_CONTEXT;
+	}
+	context_stack.erase(std::remove(context_stack.begin(), context_stack.end(), created), context_stack.end());
+	delete created;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxGetCurrent(cuda::context_t* ctx)
+{
+	if (!ctx) {
+		return cuda::result::INVALID_VALUE;
+	}
+	*ctx = context_stack.empty() ? nullptr : context_stack.back();
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxSetCurrent(cuda::context_t ctx)
+{
+	if (!context_stack.empty()) {
+		context_stack.pop_back();
+	}
+	if (ctx) {
+		context_stack.push_back(reinterpret_cast<context*>(ctx));
+	}
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxPushCurrent_v2(cuda::context_t ctx)
+{
+	if (!ctx) {
+		return cuda::result::INVALID_CONTEXT;
+	}
+	context_stack.push_back(reinterpret_cast<context*>(ctx));
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxPopCurrent_v2(cuda::context_t* ctx)
+{
+	if (context_stack.empty()) {
+		return cuda::result::INVALID_CONTEXT;
+	}
+	if (ctx) {
+		*ctx = context_stack.back();
+	}
+	context_stack.pop_back();
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxGetStreamPriorityRange(int32_t* lowest, int32_t* highest)
+{
+	if (lowest) {
+		*lowest = 0;
+	}
+	if (highest) {
+		*highest = -1;
+	}
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuCtxSynchronize()
+{
+	return context_stack.empty() ? cuda::result::INVALID_CONTEXT : cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuStreamCreate(cuda::stream_t* stream, cuda::stream_flags)
+{
+	if (!stream) {
+		return cuda::result::INVALID_VALUE;
+	}
+	if (context_stack.empty()) {
+		return cuda::result::INVALID_CONTEXT;
+	}
+	*stream = new int32_t(0);
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuStreamCreateWithPriority(cuda::stream_t* stream, cuda::stream_flags flags, int32_t priority)
+{
+	if (auto res = cuStreamCreate(stream, flags); res != cuda::result::SUCCESS) {
+		return res;
+	}
+	*reinterpret_cast<int32_t*>(*stream) = priority;
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuStreamDestroy_v2(cuda::stream_t stream)
+{
+	if (!stream) {
+		return cuda::result::INVALID_VALUE;
+	}
+	delete reinterpret_cast<int32_t*>(stream);
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API cuda::result cuStreamSynchronize(cuda::stream_t stream)
+{
+	return stream ? cuda::result::SUCCESS : cuda::result::INVALID_VALUE;
+}
+
+EMULATOR_API cuda::result cuStreamGetPriority(cuda::stream_t stream, int32_t* priority)
+{
+	if (!stream || !priority) {
+		return cuda::result::INVALID_VALUE;
+	}
+	*priority = *reinterpret_cast<int32_t*>(stream);
+	return cuda::result::SUCCESS;
+}
+
+EMULATOR_API int32_t NvCudaEmulator_GetPrimaryContextRetains(int32_t dev)
+{
+	auto& emu = instance();
+	return emu.valid(dev) ? emu.devices[dev]->retains.load() : 0;
+}
+}
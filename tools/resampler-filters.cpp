@@ -0,0 +1,238 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Build-time generator for the minimum-phase resampling prototypes.
+//
+// Each quality tier gets one low-pass prototype, expressed in samples of the lower of the two sample rates and
+// oversampled so that the polyphase engine can derive the table for any rate pair by interpolation. The linear-phase
+// Kaiser design is converted to minimum phase with the real cepstrum, which keeps the magnitude response and moves
+// nearly all of the energy to the start of the filter.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+static constexpr double pi = 3.14159265358979323846;
+
+// Points per sample of the lower sample rate. The engine interpolates with a cubic, which is accurate to well below
+// the stop band of the best tier at this density.
+static constexpr size_t oversample = 128;
+
+struct tier_t {
+	const char* name;
+	double      attenuation; // Stop band attenuation in dB.
+	double      rolloff;     // Pass band edge relative to the lower Nyquist frequency.
+};
+
+// Must match get_tier() in source/resampler-polyphase.cpp.
+static const tier_t tiers[] = {
+	{"fastest", 60., 0.80},
+	{"medium", 90., 0.88},
+	{"best", 120., 0.92},
+};
+
+static double bessel_i0(double x)
+{
+	double sum  = 1.;
+	double term = 1.;
+	for (size_t k = 1; k < 64; k++) {
+		term *= (x / (2. * k)) * (x / (2. * k));
+		sum += term;
+		if (term < (sum * 1e-12)) {
+			break;
+		}
+	}
+	return sum;
+}
+
+static void fft(std::vector<std::complex<double>>& data, bool inverse)
+{
+	size_t size = data.size();
+	for (size_t idx = 1, rev = 0; idx < size; idx++) {
+		size_t bit = size >> 1;
+		for (; rev & bit; bit >>= 1) {
+			rev ^= bit;
+		}
+		rev ^= bit;
+		if (idx < rev) {
+			std::swap(data[idx], data[rev]);
+		}
+	}
+
+	for (size_t length = 2; length <= size; length <<= 1) {
+		double               angle = 2. * pi / static_cast<double>(length) * (inverse ? 1. : -1.);
+		std::complex<double> step(std::cos(angle), std::sin(angle));
+		for (size_t start = 0; start < size; start += length) {
+			std::complex<double> w(1.);
+			for (size_t idx = 0; idx < length / 2; idx++) {
+				std::complex<double> a = data[start + idx];
+				std::complex<double> b = data[start + idx + length / 2] * w;
+				data[start + idx]                = a + b;
+				data[start + idx + length / 2] = a - b;
+				w *= step;
+			}
+		}
+	}
+
+	if (inverse) {
+		for (auto& v : data) {
+			v /= static_cast<double>(size);
+		}
+	}
+}
+
+static std::vector<double> design_linear(tier_t const& tier)
+{
+	// Same design as the linear-phase tables, just at a much higher density.
+	double transition = (1. - tier.rolloff) * 0.5;
+	double length     = std::ceil((tier.attenuation - 8.) / (2.285 * 2. * pi * transition));
+	size_t points     = static_cast<size_t>(length) * oversample + 1;
+	double cutoff     = (1. + tier.rolloff) * 0.25 / static_cast<double>(oversample);
+	double beta       = 0.1102 * (tier.attenuation - 8.7);
+	double center     = static_cast<double>(points - 1) * 0.5;
+	double norm       = bessel_i0(beta);
+
+	std::vector<double> result(points);
+	for (size_t idx = 0; idx < points; idx++) {
+		double t      = static_cast<double>(idx) - center;
+		double x      = 2. * cutoff * t;
+		double sinc   = (std::abs(x) < 1e-12) ? 1. : std::sin(pi * x) / (pi * x);
+		double r      = t / center;
+		double window = bessel_i0(beta * std::sqrt(std::max(0., 1. - r * r))) / norm;
+		result[idx]   = 2. * cutoff * sinc * window;
+	}
+	return result;
+}
+
+static std::vector<double> to_minimum_phase(std::vector<double> const& linear, tier_t const& tier)
+{
+	// The cepstrum aliases in time, so leave plenty of room.
+	size_t size = 1;
+	while (size < (linear.size() * 16)) {
+		size <<= 1;
+	}
+
+	std::vector<std::complex<double>> spectrum(size);
+	for (size_t idx = 0; idx < linear.size(); idx++) {
+		spectrum[idx] = linear[idx];
+	}
+	fft(spectrum, false);
+
+	// Zeros in the stop band have no logarithm, so limit the depth to well below the stop band.
+	double peak = 0.;
+	for (auto& v : spectrum) {
+		peak = std::max(peak, std::abs(v));
+	}
+	double floor = peak * std::pow(10., -(tier.attenuation + 40.) / 20.);
+	for (auto& v : spectrum) {
+		v = std::log(std::max(std::abs(v), floor));
+	}
+	fft(spectrum, true);
+
+	// Fold the anti-causal part of the real cepstrum onto the causal part.
+	for (size_t idx = 1; idx < size / 2; idx++) {
+		spectrum[idx] *= 2.;
+		spectrum[size - idx] = 0.;
+	}
+	fft(spectrum, false);
+	for (auto& v : spectrum) {
+		v = std::exp(v);
+	}
+	fft(spectrum, true);
+
+	std::vector<double> result(linear.size());
+	for (size_t idx = 0; idx < result.size(); idx++) {
+		result[idx] = spectrum[idx].real();
+	}
+
+	// Cut off the tail once it holds less energy than the stop band allows, on a whole sample of the lower rate.
+	double total = 0.;
+	for (double v : result) {
+		total += v * v;
+	}
+	double limit = total * std::pow(10., -(tier.attenuation + 20.) / 10.);
+	double tail  = 0.;
+	size_t end   = result.size();
+	while ((end > oversample) && ((tail + result[end - 1] * result[end - 1]) < limit)) {
+		tail += result[end - 1] * result[end - 1];
+		end--;
+	}
+	end = std::min(result.size(), ((end + oversample - 1) / oversample) * oversample + 1);
+	result.resize(end);
+	return result;
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <output header>\n", argv[0]);
+		return 1;
+	}
+
+	FILE* file = fopen(argv[1], "wb");
+	if (!file) {
+		fprintf(stderr, "Failed to open '%s' for writing.\n", argv[1]);
+		return 1;
+	}
+
+	fprintf(file, "// Generated by tools/resampler-filters.cpp, do not edit.\n\n");
+	fprintf(file, "#pragma once\n#include <cstddef>\n\n");
+	fprintf(file, "namespace voicefx::polyphase::minimum_phase {\n");
+	fprintf(file, "\tstruct prototype {\n");
+	fprintf(file, "\t\tdouble       attenuation;\n");
+	fprintf(file, "\t\tdouble       rolloff;\n");
+	fprintf(file, "\t\tsize_t       oversample;  // Points per sample of the lower sample rate.\n");
+	fprintf(file, "\t\tsize_t       length;      // Points in coefficients.\n");
+	fprintf(file, "\t\tdouble       delay;       // Group delay at DC, in samples of the lower sample rate.\n");
+	fprintf(file, "\t\tconst float* coefficients;\n");
+	fprintf(file, "\t};\n");
+
+	for (auto const& tier : tiers) {
+		auto linear  = design_linear(tier);
+		auto minimum = to_minimum_phase(linear, tier);
+
+		double sum      = 0.;
+		double weighted = 0.;
+		for (size_t idx = 0; idx < minimum.size(); idx++) {
+			sum += minimum[idx];
+			weighted += minimum[idx] * static_cast<double>(idx);
+		}
+		double delay = weighted / sum / static_cast<double>(oversample);
+
+		fprintf(stderr, "%s: %zu points, group delay %.2f samples (linear phase: %.2f samples).\n", tier.name, minimum.size(), delay, static_cast<double>(linear.size() - 1) * 0.5 / static_cast<double>(oversample));
+
+		fprintf(file, "\n\tstatic const float %s_coefficients[] = {", tier.name);
+		for (size_t idx = 0; idx < minimum.size(); idx++) {
+			fprintf(file, "%s%.9e,", (idx % 8) ? " " : "\n\t\t", minimum[idx] / sum * static_cast<double>(oversample));
+		}
+		fprintf(file, "\n\t};\n");
+		fprintf(file, "\tstatic const prototype %s = {%.1f, %.2f, %zu, %zu, %.17g, %s_coefficients};\n", tier.name, tier.attenuation, tier.rolloff, oversample, minimum.size(), delay, tier.name);
+	}
+
+	fprintf(file, "} // namespace voicefx::polyphase::minimum_phase\n");
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,966 @@
+// Copyright 2020 Michael Fabian 'Xaymar' Dirks <info@xaymar.com>
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark and quality lab for the resamplers.
+//
+// Runs every engine over the rate pairs the plug-in meets in practice, and writes cost and quality figures as JSON so
+// that build machines can track them between releases. Quality is measured with synthetic tones only, so the results
+// are exactly reproducible; timing is the fastest of several passes. A second set of figures compares many mono
+// instances against one instance converting all of the streams, and against the process-wide batch that converts the
+// streams of all instances together. The batch has to match converting every stream on its own.
+//
+// Every engine that reports a delay is also checked against its measured latency, the group delay plus whatever output
+// is still held back, and the lab exits with an error if any of them differ by more than half a sample. The same goes
+// for the round trip to the effect rate and back, whose latency the plug-in reports as the sum of both directions. Run
+// it again with VOICEFX_RESAMPLER_POLYPHASE=0 to check the secret-rabbit-code fallback for every tier.
+//
+// Usage: resampler-lab [--quick] [--output <file>]
+
+#include "lib.hpp"
+#include "resampler-halfband.hpp"
+#include "resampler-polyphase.hpp"
+#include "resampler.hpp"
+#include "util-simd.hpp"
+
+#include "warning-disable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <samplerate.h>
+#include <string>
+#include <vector>
+#include "warning-enable.hpp"
+
+std::shared_ptr<tonplugins::core> voicefx::core;
+
+static constexpr double   pi          = 3.14159265358979323846;
+static constexpr uint32_t effect_rate = 48000;
+
+// Every rate is converted to the effect rate and back, just like the plug-in does.
+static const uint32_t host_rates[] = {11025, 16000, 22050, 32000, 44100, 88200, 96000, 176400, 192000, 384000};
+
+//--------------------------------------------------------------------------------
+// Allocation Tracking
+//--------------------------------------------------------------------------------
+
+// Bytes allocated while tracking is enabled, which is how state size is measured without knowing about the engine.
+// GCC pairs the malloc() and free() below with every inlined new and delete, and wrongly reports them as mismatched.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<bool>   tracking{false};
+static std::atomic<size_t> tracked{0};
+
+void* operator new(size_t size)
+{
+	if (tracking) {
+		tracked += size;
+	}
+	if (void* ptr = malloc(size == 0 ? 1 : size); ptr) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+//--------------------------------------------------------------------------------
+// Engines
+//--------------------------------------------------------------------------------
+
+class instance {
+	public:
+	virtual ~instance() {}
+
+	// Name of the engine doing the work, which may differ from the one that was asked for.
+	virtual const char* engine() = 0;
+
+	// Delay in output samples as reported by the engine.
+	virtual double delay() = 0;
+
+	virtual void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated) = 0;
+};
+
+class resampler_instance : public instance {
+	std::shared_ptr<const voicefx::resampler_plan> _plan;
+	voicefx::resampler                             _resampler;
+
+	public:
+	resampler_instance(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase, size_t channels, size_t block)
+	{
+		_plan = voicefx::resampler::get_plan(in, out, quality, channels, phase);
+		_resampler.channels(channels);
+		_resampler.quality(quality);
+		_resampler.phase(phase);
+		_resampler.ratio(in, out);
+		_resampler.reserve(block, _plan->max_output(block));
+		_resampler.load();
+	}
+
+	const char* engine() override
+	{
+		return _plan->cascade ? "halfband" : (_plan->table ? "polyphase" : "secret-rabbit-code");
+	}
+
+	double delay() override
+	{
+		return _plan->exact_delay;
+	}
+
+	void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated) override
+	{
+		_resampler.process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+	}
+};
+
+class halfband_instance : public instance {
+	std::shared_ptr<const voicefx::halfband::design> _design;
+	std::shared_ptr<voicefx::halfband::cascade>      _cascade;
+
+	public:
+	halfband_instance(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase, size_t channels, size_t block)
+	{
+		_design  = voicefx::halfband::get_design(in, out, quality);
+		_cascade = std::make_shared<voicefx::halfband::cascade>(_design, channels, block);
+	}
+
+	const char* engine() override
+	{
+		return "halfband";
+	}
+
+	double delay() override
+	{
+		return _design->delay;
+	}
+
+	void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated) override
+	{
+		_cascade->process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+	}
+};
+
+class polyphase_instance : public instance {
+	std::shared_ptr<const voicefx::polyphase::table> _table;
+	std::shared_ptr<voicefx::polyphase::engine>      _engine;
+	double                                           _delay;
+
+	public:
+	polyphase_instance(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase, size_t channels, size_t block)
+	{
+		_table  = voicefx::polyphase::get_table(in, out, quality, phase);
+		_engine = std::make_shared<voicefx::polyphase::engine>(_table, channels, block);
+		_delay  = static_cast<double>(_table->delay);
+		if (phase == voicefx::resampler_phase::LINEAR) {
+			_delay = static_cast<double>(_table->taps * _table->up - 1) * 0.5 / static_cast<double>(_table->down);
+		}
+	}
+
+	const char* engine() override
+	{
+		return "polyphase";
+	}
+
+	double delay() override
+	{
+		return _delay;
+	}
+
+	void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated) override
+	{
+		_engine->process(in_buffer, in_samples, in_samples_used, out_buffer, out_samples, out_samples_generated);
+	}
+};
+
+// Plain secret-rabbit-code, as the baseline everything else has to beat.
+class src_instance : public instance {
+	std::shared_ptr<SRC_STATE> _state;
+	double                     _ratio;
+	size_t                     _channels;
+	std::vector<float>         _in;
+	std::vector<float>         _out;
+	std::vector<float*>        _planar;
+
+	public:
+	src_instance(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase, size_t channels, size_t block) : _ratio(static_cast<double>(out) / static_cast<double>(in)), _channels(channels)
+	{
+		int converter = SRC_LINEAR;
+		switch (quality) {
+		case voicefx::resampler_quality::FASTEST:
+			converter = SRC_SINC_FASTEST;
+			break;
+		case voicefx::resampler_quality::MEDIUM:
+			converter = SRC_SINC_MEDIUM_QUALITY;
+			break;
+		case voicefx::resampler_quality::BEST:
+			converter = SRC_SINC_BEST_QUALITY;
+			break;
+		default:
+			break;
+		}
+
+		int error = 0;
+		_state    = std::shared_ptr<SRC_STATE>(src_new(converter, static_cast<int>(channels), &error), [](SRC_STATE* v) { src_delete(v); });
+		if (error != 0) {
+			throw std::runtime_error(src_strerror(error));
+		}
+		_in.resize(block * channels);
+		_out.resize((static_cast<size_t>(std::ceil(block * _ratio)) + 2) * channels);
+		_planar.resize(channels);
+	}
+
+	const char* engine() override
+	{
+		return "secret-rabbit-code";
+	}
+
+	double delay() override
+	{
+		return std::nan("");
+	}
+
+	void process(const float* in_buffer[], size_t in_samples, size_t& in_samples_used, float* out_buffer[], size_t out_samples, size_t& out_samples_generated) override
+	{
+		size_t frames = std::min(in_samples, _in.size() / _channels);
+		voicefx::simd::interleave(in_buffer, _in.data(), _channels, frames);
+
+		SRC_DATA data      = {0};
+		data.data_in       = _in.data();
+		data.data_out      = _out.data();
+		data.input_frames  = static_cast<long>(frames);
+		data.output_frames = static_cast<long>(std::min(out_samples, _out.size() / _channels));
+		data.src_ratio     = _ratio;
+		if (int error = src_process(_state.get(), &data); error != 0) {
+			throw std::runtime_error(src_strerror(error));
+		}
+
+		for (size_t idx = 0; idx < _channels; idx++) {
+			_planar[idx] = out_buffer[idx];
+		}
+		voicefx::simd::deinterleave(_out.data(), _planar.data(), _channels, static_cast<size_t>(data.output_frames_gen));
+		in_samples_used       = static_cast<size_t>(data.input_frames_used);
+		out_samples_generated = static_cast<size_t>(data.output_frames_gen);
+	}
+};
+
+struct engine_t {
+	const char* name;
+	bool (*supported)(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase);
+	std::shared_ptr<instance> (*create)(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase, size_t channels, size_t block);
+};
+
+template<typename T>
+static std::shared_ptr<instance> create(uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase, size_t channels, size_t block)
+{
+	return std::make_shared<T>(in, out, quality, phase, channels, block);
+}
+
+// New engines only need an entry here to show up in the results.
+static const engine_t engines[] = {
+	{"resampler",
+	 [](uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase) {
+		 try {
+			 return voicefx::resampler::get_plan(in, out, quality, 1, phase)->phase == phase;
+		 } catch (std::exception const&) {
+			 // Converters can be compiled out of secret-rabbit-code, which the measurement reports as skipped.
+			 return phase == voicefx::resampler_phase::LINEAR;
+		 }
+	 },
+	 create<resampler_instance>},
+	{"halfband", [](uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase) { return voicefx::halfband::supported(in, out, quality, phase); }, create<halfband_instance>},
+	{"polyphase", [](uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase) { return voicefx::polyphase::supported(in, out, quality, phase); }, create<polyphase_instance>},
+	{"secret-rabbit-code", [](uint32_t, uint32_t, voicefx::resampler_quality, voicefx::resampler_phase phase) { return phase == voicefx::resampler_phase::LINEAR; }, create<src_instance>},
+};
+
+//--------------------------------------------------------------------------------
+// Measurements
+//--------------------------------------------------------------------------------
+
+// Convert planar input in blocks, the same way the plug-in feeds its resamplers.
+static std::vector<std::vector<float>> run(instance& inst, std::vector<std::vector<float>> const& input, size_t block, uint32_t in, uint32_t out)
+{
+	size_t                          channels = input.size();
+	size_t                          samples  = input[0].size();
+	std::vector<std::vector<float>> output(channels, std::vector<float>(static_cast<size_t>(std::ceil(static_cast<double>(samples) * out / in)) + block * 2 + 64));
+	std::vector<const float*>       ins(channels);
+	std::vector<float*>             outs(channels);
+
+	size_t used = 0;
+	size_t gen  = 0;
+	while (used < samples) {
+		for (size_t ch = 0; ch < channels; ch++) {
+			ins[ch]  = input[ch].data() + used;
+			outs[ch] = output[ch].data() + gen;
+		}
+		size_t block_used = 0;
+		size_t block_gen  = 0;
+		inst.process(ins.data(), std::min(block, samples - used), block_used, outs.data(), output[0].size() - gen, block_gen);
+		used += block_used;
+		gen += block_gen;
+		if ((block_used == 0) && (block_gen == 0)) {
+			break;
+		}
+	}
+
+	for (auto& v : output) {
+		v.resize(gen);
+	}
+	return output;
+}
+
+static std::vector<std::vector<float>> tone(double frequency, double amplitude, uint32_t rate, size_t samples, size_t channels = 1)
+{
+	std::vector<std::vector<float>> result(channels, std::vector<float>(samples));
+	for (size_t idx = 0; idx < samples; idx++) {
+		float v = static_cast<float>(amplitude * std::sin(2. * pi * frequency * static_cast<double>(idx) / static_cast<double>(rate)));
+		for (auto& ch : result) {
+			ch[idx] = v;
+		}
+	}
+	return result;
+}
+
+struct fit_t {
+	double amplitude; // Of the fitted sine.
+	double residual;  // RMS of everything else.
+	double rms;       // RMS of the signal.
+};
+
+// Least-squares fit of a sine at a known frequency over the middle half of the signal, away from the transients.
+static fit_t fit(std::vector<float> const& signal, double frequency, uint32_t rate)
+{
+	size_t begin = signal.size() / 4;
+	size_t end   = signal.size() * 3 / 4;
+	double w     = 2. * pi * frequency / static_cast<double>(rate);
+
+	double ss = 0., sc = 0., cc = 0., ys = 0., yc = 0., yy = 0.;
+	for (size_t idx = begin; idx < end; idx++) {
+		double s = std::sin(w * static_cast<double>(idx));
+		double c = std::cos(w * static_cast<double>(idx));
+		double y = signal[idx];
+		ss += s * s;
+		sc += s * c;
+		cc += c * c;
+		ys += y * s;
+		yc += y * c;
+		yy += y * y;
+	}
+	double det = ss * cc - sc * sc;
+	double a   = (ys * cc - yc * sc) / det;
+	double b   = (yc * ss - ys * sc) / det;
+
+	double residual = 0.;
+	for (size_t idx = begin; idx < end; idx++) {
+		double e = signal[idx] - a * std::sin(w * static_cast<double>(idx)) - b * std::cos(w * static_cast<double>(idx));
+		residual += e * e;
+	}
+
+	double count = static_cast<double>(end - begin);
+	return {std::sqrt(a * a + b * b), std::sqrt(residual / count), std::sqrt(yy / count)};
+}
+
+static double to_db(double v)
+{
+	return 20. * std::log10(std::max(v, 1e-12));
+}
+
+// A single sample can fall between the output samples of the linear tier, so impulses are short Hann pulses well inside
+// the pass band of every tier instead. The centroid moves by the same amount, and an even width keeps it on sample at.
+static std::vector<std::vector<float>> pulse(uint32_t rate, uint32_t low, size_t samples, size_t at)
+{
+	size_t                          width = 2 * static_cast<size_t>(std::ceil(16. * rate / low));
+	std::vector<std::vector<float>> result(1, std::vector<float>(samples, 0.f));
+	for (size_t idx = 0; idx <= width; idx++) {
+		result[0][at - width / 2 + idx] = static_cast<float>(0.5 - 0.5 * std::cos(2. * pi * static_cast<double>(idx) / static_cast<double>(width)));
+	}
+	return result;
+}
+
+static double centroid(std::vector<float> const& signal)
+{
+	double sum = 0., moment = 0.;
+	for (size_t idx = 0; idx < signal.size(); idx++) {
+		sum += signal[idx];
+		moment += signal[idx] * static_cast<double>(idx);
+	}
+	return moment / sum;
+}
+
+struct quality_t {
+	double group_delay;   // At DC, in output samples.
+	double held_back;     // Output samples the engine owes after all input was consumed, adding to the latency.
+	double ripple;        // Peak to peak over the pass band, in dB.
+	double stopband;      // Worst alias or image relative to the signal, in dB.
+	double thdn;          // Of a 997 Hz tone at -1 dBFS, in dB.
+	double passband_edge; // In Hz.
+};
+
+static quality_t measure_quality(engine_t const& eng, uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase)
+{
+	constexpr size_t block = 480;
+	quality_t        result;
+
+	double attenuation = 0., rolloff = 0.8;
+	voicefx::polyphase::tier(quality, attenuation, rolloff);
+	uint32_t low      = std::min(in, out);
+	result.passband_edge = rolloff * low * 0.5;
+
+	// The first moment of the impulse response is the group delay at DC, even for minimum phase filters.
+	{
+		auto   inst     = eng.create(in, out, quality, phase, 1, block);
+		size_t samples  = in / 2;
+		size_t at       = samples / 2;
+		auto   response = run(*inst, pulse(in, low, samples, at), block, in, out);
+		result.group_delay = centroid(response[0]) - static_cast<double>(at) * out / in;
+		result.held_back   = static_cast<double>(samples) * out / in - static_cast<double>(response[0].size());
+	}
+
+	// Pass band flatness, from tones spread logarithmically up to the pass band edge.
+	{
+		double lowest = std::numeric_limits<double>::max(), highest = 0.;
+		for (size_t idx = 0; idx < 16; idx++) {
+			double frequency = 20. * std::pow(result.passband_edge / 20., static_cast<double>(idx) / 15.);
+			auto   inst      = eng.create(in, out, quality, phase, 1, block);
+			auto   response  = run(*inst, tone(frequency, 0.5, in, in / 4), block, in, out);
+			double amplitude = fit(response[0], frequency, out).amplitude / 0.5;
+			lowest           = std::min(lowest, amplitude);
+			highest          = std::max(highest, amplitude);
+		}
+		result.ripple = to_db(highest) - to_db(lowest);
+	}
+
+	// Decimation folds everything above the output Nyquist frequency back into the pass band, interpolation creates
+	// images of the pass band above the input Nyquist frequency. Either way, it is whatever isn't the tone itself.
+	{
+		double worst = -std::numeric_limits<double>::max();
+		for (size_t idx = 0; idx < 16; idx++) {
+			double frequency, reference;
+			auto   inst = eng.create(in, out, quality, phase, 1, block);
+			if (in > out) {
+				// Tones whose aliases land in the pass band.
+				double first = static_cast<double>(out) - result.passband_edge;
+				double last  = std::min(static_cast<double>(in) * 0.5, static_cast<double>(out) * 1.5) * 0.99;
+				frequency    = first + (last - first) * static_cast<double>(idx) / 15.;
+				auto output  = run(*inst, tone(frequency, 0.5, in, in / 4), block, in, out);
+				reference    = fit(output[0], 0., out).rms / (0.5 / std::sqrt(2.));
+			} else {
+				frequency   = result.passband_edge * static_cast<double>(idx + 1) / 16.;
+				auto output = run(*inst, tone(frequency, 0.5, in, in / 4), block, in, out);
+				auto f      = fit(output[0], frequency, out);
+				reference   = f.residual / (f.amplitude / std::sqrt(2.));
+			}
+			worst = std::max(worst, to_db(reference));
+		}
+		result.stopband = -worst;
+	}
+
+	{
+		auto inst     = eng.create(in, out, quality, phase, 1, block);
+		auto response = run(*inst, tone(997., std::pow(10., -1. / 20.), in, in / 2), block, in, out);
+		auto f        = fit(response[0], 997., out);
+		result.thdn   = to_db(f.residual / (f.amplitude / std::sqrt(2.)));
+	}
+
+	return result;
+}
+
+struct round_trip_t {
+	double reported; // Sum of both plans as the plug-in reports it, in host samples.
+	double latency;  // Measured through both resamplers, in host samples.
+};
+
+// The plug-in converts to the effect rate and back, and reports the sum of both plans as part of its latency. Chain the
+// two the same way and check that the sum holds for every tier, not just each direction on its own.
+static round_trip_t measure_round_trip(uint32_t host, voicefx::resampler_quality quality, voicefx::resampler_phase phase)
+{
+	constexpr size_t block = 480;
+	round_trip_t     result;
+
+	// Same sum as vst3::effect::processor::calculate_delay(), without the effect.
+	auto down_plan  = voicefx::resampler::get_plan(host, effect_rate, quality, 1, phase);
+	auto up_plan    = voicefx::resampler::get_plan(effect_rate, host, quality, 1, phase);
+	result.reported = down_plan->exact_delay * host / effect_rate + up_plan->exact_delay;
+
+	resampler_instance down(host, effect_rate, quality, phase, 1, block);
+	resampler_instance up(effect_rate, host, quality, phase, 1, down_plan->max_output(block));
+
+	size_t             samples = host / 2;
+	size_t             at      = samples / 2;
+	auto               input   = pulse(host, std::min(host, effect_rate), samples, at);
+	std::vector<float> middle(down_plan->max_output(block));
+	std::vector<float> output(samples + 4096);
+
+	size_t used = 0;
+	size_t gen  = 0;
+	while (used < samples) {
+		const float* ins[]     = {input[0].data() + used};
+		float*       mids[]    = {middle.data()};
+		size_t       down_used = 0;
+		size_t       down_gen  = 0;
+		down.process(ins, std::min(block, samples - used), down_used, mids, middle.size(), down_gen);
+		used += down_used;
+
+		// Everything that comes out of the first resampler goes straight into the second, like in the plug-in.
+		for (size_t offset = 0; offset < down_gen;) {
+			const float* up_ins[]  = {middle.data() + offset};
+			float*       up_outs[] = {output.data() + gen};
+			size_t       up_used   = 0;
+			size_t       up_gen    = 0;
+			up.process(up_ins, down_gen - offset, up_used, up_outs, output.size() - gen, up_gen);
+			offset += up_used;
+			gen += up_gen;
+			if ((up_used == 0) && (up_gen == 0)) {
+				break;
+			}
+		}
+		if ((down_used == 0) && (down_gen == 0)) {
+			break;
+		}
+	}
+	output.resize(gen);
+
+	result.latency = centroid(output) - static_cast<double>(at) + static_cast<double>(samples) - static_cast<double>(gen);
+	return result;
+}
+
+struct timing_t {
+	size_t channels;
+	size_t block;
+	double ns_per_sample; // Per input sample and channel.
+	size_t state_bytes;   // Allocated by one more instance once shared tables exist.
+};
+
+static timing_t measure_timing(engine_t const& eng, uint32_t in, uint32_t out, voicefx::resampler_quality quality, voicefx::resampler_phase phase, size_t channels, size_t block)
+{
+	timing_t result = {channels, block, 0., 0};
+
+	// The first instance creates the shared tables, the second one only its own state.
+	auto inst = eng.create(in, out, quality, phase, channels, block);
+	{
+		tracked  = 0;
+		tracking = true;
+		auto other = eng.create(in, out, quality, phase, channels, block);
+		tracking = false;
+		result.state_bytes = tracked;
+	}
+
+	// A quarter of a second per pass keeps the whole matrix within minutes.
+	auto   input = tone(997., 0.5, in, std::max<size_t>(in / 4, block), channels);
+	double best  = std::numeric_limits<double>::max();
+	for (size_t pass = 0; pass < 4; pass++) {
+		auto start   = std::chrono::high_resolution_clock::now();
+		auto output  = run(*inst, input, block, in, out);
+		auto elapsed = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(std::chrono::high_resolution_clock::now() - start);
+		if (pass > 0) {
+			best = std::min(best, elapsed.count());
+		}
+	}
+	result.ns_per_sample = best / static_cast<double>(input[0].size() * channels);
+	return result;
+}
+
+struct scaling_t {
+	size_t streams;
+	double separate; // Nanoseconds per input sample and stream, with one mono instance per stream.
+	double combined; // Nanoseconds per input sample and stream, with one instance for all streams.
+};
+
+static scaling_t measure_scaling(engine_t const& eng, uint32_t in, uint32_t out, voicefx::resampler_quality quality, size_t streams, size_t block)
+{
+	scaling_t result = {streams, 0., 0.};
+
+	// Many mono tracks each get their own instance, which the host runs one after another for every block.
+	std::vector<std::shared_ptr<instance>> separate;
+	for (size_t idx = 0; idx < streams; idx++) {
+		separate.push_back(eng.create(in, out, quality, voicefx::resampler_phase::LINEAR, 1, block));
+	}
+	auto combined = eng.create(in, out, quality, voicefx::resampler_phase::LINEAR, streams, block);
+
+	auto                            input = tone(997., 0.5, in, std::max<size_t>(in / 8, block), streams);
+	std::vector<std::vector<float>> output(streams, std::vector<float>(block * 4 + 64));
+	std::vector<const float*>       ins(streams);
+	std::vector<float*>             outs(streams);
+	for (size_t idx = 0; idx < streams; idx++) {
+		outs[idx] = output[idx].data();
+	}
+
+	double best_separate = std::numeric_limits<double>::max();
+	double best_combined = std::numeric_limits<double>::max();
+	for (size_t pass = 0; pass < 4; pass++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t offset = 0; offset < input[0].size(); offset += block) {
+			size_t length = std::min(block, input[0].size() - offset);
+			for (size_t idx = 0; idx < streams; idx++) {
+				const float* in_buffer[] = {input[idx].data() + offset};
+				size_t       used, gen;
+				separate[idx]->process(in_buffer, length, used, &outs[idx], output[idx].size(), gen);
+			}
+		}
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (size_t offset = 0; offset < input[0].size(); offset += block) {
+			size_t length = std::min(block, input[0].size() - offset);
+			for (size_t idx = 0; idx < streams; idx++) {
+				ins[idx] = input[idx].data() + offset;
+			}
+			size_t used, gen;
+			combined->process(ins.data(), length, used, outs.data(), output[0].size(), gen);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		if (pass > 0) {
+			best_separate = std::min(best_separate, std::chrono::duration<double, std::nano>(middle - start).count());
+			best_combined = std::min(best_combined, std::chrono::duration<double, std::nano>(end - middle).count());
+		}
+	}
+	result.separate = best_separate / static_cast<double>(input[0].size() * streams);
+	result.combined = best_combined / static_cast<double>(input[0].size() * streams);
+	return result;
+}
+
+struct batch_t {
+	size_t streams;
+	double batched; // Nanoseconds per input sample and stream, with all streams converted by one batch.
+	double error;   // Largest difference to converting every stream on its own, in dB relative to full scale.
+};
+
+// The same mono streams, each of them with its own stream in the process-wide batch.
+static batch_t measure_batch(uint32_t in, uint32_t out, voicefx::resampler_quality quality, size_t streams, size_t block)
+{
+	batch_t result = {streams, 0., -std::numeric_limits<double>::infinity()};
+
+	auto table = voicefx::polyphase::get_table(in, out, quality);
+	auto batch = voicefx::polyphase::get_batch(table);
+
+	std::vector<std::shared_ptr<voicefx::polyphase::stream>> batched;
+	std::vector<std::shared_ptr<voicefx::polyphase::engine>> separate;
+	std::vector<std::vector<float>>                          input;
+	for (size_t idx = 0; idx < streams; idx++) {
+		batched.push_back(std::make_shared<voicefx::polyphase::stream>(batch, 1, block));
+		separate.push_back(std::make_shared<voicefx::polyphase::engine>(table, 1, block));
+		input.push_back(tone(997. + 31. * static_cast<double>(idx), 0.5, in, std::max<size_t>(in / 8, block))[0]);
+	}
+	size_t samples = input[0].size();
+
+	// Convert everything with both, each stream starting at a different offset into its first round. The streams take
+	// turns, so that the batch converts many of them at once.
+	std::vector<std::vector<float>> reference(streams, std::vector<float>(static_cast<size_t>(std::ceil(static_cast<double>(samples) * out / in)) + block * 4 + 64));
+	std::vector<std::vector<float>> output(streams, std::vector<float>(reference[0].size()));
+	std::vector<size_t>             used(streams * 2, 0);
+	std::vector<size_t>             gen(streams * 2, 0);
+	auto                            convert = [&](auto& inst, std::vector<float>& result, size_t idx, size_t slot) {
+		size_t       first        = (idx * 37) % block;
+		size_t       length       = std::min(((used[slot] == 0) && (first > 0)) ? first : block, samples - used[slot]);
+		const float* in_buffer[]  = {input[idx].data() + used[slot]};
+		float*       out_buffer[] = {result.data() + gen[slot]};
+		size_t       u, g;
+		inst->process(in_buffer, length, u, out_buffer, result.size() - gen[slot], g);
+		used[slot] += u;
+		gen[slot] += g;
+	};
+	for (bool busy = true; busy;) {
+		busy = false;
+		for (size_t idx = 0; idx < streams; idx++) {
+			if (used[idx * 2] < samples) {
+				convert(separate[idx], reference[idx], idx, idx * 2);
+				convert(batched[idx], output[idx], idx, idx * 2 + 1);
+				busy = true;
+			}
+		}
+	}
+	double error = 0.;
+	for (size_t idx = 0; idx < streams; idx++) {
+		for (size_t pos = 0; pos < std::min(gen[idx * 2], gen[idx * 2 + 1]); pos++) {
+			error = std::max(error, static_cast<double>(std::abs(output[idx][pos] - reference[idx][pos])));
+		}
+	}
+	if (error > 0.) {
+		result.error = 20. * std::log10(error);
+	}
+
+	// Timing runs all streams block by block, the way the host runs one instance after another.
+	double best = std::numeric_limits<double>::max();
+	for (size_t pass = 0; pass < 4; pass++) {
+		for (auto& inst : batched) {
+			inst->clear();
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t offset = 0; offset < samples; offset += block) {
+			size_t length = std::min(block, samples - offset);
+			for (size_t idx = 0; idx < streams; idx++) {
+				const float* in_buffer[]  = {input[idx].data() + offset};
+				float*       out_buffer[] = {output[idx].data()};
+				size_t       used, gen;
+				batched[idx]->process(in_buffer, length, used, out_buffer, output[idx].size(), gen);
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		if (pass > 0) {
+			best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+		}
+	}
+	result.batched = best / static_cast<double>(samples * streams);
+	return result;
+}
+
+//--------------------------------------------------------------------------------
+// Output
+//--------------------------------------------------------------------------------
+
+static void write_number(FILE* file, const char* name, double value, const char* suffix = ", ")
+{
+	// JSON has no representation for NaN or infinity.
+	if (std::isfinite(value)) {
+		fprintf(file, "\"%s\": %.4f%s", name, value, suffix);
+	} else {
+		fprintf(file, "\"%s\": null%s", name, suffix);
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	bool        quick = false;
+	const char* path  = nullptr;
+	for (int idx = 1; idx < argc; idx++) {
+		if (strcmp(argv[idx], "--quick") == 0) {
+			quick = true;
+		} else if ((strcmp(argv[idx], "--output") == 0) && ((idx + 1) < argc)) {
+			path = argv[++idx];
+		} else {
+			fprintf(stderr, "Usage: %s [--quick] [--output <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	voicefx::core = tonplugins::core::instance(std::string{voicefx::product_name});
+
+	FILE* file = path ? fopen(path, "wb") : stdout;
+	if (!file) {
+		fprintf(stderr, "Failed to open '%s' for writing.\n", path);
+		return 1;
+	}
+
+	std::vector<size_t> channel_counts = quick ? std::vector<size_t>{2} : std::vector<size_t>{1, 2, 6};
+	std::vector<size_t> block_sizes    = quick ? std::vector<size_t>{480} : std::vector<size_t>{64, 480, 2048};
+
+	size_t mismatches  = 0;
+	size_t differences = 0;
+	fprintf(file, "{\n\t\"format\": 1,\n\t\"effect_samplerate\": %" PRIu32 ",\n\t\"results\": [", effect_rate);
+	bool first = true;
+	for (uint32_t host : host_rates) {
+		for (auto direction : {true, false}) {
+			uint32_t in  = direction ? host : effect_rate;
+			uint32_t out = direction ? effect_rate : host;
+			for (auto quality : {voicefx::resampler_quality::LINEAR, voicefx::resampler_quality::FASTEST, voicefx::resampler_quality::MEDIUM, voicefx::resampler_quality::BEST}) {
+				for (auto phase : {voicefx::resampler_phase::LINEAR, voicefx::resampler_phase::MINIMUM}) {
+					for (auto const& eng : engines) {
+						if (!eng.supported(in, out, quality, phase)) {
+							continue;
+						}
+
+						const char* phase_name = (phase == voicefx::resampler_phase::MINIMUM) ? "minimum" : "linear";
+						fprintf(stderr, "%s: %" PRIu32 " Hz -> %" PRIu32 " Hz, %s, %s phase...\n", eng.name, in, out, voicefx::resampler::quality_name(quality), phase_name);
+						try {
+							auto      probe   = eng.create(in, out, quality, phase, 1, 480);
+							quality_t quality_result = measure_quality(eng, in, out, quality, phase);
+
+							std::vector<timing_t> timings;
+							for (size_t channels : channel_counts) {
+								for (size_t block : block_sizes) {
+									timings.push_back(measure_timing(eng, in, out, quality, phase, channels, block));
+								}
+							}
+
+							fprintf(file, "%s\n\t\t{\"engine\": \"%s\", \"implementation\": \"%s\", \"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"phase\": \"%s\", ", first ? "" : ",", eng.name, probe->engine(), in, out, voicefx::resampler::quality_name(quality), phase_name);
+							write_number(file, "reported_delay", probe->delay());
+							write_number(file, "group_delay", quality_result.group_delay);
+							write_number(file, "held_back", quality_result.held_back);
+
+							// The reported delay is what the host compensates for, so it has to be the latency the engine
+							// really has. Engines that don't report one are only measured.
+							double latency = quality_result.group_delay + quality_result.held_back;
+							bool   matches = !std::isfinite(probe->delay()) || (std::abs(probe->delay() - latency) <= 0.5);
+							write_number(file, "latency", latency);
+							fprintf(file, "\"latency_matches\": %s, ", matches ? "true" : "false");
+							if (!matches) {
+								fprintf(stderr, "  reported delay of %.2f samples does not match the measured latency of %.2f samples.\n", probe->delay(), latency);
+								mismatches++;
+							}
+							write_number(file, "passband_edge_hz", quality_result.passband_edge);
+							write_number(file, "passband_ripple_db", quality_result.ripple);
+							write_number(file, "stopband_attenuation_db", quality_result.stopband);
+							write_number(file, "thd_n_db", quality_result.thdn);
+							fprintf(file, "\"timing\": [");
+							for (size_t idx = 0; idx < timings.size(); idx++) {
+								fprintf(file, "%s\n\t\t\t{\"channels\": %zu, \"block\": %zu, ", idx ? "," : "", timings[idx].channels, timings[idx].block);
+								write_number(file, "ns_per_sample", timings[idx].ns_per_sample);
+								fprintf(file, "\"state_bytes\": %zu}", timings[idx].state_bytes);
+							}
+							fprintf(file, "\n\t\t]}");
+							first = false;
+						} catch (std::exception const& ex) {
+							// Converters can be compiled out of secret-rabbit-code.
+							fprintf(stderr, "  skipped: %s\n", ex.what());
+						}
+						fflush(file);
+					}
+				}
+			}
+		}
+	}
+	fprintf(file, "\n\t],\n\t\"round_trip\": [");
+
+	// Every tier the plug-in can select, including the ones that automatic selection falls back to.
+	first = true;
+	for (uint32_t host : host_rates) {
+		if (host == effect_rate) {
+			continue;
+		}
+		for (auto quality : {voicefx::resampler_quality::LINEAR, voicefx::resampler_quality::FASTEST, voicefx::resampler_quality::MEDIUM, voicefx::resampler_quality::BEST}) {
+			for (auto phase : {voicefx::resampler_phase::LINEAR, voicefx::resampler_phase::MINIMUM}) {
+				const char* phase_name = (phase == voicefx::resampler_phase::MINIMUM) ? "minimum" : "linear";
+				fprintf(stderr, "round trip: %" PRIu32 " Hz, %s, %s phase...\n", host, voicefx::resampler::quality_name(quality), phase_name);
+				try {
+					round_trip_t result = measure_round_trip(host, quality, phase);
+
+					// Each direction may be off by a fraction that the other one doesn't cancel.
+					bool matches = std::abs(result.reported - result.latency) <= 1.;
+					fprintf(file, "%s\n\t\t{\"host_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"phase\": \"%s\", ", first ? "" : ",", host, voicefx::resampler::quality_name(quality), phase_name);
+					write_number(file, "reported_delay", result.reported);
+					write_number(file, "latency", result.latency);
+					fprintf(file, "\"latency_matches\": %s}", matches ? "true" : "false");
+					if (!matches) {
+						fprintf(stderr, "  reported delay of %.2f samples does not match the measured latency of %.2f samples.\n", result.reported, result.latency);
+						mismatches++;
+					}
+					first = false;
+				} catch (std::exception const& ex) {
+					fprintf(stderr, "  skipped: %s\n", ex.what());
+				}
+				fflush(file);
+			}
+		}
+	}
+	fprintf(file, "\n\t],\n\t\"cost\": [");
+
+	// Automatic quality selection goes by the estimate, so keep an eye on how far it is from the real thing.
+	first = true;
+	for (uint32_t host : host_rates) {
+		if (host == effect_rate) {
+			continue;
+		}
+		for (auto quality : {voicefx::resampler_quality::LINEAR, voicefx::resampler_quality::FASTEST, voicefx::resampler_quality::MEDIUM, voicefx::resampler_quality::BEST}) {
+			fprintf(stderr, "cost: %" PRIu32 " Hz, %s...\n", host, voicefx::resampler::quality_name(quality));
+			try {
+				double estimated = voicefx::resampler::estimate_cost(host, effect_rate, quality);
+				double measured  = voicefx::resampler::measure_cost(host, effect_rate, quality);
+				fprintf(file, "%s\n\t\t{\"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", ", first ? "" : ",", host, effect_rate, voicefx::resampler::quality_name(quality));
+				write_number(file, "estimated", estimated);
+				write_number(file, "measured", measured, "}");
+				first = false;
+			} catch (std::exception const& ex) {
+				fprintf(stderr, "  skipped: %s\n", ex.what());
+			}
+			fflush(file);
+		}
+	}
+	fprintf(file, "\n\t],\n\t\"scaling\": [");
+
+	// Sessions with many mono tracks, each of them with its own plug-in instance, against a single instance that
+	// converts all of them at once.
+	std::vector<size_t> stream_counts = quick ? std::vector<size_t>{1, 4, 16} : std::vector<size_t>{1, 2, 4, 8, 16, 32, 64, 128, 256};
+	first                             = true;
+	for (auto const& eng : engines) {
+		if (!eng.supported(44100, effect_rate, voicefx::resampler_quality::BEST, voicefx::resampler_phase::LINEAR)) {
+			continue;
+		}
+
+		fprintf(stderr, "%s: scaling with the number of streams...\n", eng.name);
+		try {
+			auto probe = eng.create(44100, effect_rate, voicefx::resampler_quality::BEST, voicefx::resampler_phase::LINEAR, 1, 480);
+			fprintf(file, "%s\n\t\t{\"engine\": \"%s\", \"implementation\": \"%s\", \"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"block\": %zu, \"streams\": [", first ? "" : ",", eng.name, probe->engine(), 44100u, effect_rate, voicefx::resampler::quality_name(voicefx::resampler_quality::BEST), size_t{480});
+			for (size_t idx = 0; idx < stream_counts.size(); idx++) {
+				scaling_t result = measure_scaling(eng, 44100, effect_rate, voicefx::resampler_quality::BEST, stream_counts[idx], 480);
+				fprintf(file, "%s\n\t\t\t{\"streams\": %zu, ", idx ? "," : "", result.streams);
+				write_number(file, "separate_ns_per_sample", result.separate);
+				write_number(file, "combined_ns_per_sample", result.combined, "}");
+			}
+			fprintf(file, "\n\t\t]}");
+			first = false;
+		} catch (std::exception const& ex) {
+			fprintf(stderr, "  skipped: %s\n", ex.what());
+		}
+		fflush(file);
+	}
+	fprintf(file, "\n\t],\n\t\"batch\": [");
+
+	// The same sessions with every stream converted by the process-wide batch, see polyphase::batch.
+	if (voicefx::polyphase::supported(44100, effect_rate, voicefx::resampler_quality::BEST)) {
+		fprintf(stderr, "batch: scaling with the number of streams...\n");
+		fprintf(file, "\n\t\t{\"in_samplerate\": %" PRIu32 ", \"out_samplerate\": %" PRIu32 ", \"quality\": \"%s\", \"block\": %zu, \"streams\": [", 44100u, effect_rate, voicefx::resampler::quality_name(voicefx::resampler_quality::BEST), size_t{480});
+		for (size_t idx = 0; idx < stream_counts.size(); idx++) {
+			batch_t result = measure_batch(44100, effect_rate, voicefx::resampler_quality::BEST, stream_counts[idx], 480);
+			fprintf(file, "%s\n\t\t\t{\"streams\": %zu, ", idx ? "," : "", result.streams);
+			write_number(file, "batched_ns_per_sample", result.batched);
+			write_number(file, "error_db", result.error, "}");
+
+			// Only the order of the additions differs, which is far below what any tier resolves.
+			if (result.error > -100.) {
+				fprintf(stderr, "  %zu streams differ from the engine by %.1f dB.\n", result.streams, result.error);
+				differences++;
+			}
+		}
+		fprintf(file, "\n\t\t]}");
+	}
+	fprintf(file, "\n\t]\n}\n");
+
+	if (path) {
+		fclose(file);
+	}
+
+	if (mismatches > 0) {
+		fprintf(stderr, "%zu conversions report a delay that differs from their latency.\n", mismatches);
+		return 2;
+	}
+	if (differences > 0) {
+		fprintf(stderr, "%zu batches differ from converting every stream on its own.\n", differences);
+		return 2;
+	}
+	return 0;
+}